@@ -42,7 +42,7 @@ BUILD_DIR="${PROJECT_ROOT}/build"
 DEPLOY_DIR="${PROJECT_ROOT}/deploy"
 TEMP_TEST_DIR=""
 
-# Check if running on Ubuntu x86_64
+# Check if running on Ubuntu x86_64 or aarch64
 check_system() {
     log_info "Checking system requirements..."
     
@@ -51,8 +51,8 @@ check_system() {
         exit 1
     fi
     
-    if [[ "$(uname -m)" != "x86_64" ]]; then
-        log_error "This script requires x86_64 architecture"
+    if [[ "$(uname -m)" != "x86_64" && "$(uname -m)" != "aarch64" ]]; then
+        log_error "This script requires x86_64 or aarch64 architecture"
         exit 1
     fi
     
@@ -161,12 +161,17 @@ build_llama_cpp() {
     mkdir -p build
     cd build
     
-    # Configure with CMake for shared library
+    # Configure with CMake for shared library. The CPU backend is built once per ISA
+    # level (e.g. haswell, skylakex, sapphirerapids, or armv8.x on aarch64) as
+    # libggml-cpu-*.so, and ggml loads the best one for the host at runtime
     cmake .. \
         -DBUILD_SHARED_LIBS=ON \
         -DLLAMA_STATIC=OFF \
         -DCMAKE_BUILD_TYPE=Release \
-        -DCMAKE_POSITION_INDEPENDENT_CODE=ON
+        -DCMAKE_POSITION_INDEPENDENT_CODE=ON \
+        -DGGML_NATIVE=OFF \
+        -DGGML_BACKEND_DL=ON \
+        -DGGML_CPU_ALL_VARIANTS=ON
     
     # Build with all available cores
     make -j$(nproc)
@@ -177,6 +182,11 @@ build_llama_cpp() {
         exit 1
     fi
     
+    if ! ls bin/libggml-cpu-*.so &> /dev/null; then
+        log_error "No CPU backend variants (libggml-cpu-*.so) were built"
+        exit 1
+    fi
+    
     log_success "llama.cpp shared library built successfully"
 }
 
@@ -195,7 +205,8 @@ build_jni_wrapper() {
         -DCMAKE_BUILD_TYPE=Release \
         -DJAVA_HOME="$JAVA_HOME" \
         -DLLAMA_CPP_DIR="$LLAMA_CPP_DIR" \
-        -DCMAKE_POSITION_INDEPENDENT_CODE=ON
+        -DCMAKE_POSITION_INDEPENDENT_CODE=ON \
+        ${LLAMA_JNI_CMAKE_ARGS:-}
     
     # Build the JNI library
     make -j$(nproc)
@@ -206,6 +217,31 @@ build_jni_wrapper() {
         exit 1
     fi
     
+    # Optional ISA variants, picked at runtime by LlamaWrapper.loadLibrary
+    if [[ "$BUILD_JNI_VARIANTS" == "true" ]]; then
+        local variants
+        if [[ "$(uname -m)" == "aarch64" ]]; then
+            variants=("armv8.2-a")
+        else
+            variants=("x86-64-v2" "x86-64-v3" "x86-64-v4")
+        fi
+        
+        for variant in "${variants[@]}"; do
+            log_info "Building JNI variant for $variant..."
+            cmake -S "$NATIVE_DIR" -B "$NATIVE_DIR/build-$variant" \
+                -DCMAKE_BUILD_TYPE=Release \
+                -DJAVA_HOME="$JAVA_HOME" \
+                -DLLAMA_CPP_DIR="$LLAMA_CPP_DIR" \
+                -DLLAMA_JNI_ARCH="$variant" \
+                -DLLAMA_JNI_BUILD_BENCH=OFF \
+                ${LLAMA_JNI_CMAKE_ARGS:-}
+            cmake --build "$NATIVE_DIR/build-$variant" -j"$(nproc)"
+            
+            # Keep every variant next to the baseline so java.library.path finds them
+            cp "$NATIVE_DIR/build-$variant"/libllama_jni_*.so "$NATIVE_DIR/build/"
+        done
+    fi
+    
     log_success "JNI wrapper built successfully"
 }
 
@@ -278,9 +314,10 @@ package_deployment() {
         exit 1
     fi
     
-    # Copy native libraries
+    # Copy native libraries, including the ggml CPU backend and JNI variants
     cp "$BUILD_DIR/libllama.so" "$DEPLOY_DIR/"
-    cp "$BUILD_DIR/libllama_jni.so" "$DEPLOY_DIR/"
+    cp "$BUILD_DIR"/libggml*.so "$DEPLOY_DIR/"
+    cp "$BUILD_DIR"/libllama_jni*.so "$DEPLOY_DIR/"
     
     # Copy or symlink model file
     if [[ -f "$MODELS_DIR/$MODEL_FILENAME" ]]; then
@@ -355,9 +392,11 @@ setup_runtime() {
     # Create build output directory
     mkdir -p "$BUILD_DIR"
     
-    # Copy shared libraries to build directory
+    # Copy shared libraries to build directory. libllama_jni loads the ggml backends
+    # from its own directory, so they must sit next to it
     cp "$LLAMA_CPP_DIR/build/bin/libllama.so" "$BUILD_DIR/"
-    cp "$NATIVE_DIR/build/libllama_jni.so" "$BUILD_DIR/"
+    cp "$LLAMA_CPP_DIR/build/bin/"libggml*.so "$BUILD_DIR/"
+    cp "$NATIVE_DIR"/build/libllama_jni*.so "$BUILD_DIR/"
     
     # Create run script
     cat > "$BUILD_DIR/run.sh" << 'EOF'
@@ -606,6 +645,10 @@ case "${1:-}" in
         echo "  --package        Create deployment package"
         echo "  --smoke-test     Run deployment verification"
         echo "  --deploy-dir DIR Specify custom deployment location"
+        echo "  --jni-variants   Also build ISA-specific JNI libraries (x86-64-v2/v3/v4 or armv8.2-a)"
+        echo
+        echo "Set LLAMA_JNI_CMAKE_ARGS to pass extra options to the JNI builds,"
+        echo "e.g. LLAMA_JNI_CMAKE_ARGS=\"-DLLAMA_JNI_LTO=ON\""
         exit 0
         ;;
     --clean)
@@ -632,6 +675,10 @@ case "${1:-}" in
         RUN_SMOKE_TEST=true
         PACKAGE_DEPLOYMENT=true
         ;;
+    --jni-variants)
+        # Set flag to build ISA-specific JNI libraries
+        BUILD_JNI_VARIANTS=true
+        ;;
     --deploy-dir)
         if [[ -n "${2:-}" ]]; then
             DEPLOY_DIR="$2"
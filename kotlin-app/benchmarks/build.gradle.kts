@@ -0,0 +1,36 @@
+plugins {
+    kotlin("jvm")
+    id("me.champeau.jmh") version "0.7.2"
+}
+
+repositories {
+    mavenCentral()
+}
+
+dependencies {
+    jmhImplementation(project(":"))
+}
+
+kotlin {
+    jvmToolchain(21)
+}
+
+jmh {
+    jmhVersion.set("1.37")
+    
+    // Forked benchmark JVMs load libllama_jni from the native build, like the run task.
+    // Override the model with -PbenchModel=/path/to/model.gguf
+    val model = (findProperty("benchModel") as String?) ?: "${rootDir}/../models/Qwen3-0.6B-Q8_0.gguf"
+    jvmArgs.addAll(
+        "-Djava.library.path=${rootDir}/../native/build",
+        "-Dllama.bench.model=$model"
+    )
+    
+    fork.set(1)
+    warmupIterations.set(2)
+    iterations.set(5)
+    
+    // Machine-readable results for comparing runs across llama.cpp upgrades
+    resultFormat.set("JSON")
+    resultsFile.set(layout.buildDirectory.file("results/jmh/results.json"))
+}
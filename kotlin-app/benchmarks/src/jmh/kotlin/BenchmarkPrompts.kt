@@ -0,0 +1,35 @@
+package com.traycer.llama.bench
+
+import java.util.Random
+
+/**
+ * Deterministic synthetic prompts. Common English words tokenize to roughly one token
+ * each, so the word count approximates the prompt length in tokens; benchmarks that
+ * need exact counts read them from [com.traycer.llama.GenerationStats].
+ */
+object BenchmarkPrompts {
+    
+    private val WORDS = listOf(
+        "the", "model", "reads", "a", "long", "document", "about", "rivers", "and", "cities",
+        "then", "writes", "short", "summary", "of", "each", "section", "for", "its", "readers"
+    )
+    
+    /**
+     * Build a prompt of [words] words.
+     * 
+     * Different [variant]s start with a different word, so consecutive calls share no
+     * cached prefix and each one is fully prefilled.
+     * 
+     * @param words Number of words
+     * @param variant Index mixed into the seed and the leading word
+     * @return The same text for the same arguments on every run
+     */
+    fun synthetic(words: Int, variant: Int = 0): String {
+        val random = Random(ModelState.SEED + variant)
+        val builder = StringBuilder("Note $variant:")
+        repeat(words) {
+            builder.append(' ').append(WORDS[random.nextInt(WORDS.size)])
+        }
+        return builder.toString()
+    }
+}
@@ -0,0 +1,78 @@
+package com.traycer.llama.bench
+
+import com.traycer.llama.LlamaWrapper
+import java.util.concurrent.CompletableFuture
+import java.util.concurrent.ExecutorService
+import java.util.concurrent.Executors
+import java.util.concurrent.TimeUnit
+import org.openjdk.jmh.annotations.Benchmark
+import org.openjdk.jmh.annotations.BenchmarkMode
+import org.openjdk.jmh.annotations.Level
+import org.openjdk.jmh.annotations.Mode
+import org.openjdk.jmh.annotations.OutputTimeUnit
+import org.openjdk.jmh.annotations.Param
+import org.openjdk.jmh.annotations.Scope
+import org.openjdk.jmh.annotations.Setup
+import org.openjdk.jmh.annotations.State
+import org.openjdk.jmh.annotations.TearDown
+
+/**
+ * Aggregate decode throughput with [requests] concurrent generations, either on one
+ * context per request ("handles") or batched on a single context's scheduler ("scheduler").
+ */
+@State(Scope.Benchmark)
+@BenchmarkMode(Mode.Throughput)
+@OutputTimeUnit(TimeUnit.SECONDS)
+open class ConcurrencyBenchmark {
+    
+    @Param("1", "2", "4")
+    var requests: Int = 0
+    
+    @Param("handles", "scheduler")
+    var mode: String = ""
+    
+    private val wrappers = mutableListOf<LlamaWrapper>()
+    private val prompt = BenchmarkPrompts.synthetic(32)
+    private lateinit var executor: ExecutorService
+    
+    @Setup(Level.Trial)
+    fun setup(state: ModelState) {
+        // Split the machine between contexts so the runs compare equal thread budgets
+        val cores = Runtime.getRuntime().availableProcessors()
+        if (mode == "scheduler") {
+            val wrapper = state.model.createContext(ModelState.CONTEXT_SIZE)
+            wrapper.warmup()
+            wrapper.startScheduler(requests)
+            wrappers.add(wrapper)
+        } else {
+            repeat(requests) {
+                val wrapper = state.model.createContext(ModelState.CONTEXT_SIZE, maxOf(1, cores / requests))
+                wrapper.warmup()
+                wrappers.add(wrapper)
+            }
+        }
+        executor = Executors.newFixedThreadPool(requests)
+    }
+    
+    @TearDown(Level.Trial)
+    fun tearDown() {
+        executor.shutdown()
+        wrappers.forEach { it.cleanup() }
+        wrappers.clear()
+    }
+    
+    @Benchmark
+    fun generate(counter: TokenCounter) {
+        wrappers.forEach { it.setSeed(ModelState.SEED) }
+        val futures = (0 until requests).map { i ->
+            CompletableFuture.supplyAsync({
+                wrappers[i % wrappers.size].generateTextWithStats(prompt, maxTokens = DECODE_TOKENS, temperature = 0.0f)
+            }, executor)
+        }
+        futures.forEach { counter.tokens += it.join().stats.generatedTokens.toLong() }
+    }
+    
+    companion object {
+        const val DECODE_TOKENS = 64
+    }
+}
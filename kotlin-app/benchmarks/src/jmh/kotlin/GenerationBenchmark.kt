@@ -0,0 +1,63 @@
+package com.traycer.llama.bench
+
+import com.traycer.llama.LlamaWrapper
+import java.util.concurrent.TimeUnit
+import org.openjdk.jmh.annotations.Benchmark
+import org.openjdk.jmh.annotations.BenchmarkMode
+import org.openjdk.jmh.annotations.Level
+import org.openjdk.jmh.annotations.Mode
+import org.openjdk.jmh.annotations.OutputTimeUnit
+import org.openjdk.jmh.annotations.Param
+import org.openjdk.jmh.annotations.Scope
+import org.openjdk.jmh.annotations.Setup
+import org.openjdk.jmh.annotations.State
+import org.openjdk.jmh.annotations.TearDown
+
+/**
+ * Prefill and decode throughput through the Kotlin API. Sampling is greedy and seeded,
+ * so each run does the same work; [TokenCounter.tokens] reports tokens per second.
+ */
+@State(Scope.Thread)
+@BenchmarkMode(Mode.Throughput)
+@OutputTimeUnit(TimeUnit.SECONDS)
+open class GenerationBenchmark {
+    
+    @Param("32", "128", "512")
+    var promptWords: Int = 0
+    
+    private lateinit var wrapper: LlamaWrapper
+    private lateinit var decodePrompt: String
+    private var variant = 0
+    
+    @Setup(Level.Trial)
+    fun setup(state: ModelState) {
+        wrapper = state.model.createContext(ModelState.CONTEXT_SIZE)
+        wrapper.warmup()
+        decodePrompt = BenchmarkPrompts.synthetic(promptWords)
+    }
+    
+    @TearDown(Level.Trial)
+    fun tearDown() {
+        wrapper.cleanup()
+    }
+    
+    /** Prompt tokens prefilled per second; every call uses a fresh, uncached prompt */
+    @Benchmark
+    fun prefill(counter: TokenCounter) {
+        val prompt = BenchmarkPrompts.synthetic(promptWords, ++variant)
+        val stats = wrapper.generateTextWithStats(prompt, maxTokens = 1, temperature = 0.0f).stats
+        counter.tokens += (stats.promptTokens - stats.cachedTokens).toLong()
+    }
+    
+    /** Tokens decoded per second after a prompt of [promptWords] words */
+    @Benchmark
+    fun decode(counter: TokenCounter) {
+        wrapper.setSeed(ModelState.SEED)
+        val stats = wrapper.generateTextWithStats(decodePrompt, maxTokens = DECODE_TOKENS, temperature = 0.0f).stats
+        counter.tokens += stats.generatedTokens.toLong()
+    }
+    
+    companion object {
+        const val DECODE_TOKENS = 64
+    }
+}
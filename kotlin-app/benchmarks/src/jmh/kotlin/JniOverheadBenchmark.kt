@@ -0,0 +1,67 @@
+package com.traycer.llama.bench
+
+import com.traycer.llama.LlamaWrapper
+import com.traycer.llama.ModelInfo
+import java.nio.ByteBuffer
+import java.util.concurrent.TimeUnit
+import org.openjdk.jmh.annotations.Benchmark
+import org.openjdk.jmh.annotations.BenchmarkMode
+import org.openjdk.jmh.annotations.Level
+import org.openjdk.jmh.annotations.Mode
+import org.openjdk.jmh.annotations.OutputTimeUnit
+import org.openjdk.jmh.annotations.Scope
+import org.openjdk.jmh.annotations.Setup
+import org.openjdk.jmh.annotations.State
+import org.openjdk.jmh.annotations.TearDown
+
+/**
+ * Fixed per-call cost of the JNI layer: handle lookup, string marshaling and the
+ * String versus direct ByteBuffer result paths. The generate benchmarks repeat one
+ * prompt, so the KV cache holds everything but its last token and each call decodes
+ * one prompt token plus one generated token.
+ */
+@State(Scope.Thread)
+@BenchmarkMode(Mode.AverageTime)
+@OutputTimeUnit(TimeUnit.MICROSECONDS)
+open class JniOverheadBenchmark {
+    
+    private lateinit var wrapper: LlamaWrapper
+    private val prompt = BenchmarkPrompts.synthetic(32)
+    private val promptBuffer: ByteBuffer = ByteBuffer.allocateDirect(1024)
+    private val output: ByteBuffer = ByteBuffer.allocateDirect(4096)
+    
+    @Setup(Level.Trial)
+    fun setup(state: ModelState) {
+        wrapper = state.model.createContext(ModelState.CONTEXT_SIZE)
+        wrapper.setSeed(ModelState.SEED)
+        promptBuffer.put(prompt.toByteArray(Charsets.UTF_8)).flip()
+    }
+    
+    @TearDown(Level.Trial)
+    fun tearDown() {
+        wrapper.cleanup()
+    }
+    
+    /** JNI transition and context handle lookup only */
+    @Benchmark
+    fun handleRoundTrip(): Int {
+        return wrapper.getEmbeddingSize()
+    }
+    
+    /** Structured result: a filled LongArray plus a String array of metadata */
+    @Benchmark
+    fun structuredResult(): ModelInfo? {
+        return wrapper.getModelInfo()
+    }
+    
+    @Benchmark
+    fun generateOneTokenString(): String {
+        return wrapper.generateText(prompt, maxTokens = 1, temperature = 0.0f)
+    }
+    
+    @Benchmark
+    fun generateOneTokenDirect(): Int {
+        output.clear()
+        return wrapper.generateDirect(promptBuffer, output, maxTokens = 1, temperature = 0.0f).bytesWritten
+    }
+}
@@ -0,0 +1,33 @@
+package com.traycer.llama.bench
+
+import com.traycer.llama.LlamaModel
+import java.util.concurrent.TimeUnit
+import org.openjdk.jmh.annotations.Benchmark
+import org.openjdk.jmh.annotations.BenchmarkMode
+import org.openjdk.jmh.annotations.Measurement
+import org.openjdk.jmh.annotations.Mode
+import org.openjdk.jmh.annotations.OutputTimeUnit
+import org.openjdk.jmh.annotations.Warmup
+
+/**
+ * Time to load the weights and create a ready context, as at service startup.
+ * Every measurement after the first sees a warm page cache.
+ */
+@BenchmarkMode(Mode.SingleShotTime)
+@OutputTimeUnit(TimeUnit.MILLISECONDS)
+@Warmup(iterations = 1)
+@Measurement(iterations = 5)
+open class LoadBenchmark {
+    
+    @Benchmark
+    fun loadAndCreateContext(): Int {
+        LlamaModel(ModelState.modelPath()).use { model ->
+            val context = model.createContext(ModelState.CONTEXT_SIZE)
+            try {
+                return context.getEmbeddingSize()
+            } finally {
+                context.cleanup()
+            }
+        }
+    }
+}
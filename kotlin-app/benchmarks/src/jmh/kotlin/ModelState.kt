@@ -0,0 +1,43 @@
+package com.traycer.llama.bench
+
+import com.traycer.llama.LlamaModel
+import org.openjdk.jmh.annotations.Level
+import org.openjdk.jmh.annotations.Scope
+import org.openjdk.jmh.annotations.Setup
+import org.openjdk.jmh.annotations.State
+import org.openjdk.jmh.annotations.TearDown
+
+/**
+ * Model weights loaded once per trial and shared by every benchmark thread.
+ * 
+ * The model path comes from the `llama.bench.model` system property, set by the
+ * Gradle `jmh` task from `-PbenchModel`.
+ */
+@State(Scope.Benchmark)
+open class ModelState {
+    
+    lateinit var model: LlamaModel
+    
+    @Setup(Level.Trial)
+    fun load() {
+        model = LlamaModel(modelPath())
+    }
+    
+    @TearDown(Level.Trial)
+    fun close() {
+        model.close()
+    }
+    
+    companion object {
+        /** Seed applied before every measured generation */
+        const val SEED = 42L
+        
+        /** Context size large enough for the longest prompt, which may use half of it */
+        const val CONTEXT_SIZE = 2048
+        
+        fun modelPath(): String {
+            return System.getProperty("llama.bench.model")
+                ?: throw IllegalStateException("Set -Dllama.bench.model to a GGUF model path")
+        }
+    }
+}
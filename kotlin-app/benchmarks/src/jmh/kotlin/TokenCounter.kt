@@ -0,0 +1,24 @@
+package com.traycer.llama.bench
+
+import org.openjdk.jmh.annotations.AuxCounters
+import org.openjdk.jmh.annotations.Level
+import org.openjdk.jmh.annotations.Scope
+import org.openjdk.jmh.annotations.Setup
+import org.openjdk.jmh.annotations.State
+
+/**
+ * Tokens processed by a throughput benchmark. JMH reports [tokens] per second next to
+ * the operation rate, giving prefill and decode tokens/s measured through the JNI layer.
+ */
+@State(Scope.Thread)
+@AuxCounters(AuxCounters.Type.OPERATIONS)
+open class TokenCounter {
+    
+    @JvmField
+    var tokens: Long = 0
+    
+    @Setup(Level.Iteration)
+    fun reset() {
+        tokens = 0
+    }
+}
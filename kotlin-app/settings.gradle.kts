@@ -11,4 +11,6 @@ dependencyResolutionManagement {
     repositories {
         mavenCentral()
     }
-}
\ No newline at end of file
+}
+// JMH benchmarks of the JNI layer: ./gradlew :benchmarks:jmh
+include("benchmarks")
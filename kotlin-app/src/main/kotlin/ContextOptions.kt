@@ -0,0 +1,59 @@
+package com.traycer.llama
+
+/**
+ * Per-context tuning options passed to native context creation.
+ * 
+ * Fields are read natively by name, so renaming them requires updating llama_jni.cpp.
+ * A value of 0 selects the native default.
+ * 
+ * @property batchSize Maximum tokens submitted per decode call (n_batch). Long prompts
+ *                     are prefilled in chunks of this size (default: min(512, contextSize / 4))
+ * @property ubatchSize Physical micro-batch size each decode is split into (n_ubatch).
+ *                      Clamped to [batchSize] (default: same as batchSize)
+ * @property draftTokens Tokens proposed by the draft model per verification step when the
+ *                       model was loaded with one (default: 8)
+ * @property batchThreads Threads used for prompt prefill; the context's thread count is used
+ *                        for token-by-token decode (default: same as decode)
+ * @property cpuMask CPUs the context's threads may run on, as a list such as "0-15,32-47",
+ *                   e.g. the CPUs of one NUMA node (default: no pinning)
+ * @property physicalCoresOnly Use only the first SMT sibling of each physical core, both
+ *                             for auto-detected thread counts and for pinning (default: false)
+ * @property strictCpu Pin each thread to a single CPU of the mask instead of the whole mask
+ *                     (default: false)
+ * @property typeK Element type of the K cache, e.g. [KvCacheType.Q8_0] to roughly halve
+ *                 KV memory (default: native default, f16)
+ * @property typeV Element type of the V cache; quantized types need flash attention
+ *                 (default: native default, f16)
+ * @property flashAttention Flash attention mode (default: native default, auto)
+ * @property offloadKqv Keep the KV cache and attention on the GPU when layers are offloaded
+ *                      (default: true)
+ * @property contextShift Slide the window when a generation fills the context: the oldest
+ *                        tokens after the pinned prefix are discarded and the KV cache is
+ *                        shifted instead of stopping. Prompts longer than the context are
+ *                        truncated after the prefix (default: false, which limits prompts to
+ *                        half the context and stops generation when the context is full)
+ * @property keepTokens Leading prompt tokens, e.g. a system prompt, that are never discarded
+ *                      by [contextShift]; BOS is always kept. Clamped to half the context
+ *                      (default: 0)
+ * @property maxSequences Parallel sequences the KV cache is created for, shared by
+ *                        [LlamaWrapper.startScheduler], [LlamaWrapper.generateBatch] and
+ *                        [LlamaWrapper.embed]. They split the same [contextSize] cells. A
+ *                        call needing more sequences recreates the context, which drops the
+ *                        prefix cache (default: native default, one sequence)
+ */
+data class ContextOptions(
+    val batchSize: Int = 0,
+    val ubatchSize: Int = 0,
+    val draftTokens: Int = 0,
+    val batchThreads: Int = 0,
+    val cpuMask: String? = null,
+    val physicalCoresOnly: Boolean = false,
+    val strictCpu: Boolean = false,
+    val typeK: KvCacheType? = null,
+    val typeV: KvCacheType? = null,
+    val flashAttention: FlashAttention? = null,
+    val offloadKqv: Boolean = true,
+    val contextShift: Boolean = false,
+    val keepTokens: Int = 0,
+    val maxSequences: Int = 0
+)
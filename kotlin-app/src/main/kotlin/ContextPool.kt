@@ -0,0 +1,206 @@
+package com.traycer.llama
+
+/**
+ * A fixed set of contexts pre-created on shared [LlamaModel] weights and leased out one
+ * holder at a time, so serving a request costs no context, KV cache or buffer allocation.
+ * 
+ * Every context is created up front and admitted against the memory budget (see
+ * [LlamaWrapper.setMemoryBudget]). [acquire] hands out an idle one as a [LlamaWrapper];
+ * [release] or [LlamaWrapper.cleanup] gives it back. A returned context is reset on its
+ * next acquire rather than on release: the scheduler is stopped, adapters and session
+ * snapshots are cleared and the [seed] is restored, so every holder starts from the same
+ * state. With [keepPrefixCache] the cached prompt survives, and a next prompt sharing its
+ * prefix (e.g. the same system prompt) skips that part of the prefill.
+ * 
+ * The pool holds its own reference to the weights, so the model can be closed once the
+ * pool is created.
+ * 
+ * @param model Loaded model weights
+ * @param size Number of contexts in the pool
+ * @param contextSize Context size of each context (default: 2048)
+ * @param threads Number of decode threads per context (default: -1 for auto-detect, see [ContextOptions.physicalCoresOnly])
+ * @param options Context tuning options applied to every context
+ * @param seed Sampler seed restored on every acquire, or null to keep each context's
+ *             own random sequence (see [LlamaWrapper.setSeed])
+ * @param keepPrefixCache Default for [release]: keep the cached prompt for the next holder
+ * @throws IllegalArgumentException if size is not positive or seed is negative
+ * @throws IllegalStateException if the model has been closed
+ * @throws RuntimeException if any context cannot be created
+ */
+class ContextPool(
+    model: LlamaModel,
+    val size: Int,
+    contextSize: Int = 2048,
+    threads: Int = -1,
+    options: ContextOptions = ContextOptions(),
+    val seed: Long? = null,
+    val keepPrefixCache: Boolean = true
+) : AutoCloseable {
+    
+    companion object {
+        init {
+            LlamaWrapper.loadLibrary()
+        }
+    }
+    
+    // Native handle to the pool (pointer stored as long)
+    private var nativeHandle: Long = 0
+    
+    init {
+        if (size <= 0) {
+            throw IllegalArgumentException("Pool size must be positive: $size")
+        }
+        if (seed != null && seed < 0) {
+            throw IllegalArgumentException("Seed must not be negative: $seed")
+        }
+        if (!model.isLoaded()) {
+            throw IllegalStateException("Model has been closed: ${model.modelPath}")
+        }
+        
+        nativeHandle = nativeCreatePool(model.nativeHandle, size, contextSize, threads, options, seed ?: -1)
+        if (nativeHandle == 0L) {
+            throw RuntimeException("Failed to create a pool of $size contexts for model: ${model.modelPath}")
+        }
+    }
+    
+    /**
+     * Lease an idle context, waiting for one to be released if all are in use.
+     * 
+     * @param timeoutMs Maximum time to wait; 0 returns immediately, negative waits indefinitely
+     * @return A wrapper bound to the leased context, or null if none became idle in time
+     * @throws IllegalStateException if the pool has been closed
+     */
+    fun acquire(timeoutMs: Long = -1): LlamaWrapper? {
+        if (nativeHandle == 0L) {
+            throw IllegalStateException("Context pool has been closed")
+        }
+        
+        val handle = nativeAcquire(nativeHandle, timeoutMs)
+        if (handle == 0L) {
+            return null
+        }
+        val wrapper = LlamaWrapper()
+        wrapper.attachPooled(this, handle)
+        return wrapper
+    }
+    
+    /**
+     * Return a leased context. The wrapper is detached and must not be used afterwards.
+     * 
+     * @param context Wrapper returned by [acquire]
+     * @param keepPrefixCache Keep the cached prompt for the next holder
+     * @throws IllegalArgumentException if the context was not acquired from this pool
+     */
+    fun release(context: LlamaWrapper, keepPrefixCache: Boolean = this.keepPrefixCache) {
+        if (context.pool !== this) {
+            throw IllegalArgumentException("Context was not acquired from this pool")
+        }
+        context.releaseContext(keepPrefixCache)
+    }
+    
+    /**
+     * Run [block] on a leased context and release it afterwards, even if [block] throws.
+     * 
+     * @param timeoutMs Maximum time to wait for an idle context; negative waits indefinitely
+     * @param block Work to run on the context
+     * @return The result of [block]
+     * @throws IllegalStateException if no context became idle in time or the pool has been closed
+     */
+    fun <T> withContext(timeoutMs: Long = -1, block: (LlamaWrapper) -> T): T {
+        val context = acquire(timeoutMs)
+            ?: throw IllegalStateException("No pooled context became idle within $timeoutMs ms")
+        try {
+            return block(context)
+        } finally {
+            release(context)
+        }
+    }
+    
+    /**
+     * Number of contexts that can be acquired without waiting.
+     * 
+     * @return Idle context count, or 0 once the pool has been closed
+     */
+    fun idleCount(): Int {
+        return if (nativeHandle != 0L) nativeIdleCount(nativeHandle) else 0
+    }
+    
+    /**
+     * Return a context handle to the native pool.
+     * 
+     * @return false if the pool has been closed, in which case the caller frees the context
+     */
+    internal fun returnContext(handle: Long, keepPrefixCache: Boolean): Boolean {
+        return nativeHandle != 0L && nativeRelease(nativeHandle, handle, keepPrefixCache)
+    }
+    
+    /**
+     * Free the idle contexts and the pool. Contexts still leased keep working and are
+     * freed by their [LlamaWrapper.cleanup]; waiting [acquire] calls return null.
+     */
+    override fun close() {
+        if (nativeHandle != 0L) {
+            try {
+                nativeFreePool(nativeHandle)
+            } catch (e: Exception) {
+                System.err.println("Warning: Error freeing context pool: ${e.message}")
+            } finally {
+                nativeHandle = 0L
+            }
+        }
+    }
+    
+    /**
+     * Finalize method to ensure the pool is freed when garbage collected.
+     */
+    protected fun finalize() {
+        close()
+    }
+    
+    /**
+     * Native method to pre-create the pooled contexts.
+     * 
+     * @param modelHandle Native handle to the loaded weights
+     * @param size Number of contexts
+     * @param contextSize Context size of each context
+     * @param threads Number of threads per context
+     * @param options Context tuning options
+     * @param seed Seed restored on every acquire, or negative for none
+     * @return Native pool handle, or 0 on failure
+     */
+    private external fun nativeCreatePool(modelHandle: Long, size: Int, contextSize: Int, threads: Int, options: ContextOptions?, seed: Long): Long
+    
+    /**
+     * Native method to lease an idle context.
+     * 
+     * @param poolHandle Native pool handle
+     * @param timeoutMs Maximum wait, negative for indefinitely
+     * @return Native context handle, or 0 on timeout
+     */
+    private external fun nativeAcquire(poolHandle: Long, timeoutMs: Long): Long
+    
+    /**
+     * Native method to return a leased context.
+     * 
+     * @param poolHandle Native pool handle
+     * @param handle Native context handle from [nativeAcquire]
+     * @param keepPrefix Keep the cached prompt
+     * @return false if the handle is not leased from this pool
+     */
+    private external fun nativeRelease(poolHandle: Long, handle: Long, keepPrefix: Boolean): Boolean
+    
+    /**
+     * Native method to count idle contexts.
+     * 
+     * @param poolHandle Native pool handle
+     * @return Idle context count
+     */
+    private external fun nativeIdleCount(poolHandle: Long): Int
+    
+    /**
+     * Native method to free the pool.
+     * 
+     * @param poolHandle Native pool handle
+     */
+    private external fun nativeFreePool(poolHandle: Long)
+}
@@ -0,0 +1,58 @@
+package com.traycer.llama
+
+import java.io.File
+
+/**
+ * Host CPU detection used to pick the best native library variant at runtime.
+ * 
+ * Variants are built with `-DLLAMA_JNI_ARCH=<level>` (see native/CMakeLists.txt) and
+ * named after their ISA level, e.g. `libllama_jni_x86_64_v3.so`.
+ */
+object CpuFeatures {
+    
+    // Linux /proc/cpuinfo flags required by each x86-64 micro-architecture level
+    private val X86_64_V2 = setOf("cx16", "lahf_lm", "popcnt", "sse4_1", "sse4_2", "ssse3")
+    private val X86_64_V3 = X86_64_V2 + setOf("avx", "avx2", "bmi1", "bmi2", "f16c", "fma", "abm", "movbe", "xsave")
+    private val X86_64_V4 = X86_64_V3 + setOf("avx512f", "avx512bw", "avx512cd", "avx512dq", "avx512vl")
+    
+    // Armv8.1/8.2 features implied by -march=armv8.2-a (Graviton2 and later)
+    private val ARMV8_2_A = setOf("atomics", "asimdrdm", "dcpop")
+    
+    /**
+     * CPU feature flags of the host as reported by the kernel, empty if unavailable.
+     */
+    val flags: Set<String> by lazy { readFlags() }
+    
+    /**
+     * Native library names to try, best match first, ending with the portable baseline.
+     * 
+     * @param baseName Name of the portable library, e.g. "llama_jni"
+     * @return Library names for [System.loadLibrary]
+     */
+    fun libraryCandidates(baseName: String): List<String> {
+        val arch = System.getProperty("os.arch").lowercase()
+        val levels = when (arch) {
+            "amd64", "x86_64" -> listOf(
+                "x86_64_v4" to X86_64_V4,
+                "x86_64_v3" to X86_64_V3,
+                "x86_64_v2" to X86_64_V2
+            )
+            "aarch64", "arm64" -> listOf("armv8_2_a" to ARMV8_2_A)
+            else -> emptyList()
+        }
+        return levels.filter { (_, required) -> flags.containsAll(required) }
+            .map { (suffix, _) -> "${baseName}_$suffix" } + baseName
+    }
+    
+    private fun readFlags(): Set<String> {
+        val cpuinfo = File("/proc/cpuinfo")
+        if (!cpuinfo.canRead()) {
+            return emptySet()
+        }
+        // "flags" on x86, "Features" on ARM; every core reports the same set
+        val line = cpuinfo.useLines { lines ->
+            lines.firstOrNull { it.startsWith("flags") || it.startsWith("Features") }
+        } ?: return emptySet()
+        return line.substringAfter(':').trim().split(Regex("\\s+")).toSet()
+    }
+}
@@ -0,0 +1,18 @@
+package com.traycer.llama
+
+/**
+ * Outcome of [LlamaWrapper.generateDirect].
+ * 
+ * @property bytesWritten Number of UTF-8 bytes written to the output buffer
+ * @property truncated True if generation stopped because the next chunk did not fit in
+ *                     the output buffer, false if it ran to a stop condition or maxTokens
+ */
+data class DirectGenerationResult(
+    val bytesWritten: Int,
+    val truncated: Boolean
+) {
+    companion object {
+        // Status values shared with LLAMA_JNI_DIRECT_* in llama_jni.h
+        internal const val STATUS_TRUNCATED = 1
+    }
+}
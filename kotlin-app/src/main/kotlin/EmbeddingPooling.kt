@@ -0,0 +1,20 @@
+package com.traycer.llama
+
+/**
+ * How per-token embeddings are combined into one vector per text.
+ * 
+ * Values match llama.cpp's llama_pooling_type. Contexts of embedding models that
+ * declare their own pooling only accept [DEFAULT] or that same type.
+ * 
+ * @property nativeValue llama_pooling_type value passed to native code
+ */
+enum class EmbeddingPooling(val nativeValue: Int) {
+    /** The model's own pooling, or mean pooling for models without one */
+    DEFAULT(-1),
+    /** Average of all token embeddings */
+    MEAN(1),
+    /** Embedding of the first token */
+    CLS(2),
+    /** Embedding of the last token, usual for decoder-only embedding models */
+    LAST(3)
+}
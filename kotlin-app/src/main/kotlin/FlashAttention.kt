@@ -0,0 +1,14 @@
+package com.traycer.llama
+
+/**
+ * Whether a context uses the fused flash attention kernel, set through
+ * [ContextOptions.flashAttention].
+ * 
+ * @property nativeValue llama_flash_attn_type value read by native code
+ */
+enum class FlashAttention(val nativeValue: Int) {
+    /** Enable it when the backend supports it (llama.cpp default) */
+    AUTO(-1),
+    DISABLED(0),
+    ENABLED(1)
+}
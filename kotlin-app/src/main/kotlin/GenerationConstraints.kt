@@ -0,0 +1,74 @@
+package com.traycer.llama
+
+/**
+ * Constraints evaluated natively while a generation runs, so no tokens are spent on
+ * output that would be trimmed or rejected afterwards.
+ * 
+ * [priority], [deadlineMs] and [tenant] only take effect while the scheduler is running
+ * (see [LlamaWrapper.startScheduler]); single-sequence calls run one at a time in call order.
+ * 
+ * Fields are read natively by name, so renaming them requires updating llama_jni.cpp.
+ * 
+ * @property stop Strings that end generation at the token completing the first of them.
+ *                The stop string itself is not returned, and text that may still turn
+ *                into one is held back until it is decided
+ * @property grammar GBNF grammar every sampled token must satisfy, e.g. [JSON_GRAMMAR],
+ *                   or null for unconstrained output
+ * @property grammarRoot Start rule of [grammar] (default: "root")
+ * @property priority Scheduling class; more urgent requests are admitted first and may
+ *                    preempt less urgent ones
+ * @property deadlineMs Time from submission after which the request fails with
+ *                      "Error: Deadline exceeded", whether queued or running; 0 for none.
+ *                      Within a class and tenant, earlier deadlines are admitted first
+ * @property tenant Requests of different tenants in the same class share decode capacity
+ *                  fairly, so one tenant's bulk job cannot starve another; null for the
+ *                  shared default tenant
+ */
+data class GenerationConstraints(
+    val stop: List<String> = emptyList(),
+    val grammar: String? = null,
+    val grammarRoot: String = "root",
+    val priority: RequestPriority = RequestPriority.NORMAL,
+    val deadlineMs: Long = 0,
+    val tenant: String? = null
+) {
+    companion object {
+        /**
+         * GBNF grammar accepting any JSON object, as in llama.cpp's grammars/json.gbnf.
+         */
+        val JSON_GRAMMAR = """
+            root   ::= object
+            value  ::= object | array | string | number | ("true" | "false" | "null") ws
+
+            object ::=
+              "{" ws (
+                        string ":" ws value
+                ("," ws string ":" ws value)*
+              )? "}" ws
+
+            array  ::=
+              "[" ws (
+                        value
+                ("," ws value)*
+              )? "]" ws
+
+            string ::=
+              "\"" (
+                [^"\\\x7F\x00-\x1F] |
+                "\\" (["\\bfnrt] | "u" [0-9a-fA-F]{4})
+              )* "\"" ws
+
+            number ::= ("-"? ([0-9] | [1-9] [0-9]{0,15})) ("." [0-9]+)? ([eE] [-+]? [0-9] [1-9]{0,15})? ws
+
+            ws ::= | " " | "\n" [ \t]{0,20}
+        """.trimIndent()
+
+        /**
+         * Constrain output to a single JSON object.
+         * 
+         * @param stop Optional stop strings
+         * @return Constraints using [JSON_GRAMMAR]
+         */
+        fun json(stop: List<String> = emptyList()) = GenerationConstraints(stop = stop, grammar = JSON_GRAMMAR)
+    }
+}
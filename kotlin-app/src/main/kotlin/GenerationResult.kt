@@ -0,0 +1,12 @@
+package com.traycer.llama
+
+/**
+ * Generated text together with the metrics of the call that produced it.
+ * 
+ * @property text Generated text
+ * @property stats Native timings and token counts
+ */
+data class GenerationResult(
+    val text: String,
+    val stats: GenerationStats
+)
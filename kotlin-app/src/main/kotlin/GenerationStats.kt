@@ -0,0 +1,90 @@
+package com.traycer.llama
+
+/**
+ * Performance metrics of a single generation, measured natively with a monotonic clock.
+ * 
+ * All times are in milliseconds. With the scheduler running, [queueMs] is the time spent
+ * waiting for a free sequence slot and [prefillMs] may include decode steps of other
+ * requests sharing the batch.
+ * 
+ * @property promptTokens Number of prompt tokens
+ * @property cachedTokens Prompt tokens served from the KV cache instead of being prefilled
+ * @property generatedTokens Number of tokens generated (end-of-generation excluded)
+ * @property queueMs Time spent waiting in the scheduler queue
+ * @property tokenizeMs Time spent tokenizing the prompt
+ * @property prefillMs Time spent decoding the uncached part of the prompt
+ * @property timeToFirstTokenMs Time from the start of the call to the first sampled token
+ * @property decodeMs Time from the end of prefill to the last sampled token
+ * @property totalMs Total native time of the call
+ * @property kvCacheUsed KV cache cells in use when generation finished
+ * @property kvCacheSize Total KV cache cells (context size)
+ * @property draftRounds Speculative draft-and-verify steps (0 without a draft model)
+ * @property draftTokens Tokens proposed by the draft model
+ * @property acceptedDraftTokens Proposed tokens the target model accepted
+ * @property discardedTokens Tokens dropped from the window by prompt truncation or context
+ *                           shifts (0 unless [ContextOptions.contextShift] is set)
+ * @property preemptions Times the scheduler evicted the request for a more urgent one;
+ *                       [queueMs] includes the time spent waiting to resume
+ */
+data class GenerationStats(
+    val promptTokens: Int,
+    val cachedTokens: Int,
+    val generatedTokens: Int,
+    val queueMs: Double,
+    val tokenizeMs: Double,
+    val prefillMs: Double,
+    val timeToFirstTokenMs: Double,
+    val decodeMs: Double,
+    val totalMs: Double,
+    val kvCacheUsed: Int,
+    val kvCacheSize: Int,
+    val draftRounds: Int = 0,
+    val draftTokens: Int = 0,
+    val acceptedDraftTokens: Int = 0,
+    val discardedTokens: Int = 0,
+    val preemptions: Int = 0
+) {
+    /** Prompt tokens prefilled per second, excluding tokens reused from the cache. */
+    val prefillTokensPerSecond: Double
+        get() = if (prefillMs > 0) (promptTokens - cachedTokens) * 1000.0 / prefillMs else 0.0
+    
+    /** Generated tokens per second during the decode phase. */
+    val decodeTokensPerSecond: Double
+        get() = if (decodeMs > 0) generatedTokens * 1000.0 / decodeMs else 0.0
+    
+    /** Fraction of drafted tokens accepted by the target model, between 0 and 1. */
+    val draftAcceptanceRate: Double
+        get() = if (draftTokens > 0) acceptedDraftTokens.toDouble() / draftTokens else 0.0
+    
+    /** Average number of tokens proposed per speculative step. */
+    val meanDraftLength: Double
+        get() = if (draftRounds > 0) draftTokens.toDouble() / draftRounds else 0.0
+    
+    /** Fraction of the KV cache in use, between 0 and 1. */
+    val kvCacheUsage: Double
+        get() = if (kvCacheSize > 0) kvCacheUsed.toDouble() / kvCacheSize else 0.0
+    
+    companion object {
+        // Array layout shared with LLAMA_JNI_STAT_* in llama_jni.h
+        internal const val FIELD_COUNT = 16
+        
+        internal fun fromArray(values: DoubleArray) = GenerationStats(
+            promptTokens = values[0].toInt(),
+            cachedTokens = values[1].toInt(),
+            generatedTokens = values[2].toInt(),
+            queueMs = values[3],
+            tokenizeMs = values[4],
+            prefillMs = values[5],
+            timeToFirstTokenMs = values[6],
+            decodeMs = values[7],
+            totalMs = values[8],
+            kvCacheUsed = values[9].toInt(),
+            kvCacheSize = values[10].toInt(),
+            draftRounds = values[11].toInt(),
+            draftTokens = values[12].toInt(),
+            acceptedDraftTokens = values[13].toInt(),
+            discardedTokens = values[14].toInt(),
+            preemptions = values[15].toInt()
+        )
+    }
+}
@@ -0,0 +1,22 @@
+package com.traycer.llama
+
+/**
+ * Element type of a context's K or V cache, set through [ContextOptions.typeK] and
+ * [ContextOptions.typeV]. Quantized types shrink per-context memory at a small
+ * quality cost; a quantized V cache requires flash attention.
+ * 
+ * @property nativeValue ggml_type value read by native code
+ */
+enum class KvCacheType(val nativeValue: Int) {
+    F32(0),
+    /** llama.cpp default */
+    F16(1),
+    BF16(30),
+    /** About half the memory of F16 with near-lossless quality */
+    Q8_0(8),
+    Q5_1(7),
+    Q5_0(6),
+    Q4_1(3),
+    /** About a quarter of the memory of F16 */
+    Q4_0(2)
+}
@@ -0,0 +1,178 @@
+package com.traycer.llama
+
+import java.io.File
+
+/**
+ * Loaded GGUF model weights that can be shared by many [LlamaWrapper] contexts.
+ * 
+ * The weights are memory-mapped once and reference-counted natively: closing the
+ * model only releases this handle, and the weights stay loaded until the last
+ * context created from them is cleaned up.
+ * 
+ * With a [draftModelPath], contexts created from this model use speculative decoding:
+ * the small draft model proposes tokens that the target verifies in one batched decode.
+ * The draft must share the target's vocabulary, e.g. a smaller model of the same family.
+ * 
+ * @param modelPath Path to the GGUF model file
+ * @param draftModelPath Optional path to a smaller GGUF draft model
+ * @param options Loader settings such as mlock, GPU offload and a progress listener
+ * @throws IllegalArgumentException if a model path is invalid
+ * @throws RuntimeException if model loading fails
+ */
+class LlamaModel(
+    val modelPath: String,
+    val draftModelPath: String? = null,
+    options: ModelLoadOptions = ModelLoadOptions()
+) : AutoCloseable {
+    
+    companion object {
+        init {
+            LlamaWrapper.loadLibrary()
+        }
+    }
+    
+    // Native handle to the loaded weights (pointer stored as long)
+    internal var nativeHandle: Long = 0
+        private set
+    
+    init {
+        val modelFile = File(modelPath)
+        if (!modelFile.exists()) {
+            throw IllegalArgumentException("Model file does not exist: $modelPath")
+        }
+        if (!modelFile.canRead()) {
+            throw IllegalArgumentException("Cannot read model file: $modelPath")
+        }
+        if (draftModelPath != null && !File(draftModelPath).canRead()) {
+            throw IllegalArgumentException("Cannot read draft model file: $draftModelPath")
+        }
+        
+        nativeHandle = nativeLoadModel(modelPath, draftModelPath, options)
+        if (nativeHandle == 0L) {
+            throw RuntimeException("Failed to load model: $modelPath" + (draftModelPath?.let { " with draft $it" } ?: ""))
+        }
+    }
+    
+    /**
+     * Create a new inference context that shares these weights.
+     * 
+     * @param contextSize Context size for the model (default: 2048)
+     * @param threads Number of decode threads (default: -1 for auto-detect, see [ContextOptions.physicalCoresOnly])
+     * @param options Context tuning options such as batch sizes
+     * @return A wrapper bound to the new context
+     * @throws IllegalStateException if the model has been closed
+     * @throws RuntimeException if context creation fails
+     */
+    fun createContext(contextSize: Int = 2048, threads: Int = -1, options: ContextOptions = ContextOptions()): LlamaWrapper {
+        val wrapper = LlamaWrapper()
+        wrapper.attachModel(this, contextSize, threads, options)
+        return wrapper
+    }
+    
+    /**
+     * Pre-create a pool of contexts that share these weights, for serving many short
+     * requests without creating a context per request.
+     * 
+     * @param size Number of contexts in the pool
+     * @param contextSize Context size of each context (default: 2048)
+     * @param threads Number of decode threads per context (default: -1 for auto-detect)
+     * @param options Context tuning options applied to every context
+     * @param seed Sampler seed restored on every acquire, or null to keep each context's own
+     * @param keepPrefixCache Keep a released context's cached prompt for its next holder
+     * @return The pool, holding its own reference to the weights
+     * @throws IllegalStateException if the model has been closed
+     * @throws RuntimeException if any context cannot be created
+     */
+    fun createContextPool(
+        size: Int,
+        contextSize: Int = 2048,
+        threads: Int = -1,
+        options: ContextOptions = ContextOptions(),
+        seed: Long? = null,
+        keepPrefixCache: Boolean = true
+    ): ContextPool {
+        return ContextPool(this, size, contextSize, threads, options, seed, keepPrefixCache)
+    }
+    
+    /**
+     * Load a LoRA adapter trained on these weights. It can then be applied to any
+     * context created from this model with [LlamaWrapper.setAdapters].
+     * 
+     * @param path Path to the GGUF adapter file, e.g. from llama.cpp's convert_lora_to_gguf.py
+     * @return The loaded adapter
+     * @throws IllegalStateException if the model has been closed
+     * @throws IllegalArgumentException if the adapter file cannot be read
+     * @throws RuntimeException if the adapter does not match the model
+     */
+    fun loadAdapter(path: String): LoraAdapter {
+        if (nativeHandle == 0L) {
+            throw IllegalStateException("Model has been closed: $modelPath")
+        }
+        if (!File(path).canRead()) {
+            throw IllegalArgumentException("Cannot read adapter file: $path")
+        }
+        
+        val handle = nativeLoadAdapter(nativeHandle, path)
+        if (handle == 0L) {
+            throw RuntimeException("Failed to load adapter: $path")
+        }
+        return LoraAdapter(path, handle)
+    }
+    
+    /**
+     * Check if the model handle is still open.
+     * 
+     * @return true if contexts can still be created from this model
+     */
+    fun isLoaded(): Boolean {
+        return nativeHandle != 0L
+    }
+    
+    /**
+     * Release this handle to the weights. Contexts already created keep working.
+     */
+    override fun close() {
+        if (nativeHandle != 0L) {
+            try {
+                nativeFreeModel(nativeHandle)
+            } catch (e: Exception) {
+                System.err.println("Warning: Error releasing model: ${e.message}")
+            } finally {
+                nativeHandle = 0L
+            }
+        }
+    }
+    
+    /**
+     * Finalize method to ensure the handle is released when garbage collected.
+     */
+    protected fun finalize() {
+        close()
+    }
+    
+    /**
+     * Native method to load GGUF model weights.
+     * 
+     * @param modelPath Path to the model file
+     * @param draftModelPath Path to the draft model file, or null
+     * @param options Loader settings
+     * @return Native handle to the loaded weights
+     */
+    private external fun nativeLoadModel(modelPath: String, draftModelPath: String?, options: ModelLoadOptions?): Long
+    
+    /**
+     * Native method to load a LoRA adapter onto the weights.
+     * 
+     * @param modelHandle Native handle to the loaded weights
+     * @param path Path to the adapter file
+     * @return Native adapter handle, or 0 on failure
+     */
+    private external fun nativeLoadAdapter(modelHandle: Long, path: String): Long
+    
+    /**
+     * Native method to release a model handle.
+     * 
+     * @param modelHandle Native handle to the loaded weights
+     */
+    private external fun nativeFreeModel(modelHandle: Long)
+}
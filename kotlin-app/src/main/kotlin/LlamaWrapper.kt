@@ -1,6 +1,17 @@
 package com.traycer.llama
 
 import java.io.File
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.FloatBuffer
+import java.util.concurrent.CompletableFuture
+import kotlinx.coroutines.Dispatchers
+import kotlinx.coroutines.channels.trySendBlocking
+import kotlinx.coroutines.flow.Flow
+import kotlinx.coroutines.flow.channelFlow
+import kotlinx.coroutines.flow.flowOn
+import kotlinx.coroutines.future.await
+import kotlinx.coroutines.isActive
 
 /**
  * Kotlin wrapper for llama.cpp native library integration via JNI.
@@ -11,115 +22,998 @@ class LlamaWrapper {
     companion object {
         private var isLibraryLoaded = false
         
+        // LLAMA_JNI_ERR_INVALID_PARAMS in llama_jni.h
+        private const val ERR_INVALID_PARAMS = 6
+        
+        /**
+         * Name of the native library that was loaded, e.g. "llama_jni_x86_64_v3",
+         * or null before [loadLibrary].
+         */
+        var loadedLibraryName: String? = null
+            private set
+        
         /**
          * Load the native library. This should be called before using any other methods.
+         * 
+         * The most specific ISA variant the host CPU supports is tried first, falling
+         * back to the portable "llama_jni". Set the `llama.jni.library` system property
+         * to force a particular library name.
          */
+        @Synchronized
         fun loadLibrary() {
             if (!isLibraryLoaded) {
-                try {
-                    System.loadLibrary("llama_jni")
-                    isLibraryLoaded = true
-                } catch (e: UnsatisfiedLinkError) {
-                    throw RuntimeException("Failed to load native library 'llama_jni'. Make sure the library is in the java.library.path.", e)
+                val forced = System.getProperty("llama.jni.library")
+                val candidates = if (forced != null) listOf(forced) else CpuFeatures.libraryCandidates("llama_jni")
+                var lastError: UnsatisfiedLinkError? = null
+                for (name in candidates) {
+                    try {
+                        System.loadLibrary(name)
+                        loadedLibraryName = name
+                        isLibraryLoaded = true
+                        return
+                    } catch (e: UnsatisfiedLinkError) {
+                        // Variant not shipped or not loadable on this host; try the next one
+                        lastError = e
+                    }
                 }
+                throw RuntimeException("Failed to load native library '${candidates.last()}'. Make sure the library is in the java.library.path.", lastError)
+            }
+        }
+        
+        /**
+         * Set the number of native threads serving [generateAsync]. Must be called
+         * before the first asynchronous generation starts the pool.
+         * 
+         * @param count Number of worker threads (default: 4)
+         * @throws IllegalArgumentException if count is not positive
+         * @throws IllegalStateException if the pool has already started
+         */
+        fun setAsyncWorkerCount(count: Int) {
+            if (count <= 0) {
+                throw IllegalArgumentException("Worker count must be positive: $count")
             }
+            if (!nativeSetAsyncWorkers(count)) {
+                throw IllegalStateException("Async worker pool has already started")
+            }
+        }
+        
+        /**
+         * Select ggml's NUMA strategy for the whole process. Must be called once,
+         * before the first model is loaded, because weights are placed at load time.
+         * 
+         * @param strategy NUMA placement strategy
+         * @throws IllegalStateException if a model was already loaded or NUMA was already initialized
+         */
+        fun initNuma(strategy: NumaStrategy) {
+            if (!nativeInitNuma(strategy.nativeValue)) {
+                throw IllegalStateException("NUMA must be initialized once, before the first model is loaded")
+            }
+        }
+        
+        /**
+         * Cap the memory all models and contexts in this process may use, so that loads
+         * fail cleanly instead of the JVM being OOM-killed by a cgroup limit.
+         * 
+         * Weights are reserved by file size before they are loaded; each context reserves
+         * its KV cache before creation and its compute buffers once llama.cpp has sized
+         * them. A load or context that does not fit fails, after waiting up to
+         * [queueTimeoutMs] for other models or contexts to be freed. Lowering the limit
+         * does not affect what is already loaded.
+         * 
+         * Compute buffer sizes are taken from what llama.cpp logs while creating a
+         * context; while a limit is set, a context whose sizes it did not report is
+         * rejected rather than admitted as free. Log lines are still passed to the logger
+         * installed before the library's own.
+         * 
+         * @param limitBytes Budget in bytes, 0 for unlimited (the default)
+         * @param queueTimeoutMs How long a load may wait for memory to be released (default: 0, fail at once)
+         * @throws IllegalArgumentException if a value is negative
+         */
+        fun setMemoryBudget(limitBytes: Long, queueTimeoutMs: Long = 0) {
+            if (!nativeSetMemoryBudget(limitBytes, queueTimeoutMs)) {
+                throw IllegalArgumentException("Memory budget and timeout must not be negative: $limitBytes, $queueTimeoutMs")
+            }
+        }
+        
+        /**
+         * Get the configured memory budget and how much of it is reserved.
+         * 
+         * @return Current budget
+         */
+        fun getMemoryBudget(): MemoryBudget {
+            val values = nativeGetMemoryBudget() ?: throw RuntimeException("Failed to read memory budget")
+            return MemoryBudget(limitBytes = values[0], reservedBytes = values[1])
+        }
+        
+        /**
+         * Snapshot the native metrics of the whole process: decode latency, batch fill,
+         * queue depth, KV occupancy, token counters, handle counts and JNI marshaling
+         * time. Recording is always on and lock-free; reading is cheap enough for every scrape.
+         * 
+         * @return Current metrics; use [NativeMetrics.toPrometheus] for export
+         */
+        fun getMetrics(): NativeMetrics {
+            val values = nativeGetMetrics() ?: throw RuntimeException("Failed to read native metrics")
+            return NativeMetrics.fromArray(values)
+        }
+        
+        /**
+         * Start or stop recording native trace events: every llama_decode call with its
+         * token count, every generation and every preemption. Events go to a fixed ring
+         * buffer, so tracing can stay enabled in production and be dumped after a stall.
+         * 
+         * @param enabled Whether events are recorded
+         */
+        fun setTracing(enabled: Boolean) {
+            if (!nativeSetTracing(enabled)) {
+                throw RuntimeException("Failed to ${if (enabled) "enable" else "disable"} tracing")
+            }
+        }
+        
+        /**
+         * Dump the recorded trace events as Chrome trace JSON, which Perfetto
+         * (ui.perfetto.dev) and chrome://tracing open directly.
+         * 
+         * @param clear Whether to drop the dumped events (default: false)
+         * @return Trace JSON; empty of events if tracing was never enabled
+         */
+        fun dumpTrace(clear: Boolean = false): String {
+            return nativeDumpTrace(clear) ?: throw RuntimeException("Failed to dump trace")
+        }
+        
+        /**
+         * Native method to initialize NUMA placement.
+         * 
+         * @param strategy ggml_numa_strategy value
+         * @return true if applied
+         */
+        @JvmStatic
+        private external fun nativeInitNuma(strategy: Int): Boolean
+        
+        /**
+         * Native method to size the async worker pool.
+         * 
+         * @param count Number of worker threads
+         * @return true if applied, false if the pool already started
+         */
+        @JvmStatic
+        private external fun nativeSetAsyncWorkers(count: Int): Boolean
+        
+        /**
+         * Native method to set the memory budget.
+         * 
+         * @param limitBytes Budget in bytes, 0 for unlimited
+         * @param waitMs How long a reservation may wait
+         * @return true if applied
+         */
+        @JvmStatic
+        private external fun nativeSetMemoryBudget(limitBytes: Long, waitMs: Long): Boolean
+        
+        /**
+         * Native method to read the memory budget.
+         * 
+         * @return Array of [limit, reserved] bytes
+         */
+        @JvmStatic
+        private external fun nativeGetMemoryBudget(): LongArray?
+        
+        /**
+         * Native method to snapshot the metrics.
+         * 
+         * @return Scalars in LLAMA_JNI_METRIC_* order followed by the histograms
+         */
+        @JvmStatic
+        private external fun nativeGetMetrics(): DoubleArray?
+        
+        /**
+         * Native method to enable or disable tracing.
+         * 
+         * @param enabled Whether events are recorded
+         * @return true if applied
+         */
+        @JvmStatic
+        private external fun nativeSetTracing(enabled: Boolean): Boolean
+        
+        /**
+         * Native method to dump the trace ring buffer.
+         * 
+         * @param clear Whether to drop the dumped events
+         * @return Chrome trace JSON
+         */
+        @JvmStatic
+        private external fun nativeDumpTrace(clear: Boolean): String?
+        
+        init {
+            loadLibrary()
+        }
+    }
+    
+    // Native handle to the llama context (pointer stored as long)
+    private var nativeHandle: Long = 0
+    private var isModelLoaded = false
+    
+    // Pool the context was acquired from; cleanup() returns it there instead of freeing it
+    internal var pool: ContextPool? = null
+        private set
+    
+    /**
+     * Load a GGUF model from the specified file path.
+     * 
+     * The weights are owned by this wrapper's context and freed by [cleanup].
+     * Use [LlamaModel] with [attachModel] to share one set of weights across contexts.
+     * 
+     * @param modelPath Path to the GGUF model file
+     * @param contextSize Context size for the model (default: 2048)
+     * @param threads Number of decode threads (default: -1 for auto-detect, see [ContextOptions.physicalCoresOnly])
+     * @param options Context tuning options such as batch sizes
+     * @param draftModelPath Optional smaller model with the same vocabulary for speculative decoding
+     * @param loadOptions Loader settings such as mlock, GPU offload and a progress listener
+     * @throws IllegalArgumentException if the model path is invalid
+     * @throws RuntimeException if model loading fails
+     */
+    fun loadModel(
+        modelPath: String,
+        contextSize: Int = 2048,
+        threads: Int = -1,
+        options: ContextOptions = ContextOptions(),
+        draftModelPath: String? = null,
+        loadOptions: ModelLoadOptions = ModelLoadOptions()
+    ) {
+        if (isModelLoaded) {
+            cleanup()
+        }
+        
+        try {
+            // The context keeps its own reference, so the model handle can be released right away
+            LlamaModel(modelPath, draftModelPath, loadOptions).use { model ->
+                attachModel(model, contextSize, threads, options)
+            }
+        } catch (e: IllegalArgumentException) {
+            throw e
+        } catch (e: Exception) {
+            throw RuntimeException("Error loading model: ${e.message}", e)
+        }
+    }
+    
+    /**
+     * Create this wrapper's context on already loaded, shared model weights.
+     * 
+     * @param model Loaded model weights
+     * @param contextSize Context size for the model (default: 2048)
+     * @param threads Number of decode threads (default: -1 for auto-detect, see [ContextOptions.physicalCoresOnly])
+     * @param options Context tuning options such as batch sizes
+     * @throws IllegalStateException if the model has been closed
+     * @throws RuntimeException if context creation fails
+     */
+    fun attachModel(model: LlamaModel, contextSize: Int = 2048, threads: Int = -1, options: ContextOptions = ContextOptions()) {
+        if (!model.isLoaded()) {
+            throw IllegalStateException("Model has been closed: ${model.modelPath}")
+        }
+        
+        if (isModelLoaded) {
+            cleanup()
+        }
+        
+        nativeHandle = nativeCreateContext(model.nativeHandle, contextSize, threads, options)
+        if (nativeHandle == 0L) {
+            throw RuntimeException("Failed to create context for model: ${model.modelPath}")
+        }
+        isModelLoaded = true
+    }
+    
+    /**
+     * Bind this wrapper to a context leased from a [ContextPool].
+     * 
+     * @param pool Pool the context was acquired from
+     * @param handle Native handle of the leased context
+     */
+    internal fun attachPooled(pool: ContextPool, handle: Long) {
+        nativeHandle = handle
+        isModelLoaded = true
+        this.pool = pool
+    }
+    
+    /**
+     * Load a LoRA adapter onto this context's model weights. Other contexts sharing the
+     * weights can apply it too.
+     * 
+     * @param path Path to the GGUF adapter file
+     * @return The loaded adapter
+     * @throws IllegalStateException if no model is loaded
+     * @throws IllegalArgumentException if the adapter file cannot be read
+     * @throws RuntimeException if the adapter does not match the model
+     */
+    fun loadAdapter(path: String): LoraAdapter {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        if (!File(path).canRead()) {
+            throw IllegalArgumentException("Cannot read adapter file: $path")
+        }
+        
+        val handle = nativeLoadAdapter(nativeHandle, path)
+        if (handle == 0L) {
+            throw RuntimeException("Failed to load adapter: $path")
+        }
+        return LoraAdapter(path, handle)
+    }
+    
+    /**
+     * Select the LoRA adapters this context generates with, replacing the previous
+     * selection; an empty list restores the base model.
+     * 
+     * Selecting the adapters that are already applied costs nothing. Any other change
+     * clears the KV cache, since cached prefixes were computed with other weights, and
+     * saved states from [saveState] should only be restored under the adapters they
+     * were saved with. Adapters apply to every sequence, so this is refused while the
+     * scheduler is running; use one context per variant on a shared [LlamaModel] instead.
+     * 
+     * @param adapters Adapters loaded on this context's weights, with their scales (typically 1.0)
+     * @throws IllegalStateException if no model is loaded or the scheduler is running
+     * @throws IllegalArgumentException if an adapter was loaded on other weights
+     */
+    fun setAdapters(adapters: List<Pair<LoraAdapter, Float>>) {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        
+        val handles = LongArray(adapters.size) { adapters[it].first.nativeHandle }
+        val scales = FloatArray(adapters.size) { adapters[it].second }
+        if (!nativeSetAdapters(nativeHandle, handles, scales)) {
+            throw IllegalArgumentException("Failed to apply adapters; they must be loaded on this model and the scheduler stopped")
+        }
+    }
+    
+    /**
+     * Generate text based on the given prompt.
+     * 
+     * The KV cache from the previous call is kept, so only the part of the prompt
+     * after the prefix it shares with the last prompt and response is prefilled.
+     * 
+     * @param prompt The input prompt for text generation
+     * @param maxTokens Maximum number of tokens to generate (default: 256)
+     * @param temperature Temperature for sampling, 0 for greedy decoding (default: 0.8)
+     * @param topP Top-p sampling parameter (default: 0.9)
+     * @param topK Top-k sampling parameter, 0 to disable (default: 40)
+     * @param constraints Stop strings, grammar and scheduling class (default: none)
+     * @return Generated text as a string
+     * @throws IllegalStateException if no model is loaded
+     * @throws RuntimeException if text generation fails
+     */
+    fun generateText(
+        prompt: String, 
+        maxTokens: Int = 256, 
+        temperature: Float = 0.8f,
+        topP: Float = 0.9f,
+        topK: Int = 40,
+        constraints: GenerationConstraints? = null
+    ): String {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        
+        if (prompt.isBlank()) {
+            throw IllegalArgumentException("Prompt cannot be empty or blank")
+        }
+        
+        val result = try {
+            nativeGenerateText(nativeHandle, prompt, maxTokens, temperature, topP, topK, constraints)
+                ?: throw RuntimeException("Text generation returned null result")
+        } catch (e: Exception) {
+            throw RuntimeException("Error during text generation: ${e.message}", e)
+        }
+        // Deadlines, a full KV cache, invalid grammars and a stopped scheduler come back as "Error: ..."
+        if (result.startsWith("Error: ")) {
+            throw RuntimeException("Error during text generation: $result")
+        }
+        return result
+    }
+    
+    /**
+     * Generate text and report where the time went: tokenization, prefill,
+     * time-to-first-token, decode throughput and KV cache usage.
+     * 
+     * @param prompt The input prompt for text generation
+     * @param maxTokens Maximum number of tokens to generate (default: 256)
+     * @param temperature Temperature for sampling, 0 for greedy decoding (default: 0.8)
+     * @param topP Top-p sampling parameter (default: 0.9)
+     * @param topK Top-k sampling parameter, 0 to disable (default: 40)
+     * @param constraints Stop strings, grammar and scheduling class (default: none)
+     * @return Generated text and its [GenerationStats]
+     * @throws IllegalStateException if no model is loaded
+     * @throws RuntimeException if text generation fails
+     */
+    fun generateTextWithStats(
+        prompt: String,
+        maxTokens: Int = 256,
+        temperature: Float = 0.8f,
+        topP: Float = 0.9f,
+        topK: Int = 40,
+        constraints: GenerationConstraints? = null
+    ): GenerationResult {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        
+        if (prompt.isBlank()) {
+            throw IllegalArgumentException("Prompt cannot be empty or blank")
+        }
+        
+        // Failures are thrown natively with the error message, so a returned result is always a success
+        val stats = DoubleArray(GenerationStats.FIELD_COUNT)
+        val result = nativeGenerateWithStats(nativeHandle, prompt, maxTokens, temperature, topP, topK, constraints, stats)
+            ?: throw RuntimeException("Text generation returned null result")
+        return GenerationResult(result, GenerationStats.fromArray(stats))
+    }
+    
+    /**
+     * Tokenize text with the model's vocabulary, e.g. to cache a prompt template once
+     * and pass it to [generateFromTokens] on every turn.
+     * 
+     * @param text Text to tokenize
+     * @param addBos Prepend the model's BOS token when it uses one (default: true)
+     * @return Token IDs
+     * @throws IllegalStateException if no model is loaded
+     * @throws RuntimeException if tokenization fails
+     */
+    fun tokenize(text: String, addBos: Boolean = true): IntArray {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        return nativeTokenize(nativeHandle, text, addBos)
+            ?: throw RuntimeException("Tokenization failed")
+    }
+    
+    /**
+     * Convert token IDs back to text.
+     * 
+     * @param tokens Token IDs from [tokenize] or any other source
+     * @return Decoded text
+     * @throws IllegalStateException if no model is loaded
+     * @throws IllegalArgumentException if an ID is outside the vocabulary
+     */
+    fun detokenize(tokens: IntArray): String {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        return nativeDetokenize(nativeHandle, tokens)
+            ?: throw IllegalArgumentException("Token IDs are not valid for this model")
+    }
+    
+    /**
+     * Generate text from a prompt that is already tokenized, skipping native
+     * tokenization. Otherwise identical to [generateText], including KV cache reuse.
+     * 
+     * @param tokens Prompt token IDs, starting with BOS when the model uses one
+     * @param maxTokens Maximum number of tokens to generate (default: 256)
+     * @param temperature Temperature for sampling, 0 for greedy decoding (default: 0.8)
+     * @param topP Top-p sampling parameter (default: 0.9)
+     * @param topK Top-k sampling parameter, 0 to disable (default: 40)
+     * @param constraints Stop strings, grammar and scheduling class (default: none)
+     * @return Generated text as a string
+     * @throws IllegalStateException if no model is loaded
+     * @throws RuntimeException if text generation fails
+     */
+    fun generateFromTokens(
+        tokens: IntArray,
+        maxTokens: Int = 256,
+        temperature: Float = 0.8f,
+        topP: Float = 0.9f,
+        topK: Int = 40,
+        constraints: GenerationConstraints? = null
+    ): String {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        
+        if (tokens.isEmpty()) {
+            throw IllegalArgumentException("Prompt tokens cannot be empty")
+        }
+        
+        val result = nativeGenerateTokens(nativeHandle, tokens, maxTokens, temperature, topP, topK, constraints)
+            ?: throw RuntimeException("Text generation returned null result")
+        if (result.startsWith("Error: ")) {
+            throw RuntimeException("Error during text generation: $result")
+        }
+        return result
+    }
+    
+    /**
+     * Generate text for many prompts in one native call.
+     * 
+     * Each prompt runs as its own sequence: prompts are prefilled together in shared
+     * batches and decoded in lockstep until each finishes, which keeps all cores busy
+     * for offline evaluation and bulk tagging. Uses the scheduler when [startScheduler]
+     * is active; otherwise up to 16 prompts run at a time and the KV cache kept for
+     * [generateText] prefix reuse is cleared. Create the context with
+     * [ContextOptions.maxSequences] of at least 16, or the prompt count if smaller, to
+     * avoid recreating it on the first call.
+     * 
+     * @param prompts The input prompts
+     * @param maxTokens Maximum number of tokens to generate per prompt (default: 256)
+     * @param temperature Temperature for sampling, 0 for greedy decoding (default: 0.8)
+     * @param topP Top-p sampling parameter (default: 0.9)
+     * @param topK Top-k sampling parameter, 0 to disable (default: 40)
+     * @param constraints Stop strings, grammar and scheduling class (default: none)
+     * @return Generated texts, in the order of [prompts]
+     * @throws IllegalStateException if no model is loaded
+     * @throws RuntimeException if any generation fails
+     */
+    fun generateBatch(
+        prompts: List<String>,
+        maxTokens: Int = 256,
+        temperature: Float = 0.8f,
+        topP: Float = 0.9f,
+        topK: Int = 40,
+        constraints: GenerationConstraints? = null
+    ): List<String> {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        
+        if (prompts.any { it.isBlank() }) {
+            throw IllegalArgumentException("Prompts cannot be empty or blank")
+        }
+        
+        val results = arrayOfNulls<String>(prompts.size)
+        val error = nativeGenerateBatch(nativeHandle, prompts.toTypedArray(), maxTokens, temperature, topP, topK, constraints, results)
+        if (error != null) {
+            throw RuntimeException("Error during text generation: $error")
+        }
+        return results.map { it ?: "" }
+    }
+    
+    /**
+     * Generate text without blocking the calling thread.
+     * 
+     * The request is queued on a native worker pool and the returned future is
+     * completed from a native thread. Requests on the same wrapper run one at a time
+     * in submission order, or concurrently in one batch when [startScheduler] is active.
+     * Cancelling the future stops generation at the next token.
+     * 
+     * @param prompt The input prompt for text generation
+     * @param maxTokens Maximum number of tokens to generate (default: 256)
+     * @param temperature Temperature for sampling, 0 for greedy decoding (default: 0.8)
+     * @param topP Top-p sampling parameter (default: 0.9)
+     * @param topK Top-k sampling parameter, 0 to disable (default: 40)
+     * @param constraints Stop strings, grammar and scheduling class (default: none)
+     * @return Future completed with the generated text, or exceptionally with a RuntimeException
+     * @throws IllegalStateException if no model is loaded
+     */
+    fun generateAsync(
+        prompt: String,
+        maxTokens: Int = 256,
+        temperature: Float = 0.8f,
+        topP: Float = 0.9f,
+        topK: Int = 40,
+        constraints: GenerationConstraints? = null
+    ): CompletableFuture<String> {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        
+        if (prompt.isBlank()) {
+            throw IllegalArgumentException("Prompt cannot be empty or blank")
+        }
+        
+        val future = CompletableFuture<String>()
+        if (!nativeGenerateAsync(nativeHandle, prompt, maxTokens, temperature, topP, topK, constraints, future)) {
+            future.completeExceptionally(RuntimeException("Failed to queue text generation"))
+        }
+        return future
+    }
+    
+    /**
+     * Suspending variant of [generateAsync]: waits without holding a thread, and
+     * cancelling the coroutine stops the generation.
+     * 
+     * @param prompt The input prompt for text generation
+     * @param maxTokens Maximum number of tokens to generate (default: 256)
+     * @param temperature Temperature for sampling, 0 for greedy decoding (default: 0.8)
+     * @param topP Top-p sampling parameter (default: 0.9)
+     * @param topK Top-k sampling parameter, 0 to disable (default: 40)
+     * @param constraints Stop strings, grammar and scheduling class (default: none)
+     * @return Generated text
+     * @throws RuntimeException if text generation fails
+     */
+    suspend fun generateAwait(
+        prompt: String,
+        maxTokens: Int = 256,
+        temperature: Float = 0.8f,
+        topP: Float = 0.9f,
+        topK: Int = 40,
+        constraints: GenerationConstraints? = null
+    ): String = generateAsync(prompt, maxTokens, temperature, topP, topK, constraints).await()
+    
+    /**
+     * Generate text and deliver it incrementally to a listener as tokens are decoded.
+     * 
+     * @param prompt The input prompt for text generation
+     * @param maxTokens Maximum number of tokens to generate (default: 256)
+     * @param temperature Temperature for sampling (default: 0.8)
+     * @param topP Top-p sampling parameter (default: 0.9)
+     * @param topK Top-k sampling parameter (default: 40)
+     * @param constraints Stop strings, grammar and scheduling class (default: none)
+     * @param listener Receives each chunk; return false to stop generation early
+     * @throws IllegalStateException if no model is loaded
+     * @throws RuntimeException if text generation fails
+     */
+    fun generateStream(
+        prompt: String,
+        maxTokens: Int = 256,
+        temperature: Float = 0.8f,
+        topP: Float = 0.9f,
+        topK: Int = 40,
+        constraints: GenerationConstraints? = null,
+        listener: TokenListener
+    ) {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        
+        if (prompt.isBlank()) {
+            throw IllegalArgumentException("Prompt cannot be empty or blank")
+        }
+        
+        val error = nativeGenerateStream(nativeHandle, prompt, maxTokens, temperature, topP, topK, constraints, listener)
+        if (error != null) {
+            throw RuntimeException("Error during text generation: $error")
+        }
+    }
+    
+    /**
+     * Generate text as a cold [Flow] of chunks. Generation runs on [Dispatchers.IO]
+     * and stops as soon as the collector is cancelled.
+     * 
+     * @param prompt The input prompt for text generation
+     * @param maxTokens Maximum number of tokens to generate (default: 256)
+     * @param temperature Temperature for sampling (default: 0.8)
+     * @param topP Top-p sampling parameter (default: 0.9)
+     * @param topK Top-k sampling parameter (default: 40)
+     * @param constraints Stop strings, grammar and scheduling class (default: none)
+     * @return Flow emitting each generated chunk
+     */
+    fun generateFlow(
+        prompt: String,
+        maxTokens: Int = 256,
+        temperature: Float = 0.8f,
+        topP: Float = 0.9f,
+        topK: Int = 40,
+        constraints: GenerationConstraints? = null
+    ): Flow<String> = channelFlow {
+        generateStream(prompt, maxTokens, temperature, topP, topK, constraints) { piece ->
+            isActive && trySendBlocking(piece).isSuccess
+        }
+    }.flowOn(Dispatchers.IO)
+    
+    /**
+     * Generate text without any String conversion: the UTF-8 prompt is read from the
+     * remaining bytes of [prompt] and generated UTF-8 is written into [output]
+     * starting at its position. Both buffers must be direct.
+     * 
+     * Generation stops early if the next chunk would not fit in [output]; the result is
+     * then flagged [DirectGenerationResult.truncated], so a full buffer is never mistaken
+     * for a completed generation. On return, [output]'s position is advanced past the
+     * written bytes.
+     * 
+     * @param prompt Direct buffer holding the UTF-8 prompt between position and limit
+     * @param output Direct buffer receiving the generated UTF-8 text
+     * @param maxTokens Maximum number of tokens to generate (default: 256)
+     * @param temperature Temperature for sampling, 0 for greedy decoding (default: 0.8)
+     * @param topP Top-p sampling parameter (default: 0.9)
+     * @param topK Top-k sampling parameter, 0 to disable (default: 40)
+     * @param constraints Stop strings, grammar and scheduling class (default: none)
+     * @return Number of bytes written to [output] and whether the output was truncated
+     * @throws IllegalStateException if no model is loaded
+     * @throws IllegalArgumentException if a buffer is not direct or the prompt is empty
+     * @throws RuntimeException if text generation fails
+     */
+    fun generateDirect(
+        prompt: ByteBuffer,
+        output: ByteBuffer,
+        maxTokens: Int = 256,
+        temperature: Float = 0.8f,
+        topP: Float = 0.9f,
+        topK: Int = 40,
+        constraints: GenerationConstraints? = null
+    ): DirectGenerationResult {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        
+        if (!prompt.isDirect || !output.isDirect) {
+            throw IllegalArgumentException("Prompt and output must be direct ByteBuffers")
+        }
+        
+        if (!prompt.hasRemaining()) {
+            throw IllegalArgumentException("Prompt cannot be empty")
+        }
+        
+        val status = IntArray(1)
+        val written = nativeGenerateDirect(
+            nativeHandle,
+            prompt, prompt.position(), prompt.remaining(),
+            output, output.position(), output.remaining(),
+            maxTokens, temperature, topP, topK, constraints, status
+        )
+        if (written < 0) {
+            throw RuntimeException("Error during text generation: native error code ${-written}")
+        }
+        
+        output.position(output.position() + written)
+        return DirectGenerationResult(written, status[0] == DirectGenerationResult.STATUS_TRUNCATED)
+    }
+    
+    /**
+     * Size of the vectors produced by [embed].
+     * 
+     * @return Embedding dimension, or 0 if no model is loaded
+     */
+    fun getEmbeddingSize(): Int {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            return 0
+        }
+        return nativeGetEmbeddingSize(nativeHandle)
+    }
+    
+    /**
+     * Embed many texts in one native call, packing them as parallel sequences of a single
+     * batch. Vectors are written back to back, [getEmbeddingSize] floats each, into [output]
+     * starting at its position, which is advanced past them.
+     * 
+     * This drops the generation prefix cache and cannot run while the scheduler is active.
+     * More texts than [ContextOptions.maxSequences] (up to 64) recreate the context on the
+     * first call.
+     * 
+     * @param texts Texts to embed, each at most the micro-batch size
+     *              ([ContextOptions.ubatchSize]) in tokens
+     * @param output Direct buffer in native byte order with room for all vectors
+     * @param pooling How token embeddings are combined (default: model default, else mean)
+     * @param normalize Whether to L2-normalize each vector (default: true)
+     * @param truncate Embed only the first micro-batch of tokens of a longer text instead of
+     *                 failing the call (default: false)
+     * @return Number of vectors written
+     * @throws IllegalStateException if no model is loaded
+     * @throws IllegalArgumentException if the buffer is unsuitable, a text is empty, or a text
+     *                                  is too long and [truncate] is false
+     * @throws RuntimeException if embedding fails
+     */
+    fun embed(
+        texts: List<String>,
+        output: FloatBuffer,
+        pooling: EmbeddingPooling = EmbeddingPooling.DEFAULT,
+        normalize: Boolean = true,
+        truncate: Boolean = false
+    ): Int {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        
+        if (!output.isDirect || output.order() != ByteOrder.nativeOrder()) {
+            throw IllegalArgumentException("Output must be a direct FloatBuffer in native byte order")
+        }
+        
+        if (texts.isEmpty()) {
+            return 0
+        }
+        
+        val needed = texts.size.toLong() * getEmbeddingSize()
+        if (needed > output.remaining()) {
+            throw IllegalArgumentException("Output has room for ${output.remaining()} floats, $needed needed")
+        }
+        
+        val written = nativeEmbed(nativeHandle, texts.toTypedArray(), pooling.nativeValue, normalize, truncate, output, output.position())
+        if (written == -ERR_INVALID_PARAMS) {
+            throw IllegalArgumentException("Embedding input rejected: a text is empty or longer than the micro-batch size " +
+                    "(pass truncate = true to cut it), or the scheduler is running")
+        }
+        if (written < 0) {
+            throw RuntimeException("Error during embedding: native error code ${-written}")
+        }
+        
+        output.position(output.position() + needed.toInt())
+        return written
+    }
+    
+    /**
+     * Embed many texts and return one array per text. Convenience over the
+     * [FloatBuffer] overload for callers that do not manage their own buffers.
+     * 
+     * @param texts Texts to embed
+     * @param pooling How token embeddings are combined (default: model default, else mean)
+     * @param normalize Whether to L2-normalize each vector (default: true)
+     * @param truncate Cut texts longer than the micro-batch size instead of failing (default: false)
+     * @return One vector per text, in input order
+     */
+    fun embed(
+        texts: List<String>,
+        pooling: EmbeddingPooling = EmbeddingPooling.DEFAULT,
+        normalize: Boolean = true,
+        truncate: Boolean = false
+    ): List<FloatArray> {
+        val size = getEmbeddingSize()
+        val buffer = ByteBuffer.allocateDirect(texts.size * size * 4).order(ByteOrder.nativeOrder()).asFloatBuffer()
+        embed(texts, buffer, pooling, normalize, truncate)
+        buffer.flip()
+        return List(texts.size) { FloatArray(size).also { buffer.get(it) } }
+    }
+    
+    /**
+     * Start the native continuous batching scheduler for this model.
+     * 
+     * Once started, [generateText] and [generateStream] may be called from many
+     * threads at once: every in-flight request is decoded in a shared batch on a
+     * native scheduler thread instead of running one after another.
+     * 
+     * All sequences share the context's KV cache: a request is admitted once its prompt
+     * fits in the cells left, and when the cache fills up the longest running request is
+     * requeued to resume later. Only a request that cannot fit on its own fails, with
+     * "Error: KV cache full".
+     * 
+     * @param maxSequences Maximum number of requests decoded in parallel (default: 4).
+     *                     Capped at [ContextOptions.batchSize], since every running
+     *                     request adds one token to each shared decode batch. Above
+     *                     [ContextOptions.maxSequences] the context is recreated, which
+     *                     drops the prefix cache
+     * @throws IllegalStateException if no model is loaded
+     * @throws RuntimeException if the scheduler cannot be started
+     */
+    fun startScheduler(maxSequences: Int = 4) {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
         }
         
-        init {
-            loadLibrary()
+        if (!nativeStartScheduler(nativeHandle, maxSequences)) {
+            throw RuntimeException("Failed to start scheduler with $maxSequences sequences")
         }
     }
     
-    // Native handle to the llama context (pointer stored as long)
-    private var nativeHandle: Long = 0
-    private var isModelLoaded = false
+    /**
+     * Stop the scheduler. Requests still in flight fail with an error.
+     */
+    fun stopScheduler() {
+        if (nativeHandle != 0L) {
+            nativeStopScheduler(nativeHandle)
+        }
+    }
     
     /**
-     * Load a GGUF model from the specified file path.
+     * Warm up the context so the first real request runs at steady-state latency.
      * 
-     * @param modelPath Path to the GGUF model file
-     * @param contextSize Context size for the model (default: 2048)
-     * @param threads Number of threads to use (default: -1 for auto-detect)
-     * @throws IllegalArgumentException if the model path is invalid
-     * @throws RuntimeException if model loading fails
+     * Decodes a throwaway batch, which allocates the compute buffers and touches the
+     * weights, then clears the KV cache. With [prefault], mmap'd model files are read
+     * through the page cache first so the decode does not stall on disk reads.
+     * Call before [startScheduler].
+     * 
+     * @param prefault Read the whole model file before decoding (default: false)
+     * @throws IllegalStateException if no model is loaded
+     * @throws RuntimeException if the warmup decode fails or the scheduler is running
      */
-    fun loadModel(modelPath: String, contextSize: Int = 2048, threads: Int = -1) {
-        if (isModelLoaded) {
-            cleanup()
+    fun warmup(prefault: Boolean = false) {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
         }
         
-        val modelFile = File(modelPath)
-        if (!modelFile.exists()) {
-            throw IllegalArgumentException("Model file does not exist: $modelPath")
+        if (!nativeWarmup(nativeHandle, prefault)) {
+            throw RuntimeException("Warmup failed")
         }
-        if (!modelFile.canRead()) {
-            throw IllegalArgumentException("Cannot read model file: $modelPath")
+    }
+    
+    /**
+     * Reseed sampling so that subsequent generations are reproducible.
+     * Each request draws its own sampler seed from a generator seeded here.
+     * 
+     * @param seed Seed value
+     * @throws IllegalStateException if no model is loaded
+     */
+    fun setSeed(seed: Long) {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
         }
         
-        try {
-            nativeHandle = nativeLoadModel(modelPath, contextSize, threads)
-            if (nativeHandle == 0L) {
-                throw RuntimeException("Failed to load model: $modelPath")
-            }
-            isModelLoaded = true
-        } catch (e: Exception) {
-            throw RuntimeException("Error loading model: ${e.message}", e)
+        nativeSetSeed(nativeHandle, seed)
+    }
+    
+    /**
+     * Configure the snapshot cache used by [saveState] and [restoreState].
+     * 
+     * @param maxBytes Memory budget for snapshots kept in memory (default: 256 MiB)
+     * @param spillDirectory Directory that receives snapshots evicted from memory,
+     *                       or null to discard them
+     * @throws IllegalStateException if no model is loaded
+     */
+    fun configureStateCache(maxBytes: Long = 256L * 1024 * 1024, spillDirectory: String? = null) {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
+        }
+        
+        spillDirectory?.let { File(it).mkdirs() }
+        if (!nativeConfigureStateCache(nativeHandle, maxBytes, spillDirectory)) {
+            throw IllegalArgumentException("Invalid state cache configuration: maxBytes=$maxBytes")
         }
     }
     
     /**
-     * Generate text based on the given prompt.
+     * Snapshot the current conversation's KV cache under a session name.
      * 
-     * @param prompt The input prompt for text generation
-     * @param maxTokens Maximum number of tokens to generate (default: 256)
-     * @param temperature Temperature for sampling (default: 0.8)
-     * @param topP Top-p sampling parameter (default: 0.9)
-     * @param topK Top-k sampling parameter (default: 40)
-     * @return Generated text as a string
+     * Restoring it later costs a memory copy or file read instead of prefilling
+     * the whole history again.
+     * 
+     * @param sessionId Name of the snapshot; an existing snapshot is replaced
+     * @return true if the snapshot was saved, false if there is nothing to save
+     *         or the scheduler is running
      * @throws IllegalStateException if no model is loaded
-     * @throws RuntimeException if text generation fails
      */
-    fun generateText(
-        prompt: String, 
-        maxTokens: Int = 256, 
-        temperature: Float = 0.8f,
-        topP: Float = 0.9f,
-        topK: Int = 40
-    ): String {
+    fun saveState(sessionId: String): Boolean {
         if (!isModelLoaded || nativeHandle == 0L) {
             throw IllegalStateException("No model loaded. Call loadModel() first.")
         }
         
-        if (prompt.isBlank()) {
-            throw IllegalArgumentException("Prompt cannot be empty or blank")
+        return nativeSaveState(nativeHandle, sessionId)
+    }
+    
+    /**
+     * Restore a snapshot saved with [saveState]. A following [generateText] call whose
+     * prompt extends the saved history only prefills the new part.
+     * 
+     * @param sessionId Name of the snapshot
+     * @return true if the snapshot was restored, false if it is unknown
+     * @throws IllegalStateException if no model is loaded
+     */
+    fun restoreState(sessionId: String): Boolean {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            throw IllegalStateException("No model loaded. Call loadModel() first.")
         }
         
-        try {
-            val result = nativeGenerateText(nativeHandle, prompt, maxTokens, temperature, topP, topK)
-            if (result == null) {
-                throw RuntimeException("Text generation returned null result")
-            }
-            return result
-        } catch (e: Exception) {
-            throw RuntimeException("Error during text generation: ${e.message}", e)
+        return nativeRestoreState(nativeHandle, sessionId)
+    }
+    
+    /**
+     * Delete a snapshot from memory and from the spill directory.
+     * 
+     * @param sessionId Name of the snapshot
+     */
+    fun deleteState(sessionId: String) {
+        if (nativeHandle != 0L) {
+            nativeDeleteState(nativeHandle, sessionId)
         }
     }
     
     /**
-     * Get information about the loaded model.
+     * Get information about the loaded model and this context: sizes, head counts,
+     * quantization and the GGUF metadata. Use [ModelInfo.summary] for display.
+     * 
+     * Suitable for health checks: the information is captured when the context is
+     * created, so this returns immediately even while a generation is running.
      * 
-     * @return Model information as a string, or null if no model is loaded
+     * @return Model information, or null if no model is loaded
      */
-    fun getModelInfo(): String? {
+    fun getModelInfo(): ModelInfo? {
         if (!isModelLoaded || nativeHandle == 0L) {
             return null
         }
         
-        return try {
-            nativeGetModelInfo(nativeHandle)
-        } catch (e: Exception) {
-            null
+        val values = LongArray(ModelInfo.FIELD_COUNT)
+        val strings = nativeGetModelInfo(nativeHandle, values) ?: return null
+        return ModelInfo.fromNative(values, strings)
+    }
+    
+    /**
+     * Get the memory this context holds: shared weights, its KV cache and how much of
+     * it is in use, compute buffers and cached session states.
+     * 
+     * Cheap enough to poll while requests run: it reads counters updated after every
+     * decode step and never waits for a generation to finish.
+     * 
+     * @return Resource usage, or null if no model is loaded
+     */
+    fun getResourceUsage(): ResourceUsage? {
+        if (!isModelLoaded || nativeHandle == 0L) {
+            return null
         }
+        
+        val values = LongArray(ResourceUsage.FIELD_COUNT)
+        return if (nativeGetResourceUsage(nativeHandle, values)) ResourceUsage.fromArray(values) else null
     }
     
     /**
@@ -132,19 +1026,36 @@ class LlamaWrapper {
     }
     
     /**
-     * Clean up resources and free the loaded model.
+     * Clean up resources and free this wrapper's context.
+     * The model weights are freed once no other context uses them.
+     * Generations still running on other threads finish before the context is freed.
+     * A context acquired from a [ContextPool] is returned to it instead, unless the pool
+     * has been closed.
      * This should be called when done using the model to prevent memory leaks.
      */
     fun cleanup() {
+        releaseContext(pool?.keepPrefixCache ?: false)
+    }
+    
+    /**
+     * Return a pooled context to its pool, or free the context if it has none.
+     * 
+     * @param keepPrefixCache Keep a pooled context's cached prompt for its next holder
+     */
+    internal fun releaseContext(keepPrefixCache: Boolean) {
         if (nativeHandle != 0L) {
             try {
-                nativeCleanup(nativeHandle)
+                val owner = pool
+                if (owner == null || !owner.returnContext(nativeHandle, keepPrefixCache)) {
+                    nativeCleanup(nativeHandle)
+                }
             } catch (e: Exception) {
                 // Log error but don't throw during cleanup
                 System.err.println("Warning: Error during cleanup: ${e.message}")
             } finally {
                 nativeHandle = 0L
                 isModelLoaded = false
+                pool = null
             }
         }
     }
@@ -159,14 +1070,34 @@ class LlamaWrapper {
     // Native method declarations - these correspond to the JNI implementation
     
     /**
-     * Native method to load a GGUF model.
+     * Native method to create a context on loaded model weights.
      * 
-     * @param modelPath Path to the model file
+     * @param modelHandle Native handle to the loaded weights
      * @param contextSize Context size for the model
      * @param threads Number of threads to use
-     * @return Native handle (pointer) to the loaded model context
+     * @param options Context tuning options
+     * @return Native handle to the new context
+     */
+    private external fun nativeCreateContext(modelHandle: Long, contextSize: Int, threads: Int, options: ContextOptions?): Long
+    
+    /**
+     * Native method to load a LoRA adapter onto the context's weights.
+     * 
+     * @param handle Native handle to the model context
+     * @param path Path to the adapter file
+     * @return Native adapter handle, or 0 on failure
+     */
+    private external fun nativeLoadAdapter(handle: Long, path: String): Long
+    
+    /**
+     * Native method to select the applied LoRA adapters.
+     * 
+     * @param handle Native handle to the model context
+     * @param adapters Native adapter handles
+     * @param scales Scale of each adapter
+     * @return true if applied
      */
-    private external fun nativeLoadModel(modelPath: String, contextSize: Int, threads: Int): Long
+    private external fun nativeSetAdapters(handle: Long, adapters: LongArray, scales: FloatArray): Boolean
     
     /**
      * Native method to generate text.
@@ -177,6 +1108,7 @@ class LlamaWrapper {
      * @param temperature Sampling temperature
      * @param topP Top-p sampling parameter
      * @param topK Top-k sampling parameter
+     * @param constraints Stop strings, grammar and scheduling class, or null
      * @return Generated text
      */
     private external fun nativeGenerateText(
@@ -185,16 +1117,298 @@ class LlamaWrapper {
         maxTokens: Int, 
         temperature: Float,
         topP: Float,
-        topK: Int
+        topK: Int,
+        constraints: GenerationConstraints?
+    ): String?
+    
+    /**
+     * Native method to generate text and fill performance metrics.
+     * 
+     * @param handle Native handle to the model context
+     * @param prompt Input prompt
+     * @param maxTokens Maximum tokens to generate
+     * @param temperature Sampling temperature
+     * @param topP Top-p sampling parameter
+     * @param topK Top-k sampling parameter
+     * @param constraints Stop strings, grammar and scheduling class, or null
+     * @param stats Receives the metrics in [GenerationStats.fromArray] order on success
+     * @return Generated text
+     * @throws RuntimeException with the native error message if generation fails
+     */
+    private external fun nativeGenerateWithStats(
+        handle: Long,
+        prompt: String,
+        maxTokens: Int,
+        temperature: Float,
+        topP: Float,
+        topK: Int,
+        constraints: GenerationConstraints?,
+        stats: DoubleArray
+    ): String?
+    
+    /**
+     * Native method to tokenize text.
+     * 
+     * @param handle Native handle to the model context
+     * @param text Text to tokenize
+     * @param addBos Whether to prepend BOS
+     * @return Token IDs, or null on failure
+     */
+    private external fun nativeTokenize(handle: Long, text: String, addBos: Boolean): IntArray?
+    
+    /**
+     * Native method to convert token IDs to text.
+     * 
+     * @param handle Native handle to the model context
+     * @param tokens Token IDs
+     * @return Decoded text, or null if an ID is invalid
+     */
+    private external fun nativeDetokenize(handle: Long, tokens: IntArray): String?
+    
+    /**
+     * Native method to generate text from prompt token IDs.
+     * 
+     * @param handle Native handle to the model context
+     * @param tokens Prompt token IDs
+     * @param maxTokens Maximum tokens to generate
+     * @param temperature Sampling temperature
+     * @param topP Top-p sampling parameter
+     * @param topK Top-k sampling parameter
+     * @param constraints Stop strings, grammar and scheduling class, or null
+     * @return Generated text, or an error message
+     */
+    private external fun nativeGenerateTokens(
+        handle: Long,
+        tokens: IntArray,
+        maxTokens: Int,
+        temperature: Float,
+        topP: Float,
+        topK: Int,
+        constraints: GenerationConstraints?
+    ): String?
+    
+    /**
+     * Native method to generate several prompts as parallel sequences.
+     * 
+     * @param handle Native handle to the model context
+     * @param prompts Input prompts
+     * @param maxTokens Maximum tokens to generate per prompt
+     * @param temperature Sampling temperature
+     * @param topP Top-p sampling parameter
+     * @param topK Top-k sampling parameter
+     * @param constraints Stop strings, grammar and scheduling class, or null
+     * @param results Receives one generated text per prompt on success
+     * @return null on success, or an error message
+     */
+    private external fun nativeGenerateBatch(
+        handle: Long,
+        prompts: Array<String>,
+        maxTokens: Int,
+        temperature: Float,
+        topP: Float,
+        topK: Int,
+        constraints: GenerationConstraints?,
+        results: Array<String?>
+    ): String?
+    
+    /**
+     * Native method to queue a generation on the native worker pool.
+     * 
+     * @param handle Native handle to the model context
+     * @param prompt Input prompt
+     * @param maxTokens Maximum tokens to generate
+     * @param temperature Sampling temperature
+     * @param topP Top-p sampling parameter
+     * @param topK Top-k sampling parameter
+     * @param constraints Stop strings, grammar and scheduling class, or null
+     * @param future Completed by a native worker thread
+     * @return true if the request was queued
+     */
+    private external fun nativeGenerateAsync(
+        handle: Long,
+        prompt: String,
+        maxTokens: Int,
+        temperature: Float,
+        topP: Float,
+        topK: Int,
+        constraints: GenerationConstraints?,
+        future: CompletableFuture<String>
+    ): Boolean
+    
+    /**
+     * Native method to stream generated text to a listener.
+     * 
+     * @param handle Native handle to the model context
+     * @param prompt Input prompt
+     * @param maxTokens Maximum tokens to generate
+     * @param temperature Sampling temperature
+     * @param topP Top-p sampling parameter
+     * @param topK Top-k sampling parameter
+     * @param constraints Stop strings, grammar and scheduling class, or null
+     * @param listener Listener receiving each decoded chunk
+     * @return null on success, or an error message
+     */
+    private external fun nativeGenerateStream(
+        handle: Long,
+        prompt: String,
+        maxTokens: Int,
+        temperature: Float,
+        topP: Float,
+        topK: Int,
+        constraints: GenerationConstraints?,
+        listener: TokenListener
     ): String?
     
     /**
      * Native method to get model information.
      * 
      * @param handle Native handle to the model context
-     * @return Model information string
+     * @param values Array receiving the numeric fields in LLAMA_JNI_INFO_* order
+     * @return String fields followed by metadata key/value pairs
+     */
+    private external fun nativeGetModelInfo(handle: Long, values: LongArray): Array<String>?
+    
+    /**
+     * Native method to report a context's memory use.
+     * 
+     * @param handle Native handle to the model context
+     * @param usage Array receiving the sizes in LLAMA_JNI_RES_* order
+     * @return true if filled
+     */
+    private external fun nativeGetResourceUsage(handle: Long, usage: LongArray): Boolean
+    
+    /**
+     * Native method to generate text between direct buffers.
+     * 
+     * @param handle Native handle to the model context
+     * @param prompt Direct buffer holding the UTF-8 prompt
+     * @param promptOffset Byte offset of the prompt
+     * @param promptLength Prompt length in bytes
+     * @param output Direct buffer receiving UTF-8 output
+     * @param outputOffset Byte offset to start writing at
+     * @param outputCapacity Maximum bytes to write
+     * @param maxTokens Maximum tokens to generate
+     * @param temperature Sampling temperature
+     * @param topP Top-p sampling parameter
+     * @param topK Top-k sampling parameter
+     * @param constraints Stop strings, grammar and scheduling class, or null
+     * @param status Receives [DirectGenerationResult.STATUS_TRUNCATED] if the output filled up, 0 otherwise
+     * @return Bytes written, or a negated native error code
+     */
+    private external fun nativeGenerateDirect(
+        handle: Long,
+        prompt: ByteBuffer,
+        promptOffset: Int,
+        promptLength: Int,
+        output: ByteBuffer,
+        outputOffset: Int,
+        outputCapacity: Int,
+        maxTokens: Int,
+        temperature: Float,
+        topP: Float,
+        topK: Int,
+        constraints: GenerationConstraints?,
+        status: IntArray
+    ): Int
+    
+    /**
+     * Native method to embed texts into a direct buffer.
+     * 
+     * @param handle Native handle to the model context
+     * @param texts Texts to embed
+     * @param pooling llama_pooling_type value
+     * @param normalize Whether to L2-normalize each vector
+     * @param truncate Cut texts longer than the micro-batch size instead of failing
+     * @param output Direct buffer receiving the vectors
+     * @param outputOffset Float offset to start writing at
+     * @return Number of vectors written, or a negated native error code
+     */
+    private external fun nativeEmbed(
+        handle: Long,
+        texts: Array<String>,
+        pooling: Int,
+        normalize: Boolean,
+        truncate: Boolean,
+        output: FloatBuffer,
+        outputOffset: Int
+    ): Int
+    
+    /**
+     * Native method to get the embedding dimension.
+     * 
+     * @param handle Native handle to the model context
+     * @return Embedding dimension
+     */
+    private external fun nativeGetEmbeddingSize(handle: Long): Int
+    
+    /**
+     * Native method to start the batching scheduler.
+     * 
+     * @param handle Native handle to the model context
+     * @param maxSequences Maximum number of parallel sequences
+     * @return true if the scheduler is running
+     */
+    private external fun nativeStartScheduler(handle: Long, maxSequences: Int): Boolean
+    
+    /**
+     * Native method to stop the batching scheduler.
+     * 
+     * @param handle Native handle to the model context
+     */
+    private external fun nativeStopScheduler(handle: Long)
+    
+    /**
+     * Native method to warm up the context.
+     * 
+     * @param handle Native handle to the model context
+     * @param prefault Read mmap'd model files through the page cache first
+     * @return true if the warmup decode succeeded
+     */
+    private external fun nativeWarmup(handle: Long, prefault: Boolean): Boolean
+    
+    /**
+     * Native method to reseed per-request sampling.
+     * 
+     * @param handle Native handle to the model context
+     * @param seed Seed value
+     */
+    private external fun nativeSetSeed(handle: Long, seed: Long)
+    
+    /**
+     * Native method to configure the snapshot cache.
+     * 
+     * @param handle Native handle to the model context
+     * @param maxBytes Memory budget for in-memory snapshots
+     * @param spillDir Directory for evicted snapshots, or null
+     * @return true on success
+     */
+    private external fun nativeConfigureStateCache(handle: Long, maxBytes: Long, spillDir: String?): Boolean
+    
+    /**
+     * Native method to snapshot the KV state.
+     * 
+     * @param handle Native handle to the model context
+     * @param sessionId Name of the snapshot
+     * @return true on success
+     */
+    private external fun nativeSaveState(handle: Long, sessionId: String): Boolean
+    
+    /**
+     * Native method to restore a KV state snapshot.
+     * 
+     * @param handle Native handle to the model context
+     * @param sessionId Name of the snapshot
+     * @return true if the snapshot was restored
+     */
+    private external fun nativeRestoreState(handle: Long, sessionId: String): Boolean
+    
+    /**
+     * Native method to delete a KV state snapshot.
+     * 
+     * @param handle Native handle to the model context
+     * @param sessionId Name of the snapshot
      */
-    private external fun nativeGetModelInfo(handle: Long): String?
+    private external fun nativeDeleteState(handle: Long, sessionId: String)
     
     /**
      * Native method to clean up and free model resources.
@@ -0,0 +1,12 @@
+package com.traycer.llama
+
+/**
+ * Receives model loading progress. Called natively on the thread loading the model.
+ */
+fun interface LoadProgressListener {
+    /**
+     * @param progress Fraction of the model loaded, between 0 and 1
+     * @return true to continue loading, false to abort it
+     */
+    fun onProgress(progress: Float): Boolean
+}
@@ -0,0 +1,16 @@
+package com.traycer.llama
+
+/**
+ * A LoRA adapter loaded onto shared model weights with [LlamaModel.loadAdapter] or
+ * [LlamaWrapper.loadAdapter].
+ * 
+ * Adapters are small next to the base model and stay loaded as long as its weights,
+ * so one base model can serve several fine-tunes. A context picks the adapters it
+ * runs with through [LlamaWrapper.setAdapters].
+ * 
+ * @property path Path to the GGUF adapter file
+ */
+class LoraAdapter internal constructor(
+    val path: String,
+    internal val nativeHandle: Long
+)
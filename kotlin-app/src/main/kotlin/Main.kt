@@ -103,7 +103,7 @@ object Main {
         
         val modelInfo = wrapper.getModelInfo()
         if (modelInfo != null) {
-            println(modelInfo)
+            println(modelInfo.summary())
         } else {
             println("ℹ️  Model information not available")
         }
@@ -253,15 +253,25 @@ object Main {
                 print("🤖 Assistant: ")
                 val startTime = System.currentTimeMillis()
                 
-                val response = wrapper.generateText(
+                var firstTokenTime = 0L
+                
+                // Stream the response so the first tokens show up immediately
+                wrapper.generateStream(
                     prompt = input,
                     maxTokens = maxTokens,
                     temperature = temperature
-                )
+                ) { piece ->
+                    if (firstTokenTime == 0L) {
+                        firstTokenTime = System.currentTimeMillis() - startTime
+                    }
+                    print(piece)
+                    System.out.flush()
+                    true
+                }
                 
                 val generateTime = System.currentTimeMillis() - startTime
-                println(response.trim())
-                println("⏱️  Generated in ${generateTime}ms")
+                println()
+                println("⏱️  Generated in ${generateTime}ms (first token after ${firstTokenTime}ms)")
                 println()
                 
             } catch (e: Exception) {
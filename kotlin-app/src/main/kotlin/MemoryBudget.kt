@@ -0,0 +1,16 @@
+package com.traycer.llama
+
+/**
+ * Process-wide memory budget set with [LlamaWrapper.setMemoryBudget]. All sizes are in bytes.
+ * 
+ * @property limitBytes Configured budget, 0 when unlimited
+ * @property reservedBytes Bytes reserved by loaded weights, adapters and contexts
+ */
+data class MemoryBudget(
+    val limitBytes: Long,
+    val reservedBytes: Long
+) {
+    /** Bytes still available for new models and contexts, or [Long.MAX_VALUE] when unlimited. */
+    val availableBytes: Long
+        get() = if (limitBytes > 0) maxOf(0L, limitBytes - reservedBytes) else Long.MAX_VALUE
+}
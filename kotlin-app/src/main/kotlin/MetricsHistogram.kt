@@ -0,0 +1,79 @@
+package com.traycer.llama
+
+/**
+ * Snapshot of a native histogram with fixed buckets.
+ * 
+ * @property bounds Inclusive upper bound of each bucket, ascending
+ * @property counts Observations per bucket; one longer than [bounds], the last for +Inf
+ * @property sum Sum of all observed values
+ * @property count Number of observations
+ */
+class MetricsHistogram(
+    val bounds: DoubleArray,
+    val counts: LongArray,
+    val sum: Double,
+    val count: Long
+) {
+    /** Mean observed value, or 0 without observations. */
+    val mean: Double
+        get() = if (count > 0) sum / count else 0.0
+    
+    /**
+     * Estimate a quantile from the buckets, interpolating linearly within the bucket it
+     * falls in. Values in the +Inf bucket are reported as the largest bound.
+     * 
+     * @param q Quantile between 0 and 1, e.g. 0.99
+     * @return Estimated value, or 0 without observations
+     */
+    fun quantile(q: Double): Double {
+        if (count == 0L) {
+            return 0.0
+        }
+        val rank = q.coerceIn(0.0, 1.0) * count
+        var seen = 0L
+        for (i in counts.indices) {
+            if (seen + counts[i] >= rank && counts[i] > 0) {
+                if (i == bounds.size) {
+                    return bounds.lastOrNull() ?: 0.0
+                }
+                val lower = if (i > 0) bounds[i - 1] else 0.0
+                return lower + (bounds[i] - lower) * ((rank - seen) / counts[i])
+            }
+            seen += counts[i]
+        }
+        return bounds.lastOrNull() ?: 0.0
+    }
+    
+    /**
+     * Append this histogram in the Prometheus text exposition format.
+     * 
+     * @param out Destination
+     * @param name Metric name without suffixes
+     * @param help HELP text
+     */
+    internal fun writePrometheus(out: StringBuilder, name: String, help: String) {
+        out.append("# HELP ").append(name).append(' ').append(help).append('\n')
+        out.append("# TYPE ").append(name).append(" histogram\n")
+        var cumulative = 0L
+        for (i in counts.indices) {
+            cumulative += counts[i]
+            val le = if (i < bounds.size) bounds[i].toString() else "+Inf"
+            out.append(name).append("_bucket{le=\"").append(le).append("\"} ").append(cumulative).append('\n')
+        }
+        out.append(name).append("_sum ").append(sum).append('\n')
+        out.append(name).append("_count ").append(count).append('\n')
+    }
+    
+    companion object {
+        // Parse one self-describing histogram at offset; returns it with the offset after it
+        internal fun fromArray(values: DoubleArray, offset: Int): Pair<MetricsHistogram, Int> {
+            val n = values[offset].toInt()
+            var i = offset + 1
+            val bounds = DoubleArray(n) { values[i + it] }
+            i += n
+            val counts = LongArray(n + 1) { values[i + it].toLong() }
+            i += n + 1
+            return MetricsHistogram(bounds, counts, values[i], values[i + 1].toLong()) to i + 2
+        }
+    }
+}
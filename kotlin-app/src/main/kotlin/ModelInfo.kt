@@ -0,0 +1,93 @@
+package com.traycer.llama
+
+/**
+ * Structured description of a loaded model and the context serving it, read natively
+ * in one call.
+ * 
+ * @property description llama.cpp's one-line description, e.g. "qwen3 0.6B Q8_0"
+ * @property quantization Quantization of the weights from "general.file_type", e.g. "Q4_K_M"
+ * @property vocabSize Number of tokens in the vocabulary
+ * @property trainContextSize Context length the model was trained with
+ * @property contextSize Context size of this context in tokens
+ * @property embeddingSize Embedding dimension
+ * @property layerCount Number of transformer layers
+ * @property headCount Number of attention heads
+ * @property kvHeadCount Number of KV heads (smaller than [headCount] with grouped-query attention)
+ * @property parameterCount Number of model parameters
+ * @property sizeBytes Size of the weights in bytes
+ * @property maxSequences Sequences the context's KV cache can hold in parallel
+ * @property activeAdapters Number of LoRA adapters applied to the context
+ * @property kvCacheTypeK Element type of the K cache, e.g. "f16"
+ * @property kvCacheTypeV Element type of the V cache
+ * @property systemInfo llama.cpp system info, including the CPU features in use
+ * @property metadata GGUF metadata key/value pairs; long array values (such as the
+ *                    tokenizer vocabulary) are cut off with "..."
+ */
+data class ModelInfo(
+    val description: String,
+    val quantization: String,
+    val vocabSize: Int,
+    val trainContextSize: Int,
+    val contextSize: Int,
+    val embeddingSize: Int,
+    val layerCount: Int,
+    val headCount: Int,
+    val kvHeadCount: Int,
+    val parameterCount: Long,
+    val sizeBytes: Long,
+    val maxSequences: Int,
+    val activeAdapters: Int,
+    val kvCacheTypeK: String,
+    val kvCacheTypeV: String,
+    val systemInfo: String,
+    val metadata: Map<String, String>
+) {
+    /** Architecture from the "general.architecture" metadata key, e.g. "qwen3". */
+    val architecture: String?
+        get() = metadata["general.architecture"]
+    
+    /**
+     * Multi-line human-readable summary, for logs and interactive display.
+     * 
+     * @return Formatted model information
+     */
+    fun summary(): String = buildString {
+        appendLine("Model Information:")
+        appendLine("Model type: $description")
+        appendLine("Quantization: $quantization")
+        appendLine("Parameters: $parameterCount (${sizeBytes / (1024 * 1024)} MiB)")
+        appendLine("Layers: $layerCount, heads: $headCount, KV heads: $kvHeadCount")
+        appendLine("Vocabulary size: $vocabSize")
+        appendLine("Context size: $contextSize (trained on $trainContextSize)")
+        appendLine("KV cache type: K $kvCacheTypeK, V $kvCacheTypeV")
+        appendLine("Embedding size: $embeddingSize")
+        appendLine("LoRA adapters: $activeAdapters active")
+        append("System info: $systemInfo")
+    }
+    
+    companion object {
+        // Array layouts shared with LLAMA_JNI_INFO_* in llama_jni.h
+        internal const val FIELD_COUNT = 11
+        private const val STRING_COUNT = 5
+        
+        internal fun fromNative(values: LongArray, strings: Array<String>) = ModelInfo(
+            description = strings[0],
+            quantization = strings[1],
+            vocabSize = values[0].toInt(),
+            trainContextSize = values[1].toInt(),
+            contextSize = values[2].toInt(),
+            embeddingSize = values[3].toInt(),
+            layerCount = values[4].toInt(),
+            headCount = values[5].toInt(),
+            kvHeadCount = values[6].toInt(),
+            parameterCount = values[7],
+            sizeBytes = values[8],
+            maxSequences = values[9].toInt(),
+            activeAdapters = values[10].toInt(),
+            kvCacheTypeK = strings[2],
+            kvCacheTypeV = strings[3],
+            systemInfo = strings[4],
+            metadata = (STRING_COUNT until strings.size - 1 step 2).associate { strings[it] to strings[it + 1] }
+        )
+    }
+}
@@ -0,0 +1,27 @@
+package com.traycer.llama
+
+/**
+ * Options applied when model weights are loaded.
+ * 
+ * Fields are read natively by name, so renaming them requires updating llama_jni.cpp.
+ * 
+ * @property useMmap Memory-map the model file instead of reading it into memory (default: true)
+ * @property useMlock Lock the weights in RAM so they are never paged out (default: false)
+ * @property gpuLayers Number of layers to offload to the GPU, -1 for the llama.cpp default
+ * @property mainGpu GPU used for the model with [SplitMode.NONE], and for intermediate
+ *                   results with [SplitMode.ROW] (default: 0)
+ * @property splitMode How weights are split across GPUs (default: [SplitMode.LAYER])
+ * @property tensorSplit Proportion of the model to place on each GPU, or null for an even split
+ * @property checkTensors Validate tensor data while loading; slower cold start (default: false)
+ * @property progressListener Receives load progress and may abort the load
+ */
+data class ModelLoadOptions(
+    val useMmap: Boolean = true,
+    val useMlock: Boolean = false,
+    val gpuLayers: Int = -1,
+    val mainGpu: Int = 0,
+    val splitMode: SplitMode = SplitMode.LAYER,
+    val tensorSplit: FloatArray? = null,
+    val checkTensors: Boolean = false,
+    val progressListener: LoadProgressListener? = null
+)
@@ -0,0 +1,138 @@
+package com.traycer.llama
+
+import java.util.concurrent.CompletableFuture
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.ExecutionException
+import java.util.concurrent.Executors
+import java.util.concurrent.TimeUnit
+import java.util.concurrent.TimeoutException
+
+/**
+ * Loads a set of models in parallel at startup and reports ready only once every
+ * one of them has been warmed up, so a service can hold back from its load balancer
+ * until first-request latency matches steady state.
+ * 
+ * Each model gets one warmed-up context, available through [context]. The weights
+ * stay loaded for the lifetime of the pool, so [model] can create further contexts
+ * without reloading.
+ * 
+ * @param specs Models to load; names must be unique
+ * @throws IllegalArgumentException if two specs share a name
+ */
+class ModelPool(private val specs: List<ModelSpec>) : AutoCloseable {
+    
+    private val models = ConcurrentHashMap<String, LlamaModel>()
+    private val contexts = ConcurrentHashMap<String, LlamaWrapper>()
+    private var startup: CompletableFuture<Void>? = null
+    
+    init {
+        val duplicates = specs.groupBy { it.name }.filterValues { it.size > 1 }.keys
+        if (duplicates.isNotEmpty()) {
+            throw IllegalArgumentException("Duplicate model names: $duplicates")
+        }
+    }
+    
+    /**
+     * Start loading and warming up every model, one thread per model.
+     * Calling it again returns the same future.
+     * 
+     * @return Future completing once every model is warm, or exceptionally with the first failure
+     */
+    @Synchronized
+    fun start(): CompletableFuture<Void> {
+        startup?.let { return it }
+        
+        val executor = Executors.newFixedThreadPool(maxOf(1, specs.size)) { runnable ->
+            Thread(runnable, "llama-model-pool").apply { isDaemon = true }
+        }
+        val loads = specs.map { spec ->
+            CompletableFuture.runAsync({ load(spec) }, executor)
+        }
+        val future = CompletableFuture.allOf(*loads.toTypedArray())
+            .whenComplete { _, _ -> executor.shutdown() }
+        startup = future
+        return future
+    }
+    
+    /**
+     * Block until every model is warm, starting the pool if needed.
+     * 
+     * @param timeout Maximum time to wait
+     * @param unit Unit of [timeout]
+     * @return true if the pool is ready, false if the timeout elapsed first
+     * @throws RuntimeException if a model failed to load or warm up
+     */
+    fun awaitReady(timeout: Long, unit: TimeUnit): Boolean {
+        return try {
+            start().get(timeout, unit)
+            true
+        } catch (e: TimeoutException) {
+            false
+        } catch (e: ExecutionException) {
+            throw RuntimeException("Model pool failed to start: ${e.cause?.message}", e.cause)
+        }
+    }
+    
+    /**
+     * Check whether every model has been loaded and warmed up.
+     * 
+     * @return true once the pool can serve requests at steady-state latency
+     */
+    fun isReady(): Boolean {
+        val future = startup ?: return false
+        return future.isDone && !future.isCompletedExceptionally
+    }
+    
+    /**
+     * Get the warmed-up context of a model.
+     * 
+     * @param name Name from the model's [ModelSpec]
+     * @return The warmed-up context
+     * @throws IllegalStateException if the model is not loaded (yet)
+     */
+    fun context(name: String): LlamaWrapper {
+        return contexts[name] ?: throw IllegalStateException("Model not ready: $name")
+    }
+    
+    /**
+     * Get the loaded weights of a model, e.g. to create more contexts.
+     * 
+     * @param name Name from the model's [ModelSpec]
+     * @return The loaded weights
+     * @throws IllegalStateException if the model is not loaded (yet)
+     */
+    fun model(name: String): LlamaModel {
+        return models[name] ?: throw IllegalStateException("Model not ready: $name")
+    }
+    
+    private fun load(spec: ModelSpec) {
+        val model = LlamaModel(spec.modelPath, spec.draftModelPath, spec.loadOptions)
+        models[spec.name] = model
+        
+        val context = model.createContext(spec.contextSize, spec.threads, spec.contextOptions)
+        try {
+            context.warmup(spec.prefault)
+        } catch (e: Exception) {
+            context.cleanup()
+            throw e
+        }
+        contexts[spec.name] = context
+    }
+    
+    /**
+     * Release every context and model handle. Loads still in progress finish first.
+     */
+    override fun close() {
+        val future = synchronized(this) { startup }
+        try {
+            future?.join()
+        } catch (e: Exception) {
+            // Failed loads have nothing left to wait for
+        }
+        
+        contexts.values.forEach { it.cleanup() }
+        contexts.clear()
+        models.values.forEach { it.close() }
+        models.clear()
+    }
+}
@@ -0,0 +1,24 @@
+package com.traycer.llama
+
+/**
+ * A model that [ModelPool] loads and warms up at startup.
+ * 
+ * @property name Key the model is looked up by in the pool
+ * @property modelPath Path to the GGUF model file
+ * @property draftModelPath Optional smaller model for speculative decoding
+ * @property contextSize Context size of the warmed-up context (default: 2048)
+ * @property threads Number of decode threads (default: -1 for auto-detect)
+ * @property contextOptions Context tuning options
+ * @property loadOptions Loader settings such as mlock and GPU offload
+ * @property prefault Read the model file through the page cache before warming up (default: true)
+ */
+data class ModelSpec(
+    val name: String,
+    val modelPath: String,
+    val draftModelPath: String? = null,
+    val contextSize: Int = 2048,
+    val threads: Int = -1,
+    val contextOptions: ContextOptions = ContextOptions(),
+    val loadOptions: ModelLoadOptions = ModelLoadOptions(),
+    val prefault: Boolean = true
+)
@@ -0,0 +1,132 @@
+package com.traycer.llama
+
+/**
+ * Snapshot of the always-on native metrics, shared by every model and context in the
+ * process. Counters only grow; rates such as tokens/s come from the difference between
+ * two snapshots, or from Prometheus' rate() over [toPrometheus] scrapes.
+ * 
+ * @property decodeCalls llama_decode calls (prefill chunks, decode steps, embeddings), excluding
+ *                    draft model decodes
+ * @property decodeTokens Tokens submitted across all llama_decode calls
+ * @property decodeFailures llama_decode calls that returned an error
+ * @property promptTokens Prompt tokens of finished generations
+ * @property cachedTokens Prompt tokens served from the KV cache instead of being prefilled
+ * @property generatedTokens Tokens generated by finished generations
+ * @property requests Finished generations, successful or not
+ * @property requestErrors Generations that ended with an error
+ * @property preemptions Scheduler requests evicted for more urgent ones
+ * @property queueDepth Requests currently waiting in scheduler queues
+ * @property activeSequences Requests currently decoding in scheduler slots
+ * @property kvCellsUsed KV cache cells holding tokens, across all contexts
+ * @property kvCellsTotal KV cache cells allocated, across all contexts
+ * @property contexts Live context handles
+ * @property models Live model handles
+ * @property traceEvents Trace events recorded since tracing was first enabled
+ * @property decodeSeconds Latency of each llama_decode call
+ * @property batchFill Tokens per llama_decode call as a fraction of n_batch
+ * @property queueWaitSeconds Time scheduler requests waited for a slot
+ * @property jniMarshalSeconds Time spent converting strings between Java and UTF-8
+ * @property draftDecodeSeconds Latency of each draft model llama_decode call during
+ *                             speculative decoding
+ */
+data class NativeMetrics(
+    val decodeCalls: Long,
+    val decodeTokens: Long,
+    val decodeFailures: Long,
+    val promptTokens: Long,
+    val cachedTokens: Long,
+    val generatedTokens: Long,
+    val requests: Long,
+    val requestErrors: Long,
+    val preemptions: Long,
+    val queueDepth: Long,
+    val activeSequences: Long,
+    val kvCellsUsed: Long,
+    val kvCellsTotal: Long,
+    val contexts: Long,
+    val models: Long,
+    val traceEvents: Long,
+    val decodeSeconds: MetricsHistogram,
+    val batchFill: MetricsHistogram,
+    val queueWaitSeconds: MetricsHistogram,
+    val jniMarshalSeconds: MetricsHistogram,
+    val draftDecodeSeconds: MetricsHistogram
+) {
+    /** Fraction of all allocated KV cache cells in use, between 0 and 1. */
+    val kvCacheUsage: Double
+        get() = if (kvCellsTotal > 0) kvCellsUsed.toDouble() / kvCellsTotal else 0.0
+    
+    /**
+     * Format the snapshot in the Prometheus text exposition format, ready to serve
+     * from a /metrics endpoint.
+     * 
+     * @param prefix Prefix of every metric name (default: "llama_jni")
+     * @return Exposition text
+     */
+    fun toPrometheus(prefix: String = "llama_jni"): String {
+        val out = StringBuilder()
+        fun scalar(name: String, type: String, help: String, value: Long) {
+            out.append("# HELP ").append(prefix).append('_').append(name).append(' ').append(help).append('\n')
+            out.append("# TYPE ").append(prefix).append('_').append(name).append(' ').append(type).append('\n')
+            out.append(prefix).append('_').append(name).append(' ').append(value).append('\n')
+        }
+        scalar("decode_calls_total", "counter", "llama_decode calls.", decodeCalls)
+        scalar("decode_tokens_total", "counter", "Tokens submitted to llama_decode.", decodeTokens)
+        scalar("decode_failures_total", "counter", "llama_decode calls that failed.", decodeFailures)
+        scalar("prompt_tokens_total", "counter", "Prompt tokens of finished generations.", promptTokens)
+        scalar("cached_prompt_tokens_total", "counter", "Prompt tokens served from the KV cache.", cachedTokens)
+        scalar("generated_tokens_total", "counter", "Generated tokens.", generatedTokens)
+        scalar("requests_total", "counter", "Finished generations.", requests)
+        scalar("request_errors_total", "counter", "Generations that ended with an error.", requestErrors)
+        scalar("preemptions_total", "counter", "Scheduler requests preempted by more urgent ones.", preemptions)
+        scalar("queue_depth", "gauge", "Requests waiting in scheduler queues.", queueDepth)
+        scalar("active_sequences", "gauge", "Requests decoding in scheduler slots.", activeSequences)
+        scalar("kv_cells_used", "gauge", "KV cache cells holding tokens.", kvCellsUsed)
+        scalar("kv_cells_total", "gauge", "KV cache cells allocated.", kvCellsTotal)
+        scalar("contexts", "gauge", "Live context handles.", contexts)
+        scalar("models", "gauge", "Live model handles.", models)
+        decodeSeconds.writePrometheus(out, "${prefix}_decode_seconds", "Latency of each llama_decode call.")
+        batchFill.writePrometheus(out, "${prefix}_batch_fill_ratio", "Tokens per llama_decode call as a fraction of n_batch.")
+        queueWaitSeconds.writePrometheus(out, "${prefix}_queue_wait_seconds", "Time scheduler requests waited for a slot.")
+        jniMarshalSeconds.writePrometheus(out, "${prefix}_jni_marshal_seconds", "Time converting strings across JNI.")
+        draftDecodeSeconds.writePrometheus(out, "${prefix}_draft_decode_seconds", "Latency of each draft model llama_decode call.")
+        return out.toString()
+    }
+    
+    companion object {
+        // Array layout shared with LLAMA_JNI_METRIC_* and LLAMA_JNI_HISTOGRAM_* in llama_jni.h
+        private const val SCALAR_COUNT = 16
+        
+        internal fun fromArray(values: DoubleArray): NativeMetrics {
+            var offset = SCALAR_COUNT
+            val histograms = List(5) {
+                val (histogram, next) = MetricsHistogram.fromArray(values, offset)
+                offset = next
+                histogram
+            }
+            return NativeMetrics(
+                decodeCalls = values[0].toLong(),
+                decodeTokens = values[1].toLong(),
+                decodeFailures = values[2].toLong(),
+                promptTokens = values[3].toLong(),
+                cachedTokens = values[4].toLong(),
+                generatedTokens = values[5].toLong(),
+                requests = values[6].toLong(),
+                requestErrors = values[7].toLong(),
+                preemptions = values[8].toLong(),
+                queueDepth = values[9].toLong(),
+                activeSequences = values[10].toLong(),
+                kvCellsUsed = values[11].toLong(),
+                kvCellsTotal = values[12].toLong(),
+                contexts = values[13].toLong(),
+                models = values[14].toLong(),
+                traceEvents = values[15].toLong(),
+                decodeSeconds = histograms[0],
+                batchFill = histograms[1],
+                queueWaitSeconds = histograms[2],
+                jniMarshalSeconds = histograms[3],
+                draftDecodeSeconds = histograms[4]
+            )
+        }
+    }
+}
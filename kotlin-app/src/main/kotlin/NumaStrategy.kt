@@ -0,0 +1,19 @@
+package com.traycer.llama
+
+/**
+ * Process-wide NUMA placement used by ggml, selected with [LlamaWrapper.initNuma].
+ * 
+ * @property nativeValue ggml_numa_strategy value passed to native code
+ */
+enum class NumaStrategy(val nativeValue: Int) {
+    /** No NUMA-specific placement */
+    DISABLED(0),
+    /** Spread threads evenly across all nodes */
+    DISTRIBUTE(1),
+    /** Keep threads on the node the process started on */
+    ISOLATE(2),
+    /** Honour the CPU set given by numactl */
+    NUMACTL(3),
+    /** Mirror weights on every node */
+    MIRROR(4)
+}
@@ -186,10 +186,16 @@ object PromptSuite {
             }
             println("✅ Model loaded successfully in ${loadTime}ms")
             
+            // Keep the first prompt's metrics free of cold-start page faults
+            val warmupTime = measureTimeMillis {
+                wrapper.warmup(prefault = true)
+            }
+            println("🔥 Warmed up in ${warmupTime}ms")
+            
             // Display model information
             wrapper.getModelInfo()?.let { info ->
                 println("📊 Model Information:")
-                info.lines().forEach { line ->
+                info.summary().lines().forEach { line ->
                     if (line.isNotBlank()) {
                         println("   $line")
                     }
@@ -212,19 +218,45 @@ object PromptSuite {
         prompt: String
     ): Pair<String?, Long> {
         return try {
-            val generationTime = measureTimeMillis {
-                val response = wrapper.generateText(
-                    prompt = prompt,
+            val result = wrapper.generateTextWithStats(
+                prompt = prompt,
+                maxTokens = MAX_TOKENS,
+                temperature = TEMPERATURE,
+                topP = TOP_P,
+                topK = TOP_K
+            )
+            val stats = result.stats
+            println("   📈 ${stats.promptTokens} prompt tokens (${stats.cachedTokens} cached), TTFT ${"%.1f".format(stats.timeToFirstTokenMs)}ms, " +
+                    "prefill ${"%.1f".format(stats.prefillTokensPerSecond)} tok/s, decode ${"%.1f".format(stats.decodeTokensPerSecond)} tok/s, " +
+                    "KV ${stats.kvCacheUsed}/${stats.kvCacheSize}")
+            Pair(result.text, stats.totalMs.toLong())
+        } catch (e: Exception) {
+            println("   ⚠️  Error: ${e.message}")
+            Pair(null, 0L)
+        }
+    }
+    
+    /**
+     * Generates every prompt in one batched native call. Per-prompt times are the
+     * batch time divided evenly, since the prompts are decoded together.
+     */
+    private fun processBatch(wrapper: LlamaWrapper, prompts: List<String>): List<Pair<String?, Long>> {
+        return try {
+            val responses: List<String>
+            val batchTime = measureTimeMillis {
+                responses = wrapper.generateBatch(
+                    prompts = prompts,
                     maxTokens = MAX_TOKENS,
                     temperature = TEMPERATURE,
                     topP = TOP_P,
                     topK = TOP_K
                 )
             }
-            Pair(wrapper.generateText(prompt, MAX_TOKENS, TEMPERATURE, TOP_P, TOP_K), generationTime)
+            println("   📈 ${prompts.size} prompts in ${batchTime}ms")
+            responses.map { Pair(it, batchTime / prompts.size) }
         } catch (e: Exception) {
             println("   ⚠️  Error: ${e.message}")
-            Pair(null, 0L)
+            prompts.map { Pair(null, 0L) }
         }
     }
     
@@ -265,10 +297,12 @@ object PromptSuite {
     }
     
     /**
-     * Main function that runs the entire prompt suite
+     * Main function that runs the entire prompt suite.
+     * Pass --batch to generate all prompts in one batched call instead of one by one.
      */
     @JvmStatic
     fun main(args: Array<String>) {
+        val batchMode = args.contains("--batch")
         println("🧪 LLM Prompt Test Suite")
         println("=" .repeat(50))
         println("📋 Testing ${testPrompts.size} diverse prompts")
@@ -294,11 +328,18 @@ object PromptSuite {
             println("🚀 Starting prompt suite execution...")
             println("-".repeat(50))
             
-            // Process each prompt
+            // Process each prompt, or all of them at once in batch mode
+            val batchResults = if (batchMode) {
+                println("📦 Generating all ${testPrompts.size} prompts in one batch")
+                processBatch(wrapper, testPrompts)
+            } else {
+                null
+            }
+            
             testPrompts.forEachIndexed { index, prompt ->
                 println("${(index + 1).toString().padStart(2)}/${testPrompts.size} Processing: ${prompt.take(60)}${if (prompt.length > 60) "..." else ""}")
                 
-                val (response, generationTime) = processPrompt(wrapper, index, prompt)
+                val (response, generationTime) = batchResults?.get(index) ?: processPrompt(wrapper, index, prompt)
                 
                 if (response != null) {
                     // Show preview of response
@@ -0,0 +1,18 @@
+package com.traycer.llama
+
+/**
+ * Scheduling class of a request, set through [GenerationConstraints.priority]. With the
+ * scheduler running, queued requests of a more urgent class are admitted first and may
+ * preempt running requests of a less urgent one, which resume later from where they
+ * were evicted.
+ * 
+ * @property nativeValue Priority read by native code; lower runs first
+ */
+enum class RequestPriority(val nativeValue: Int) {
+    /** Latency-sensitive traffic such as chat; never preempted */
+    INTERACTIVE(0),
+    /** Default */
+    NORMAL(1),
+    /** Bulk jobs that yield their slots to everything else */
+    BATCH(2)
+}
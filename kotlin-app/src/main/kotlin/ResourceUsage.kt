@@ -0,0 +1,44 @@
+package com.traycer.llama
+
+/**
+ * Memory held by one context, as tracked by the native resource manager. All sizes are
+ * in bytes.
+ * 
+ * The KV cache is allocated in full when the context is created, so [kvCacheBytes] is
+ * what the context costs regardless of load; [kvCacheUsedBytes] shows how much of it
+ * the current sequences occupy.
+ * 
+ * @property weightsBytes Model weights (and draft model) in memory, shared with other
+ *                        contexts on the same [LlamaModel]
+ * @property kvCacheBytes KV caches of the context and its draft context
+ * @property kvCacheUsedBytes Part of [kvCacheBytes] holding cached tokens
+ * @property computeBytes Compute and output buffers, as sized by llama.cpp
+ * @property stateCacheBytes Saved session states kept in memory by the state cache
+ * @property reservedBytes KV and compute bytes this context holds against the memory budget
+ */
+data class ResourceUsage(
+    val weightsBytes: Long,
+    val kvCacheBytes: Long,
+    val kvCacheUsedBytes: Long,
+    val computeBytes: Long,
+    val stateCacheBytes: Long,
+    val reservedBytes: Long
+) {
+    /** Part of the KV cache not holding any tokens. */
+    val kvCacheFreeBytes: Long
+        get() = maxOf(0L, kvCacheBytes - kvCacheUsedBytes)
+    
+    companion object {
+        // Array layout shared with LLAMA_JNI_RES_* in llama_jni.h
+        internal const val FIELD_COUNT = 6
+        
+        internal fun fromArray(values: LongArray) = ResourceUsage(
+            weightsBytes = values[0],
+            kvCacheBytes = values[1],
+            kvCacheUsedBytes = values[2],
+            computeBytes = values[3],
+            stateCacheBytes = values[4],
+            reservedBytes = values[5]
+        )
+    }
+}
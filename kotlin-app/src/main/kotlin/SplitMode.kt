@@ -0,0 +1,15 @@
+package com.traycer.llama
+
+/**
+ * How model weights are split across multiple GPUs.
+ * 
+ * @property nativeValue llama_split_mode value read by native code
+ */
+enum class SplitMode(val nativeValue: Int) {
+    /** Use only [ModelLoadOptions.mainGpu] */
+    NONE(0),
+    /** Split whole layers (and KV cache) across GPUs */
+    LAYER(1),
+    /** Split tensors row-wise across GPUs */
+    ROW(2)
+}
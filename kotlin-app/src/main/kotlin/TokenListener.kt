@@ -0,0 +1,16 @@
+package com.traycer.llama
+
+/**
+ * Receives generated text incrementally during streaming generation.
+ */
+fun interface TokenListener {
+    
+    /**
+     * Called with each decoded chunk of text as soon as it is available.
+     * Chunks always end on a complete UTF-8 character.
+     * 
+     * @param piece The newly generated text
+     * @return true to continue generating, false to stop early
+     */
+    fun onToken(piece: String): Boolean
+}
@@ -1,354 +1,4880 @@
 #include <jni.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <cstring>
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
+#include <shared_mutex>
 #include <random>
 #include <algorithm>
 #include <thread>
 #include <iostream>
+#include <functional>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <fstream>
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include <cctype>
+#include <chrono>
+#include <set>
+#include <dlfcn.h>
 #include "llama.h"
+#include "ggml-backend.h"
+#include "llama_jni.h"
+
+// Process-wide memory budget. Model weights, KV caches and compute buffers are reserved
+// against it before they are allocated, so a host packing many models fails a load
+// instead of having the JVM OOM-killed. A limit of 0 disables the check.
+struct MemoryBudget {
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint64_t limit = 0;
+    uint64_t reserved = 0;
+    int64_t wait_ms = 0;  // how long a reservation may queue for memory to be released
+};
+
+static MemoryBudget g_budget;
+
+// Reserve bytes, queueing up to wait_ms for other reservations to be released.
+// Returns false when they still would not fit.
+bool budget_reserve(uint64_t bytes) {
+    std::unique_lock<std::mutex> lock(g_budget.mutex);
+    auto fits = [bytes] { return g_budget.limit == 0 || g_budget.reserved + bytes <= g_budget.limit; };
+    if (!fits() && g_budget.wait_ms > 0) {
+        g_budget.cv.wait_for(lock, std::chrono::milliseconds(g_budget.wait_ms), fits);
+    }
+    if (!fits()) {
+        return false;
+    }
+    g_budget.reserved += bytes;
+    return true;
+}
+
+void budget_release(uint64_t bytes) {
+    if (bytes == 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_budget.mutex);
+        g_budget.reserved -= std::min(bytes, g_budget.reserved);
+    }
+    g_budget.cv.notify_all();
+}
+
+// Bytes one model or context holds against the budget, released when it is destroyed
+struct BudgetReservation {
+    std::atomic<uint64_t> bytes{0};
+    
+    BudgetReservation() = default;
+    BudgetReservation(const BudgetReservation&) = delete;
+    BudgetReservation& operator=(const BudgetReservation&) = delete;
+    
+    ~BudgetReservation() {
+        release();
+    }
+    
+    bool grow(uint64_t extra) {
+        if (!budget_reserve(extra)) {
+            return false;
+        }
+        bytes += extra;
+        return true;
+    }
+    
+    void release() {
+        budget_release(bytes);
+        bytes = 0;
+    }
+};
+
+// Loaded model weights, shared by every context created from them.
+// Freed when the model handle and all of its contexts are released.
+struct LlamaModel {
+    llama_model* model = nullptr;
+    std::string path;
+    llama_model* draft = nullptr;  // optional small model proposing tokens for speculative decoding
+    std::string draft_path;
+    bool use_mmap = true;          // weights are paged in from the file on first touch
+    
+    // LoRA adapters loaded on these weights, by handle. They stay loaded as long as the
+    // weights, since any context on them may have one applied.
+    std::mutex adapters_mutex;
+    std::unordered_map<jlong, llama_adapter_lora*> adapters;
+    
+    // File sizes of the weights and adapters, reserved before they are loaded
+    BudgetReservation reservation;
+    
+    ~LlamaModel() {
+        for (auto& entry : adapters) {
+            llama_adapter_lora_free(entry.second);
+        }
+        adapters.clear();
+        if (draft != nullptr) {
+            llama_model_free(draft);
+            draft = nullptr;
+        }
+        if (model != nullptr) {
+            llama_model_free(model);
+            model = nullptr;
+        }
+    }
+};
+
+// Index of the highest logit: the greedy fast path, a single pass with no candidate array
+llama_token argmax_token(const float* logits, int n_vocab) {
+    int best_token = 0;
+    float best_logit = logits[0];
+    
+    for (int i = 1; i < n_vocab; i++) {
+        if (logits[i] > best_logit) {
+            best_logit = logits[i];
+            best_token = i;
+        }
+    }
+    
+    return best_token;
+}
+
+// Per-request sampling settings, resolved once before decoding starts
+struct GenerationParams {
+    int max_tokens = 256;
+    float temperature = 0.8f;
+    float top_p = 0.9f;
+    int top_k = 40;
+    uint32_t seed = 0;
+    std::vector<std::string> stop;    // generation ends before the first of these, excluded from the output
+    std::string grammar;              // GBNF constraining every sampled token; empty for none
+    std::string grammar_root = "root";
+    
+    // Scheduling; only used when the request runs through the scheduler
+    int priority = LLAMA_JNI_PRIORITY_NORMAL;  // lower runs first and may preempt higher
+    int64_t deadline_ms = 0;                     // fails the request this long after submission; 0 for none
+    std::string tenant;                          // requests share decode capacity fairly between tenants
+};
+
+// Timings and token counts of one generation, measured with a monotonic clock.
+// Copied into the Kotlin stats array in LLAMA_JNI_STAT_* order.
+struct GenerationStats {
+    int prompt_tokens = 0;
+    int cached_tokens = 0;      // prompt tokens served from the KV cache
+    int generated_tokens = 0;
+    double queue_ms = 0;        // time waiting for a scheduler slot
+    double tokenize_ms = 0;
+    double prefill_ms = 0;
+    double ttft_ms = 0;         // call start to first sampled token
+    double decode_ms = 0;       // end of prefill to the last sampled token
+    double total_ms = 0;
+    int kv_used = 0;            // KV cells in use when the request finished
+    int kv_size = 0;
+    int draft_rounds = 0;       // speculative draft-and-verify steps
+    int draft_tokens = 0;       // tokens proposed by the draft model
+    int draft_accepted = 0;     // proposed tokens the target model agreed with
+    int discarded_tokens = 0;   // tokens dropped by prompt truncation or context shifts
+    int preemptions = 0;        // times the scheduler evicted the request for a more urgent one
+};
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// Always-on process metrics. Every update is a relaxed atomic increment, so recording
+// costs a few nanoseconds and never blocks a decode step; nativeGetMetrics reads a
+// snapshot that may be a step behind but needs no lock.
+struct Histogram {
+    const std::vector<uint64_t> bounds;  // inclusive upper bounds in the recorded unit, ascending
+    const double scale;                  // multiplier converting the unit for export (e.g. us to s)
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets;  // one per bound plus +Inf
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> count{0};
+    
+    Histogram(std::vector<uint64_t> upper_bounds, double unit_scale)
+        : bounds(std::move(upper_bounds)), scale(unit_scale), buckets(new std::atomic<uint64_t>[bounds.size() + 1]()) {}
+    
+    void record(uint64_t value) {
+        const size_t i = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+        buckets[i].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+struct Metrics {
+    std::atomic<uint64_t> decode_calls{0};
+    std::atomic<uint64_t> decode_tokens{0};
+    std::atomic<uint64_t> decode_failures{0};
+    std::atomic<uint64_t> prompt_tokens{0};
+    std::atomic<uint64_t> cached_tokens{0};
+    std::atomic<uint64_t> generated_tokens{0};
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> request_errors{0};
+    std::atomic<uint64_t> preemptions{0};
+    std::atomic<int64_t> queue_depth{0};       // requests waiting in scheduler queues
+    std::atomic<int64_t> active_sequences{0};  // requests bound to scheduler slots
+    
+    Histogram decode_us{{100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000}, 1e-6};
+    Histogram batch_fill_pct{{5, 10, 25, 50, 75, 90, 100}, 0.01};
+    Histogram queue_wait_us{{1000, 5000, 10000, 50000, 100000, 250000, 500000, 1000000, 5000000, 10000000}, 1e-6};
+    Histogram jni_marshal_ns{{250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 1000000}, 1e-9};
+    Histogram draft_decode_us{{100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000}, 1e-6};
+};
+
+static Metrics g_metrics;
+
+// Chrome trace event ring buffer, written lock-free by any thread while tracing is
+// enabled. Each slot carries a sequence number that is odd while it is being written,
+// so a dump running concurrently skips slots it would otherwise read half-written.
+struct TraceEvent {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<char> phase{'X'};              // 'X' complete event, 'i' instant event
+    std::atomic<int64_t> ts_us{0};
+    std::atomic<int64_t> dur_us{0};
+    std::atomic<uint32_t> tid{0};
+    std::atomic<const char*> arg_names[2] = {};  // static strings, or null when unused
+    std::atomic<int64_t> args[2] = {};
+};
+
+struct TraceBuffer {
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[LLAMA_JNI_TRACE_EVENTS]};
+    std::atomic<uint64_t> next{0};  // total events ever written; the slot is next % capacity
+    std::atomic<uint64_t> first{0}; // events before this were cleared
+    Clock::time_point epoch = Clock::now();
+};
+
+static std::atomic<bool> g_trace_enabled{false};
+static std::atomic<TraceBuffer*> g_trace{nullptr};  // allocated on first enable, never freed
+static std::atomic<uint32_t> g_next_trace_tid{1};
+
+uint32_t trace_tid() {
+    thread_local const uint32_t tid = g_next_trace_tid.fetch_add(1, std::memory_order_relaxed);
+    return tid;
+}
+
+void trace_event(const char* name, char phase, Clock::time_point start, Clock::time_point end,
+                 const char* arg0 = nullptr, int64_t value0 = 0, const char* arg1 = nullptr, int64_t value1 = 0) {
+    if (!g_trace_enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    TraceBuffer* trace = g_trace.load(std::memory_order_acquire);
+    const uint64_t index = trace->next.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent& event = trace->events[index % LLAMA_JNI_TRACE_EVENTS];
+    
+    event.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.phase.store(phase, std::memory_order_relaxed);
+    event.ts_us.store(std::chrono::duration_cast<std::chrono::microseconds>(start - trace->epoch).count(), std::memory_order_relaxed);
+    event.dur_us.store(std::chrono::duration_cast<std::chrono::microseconds>(end - start).count(), std::memory_order_relaxed);
+    event.tid.store(trace_tid(), std::memory_order_relaxed);
+    event.arg_names[0].store(arg0, std::memory_order_relaxed);
+    event.args[0].store(value0, std::memory_order_relaxed);
+    event.arg_names[1].store(arg1, std::memory_order_relaxed);
+    event.args[1].store(value1, std::memory_order_relaxed);
+    event.seq.store(2 * index + 2, std::memory_order_release);
+}
+
+uint64_t elapsed_us(Clock::time_point from, Clock::time_point to) {
+    return static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(to - from).count()));
+}
+
+// Counts one finished generation in the process metrics
+void record_request(const GenerationStats& stats, const std::string& error) {
+    g_metrics.requests.fetch_add(1, std::memory_order_relaxed);
+    if (!error.empty()) {
+        g_metrics.request_errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    g_metrics.prompt_tokens.fetch_add(stats.prompt_tokens, std::memory_order_relaxed);
+    g_metrics.cached_tokens.fetch_add(stats.cached_tokens, std::memory_order_relaxed);
+    g_metrics.generated_tokens.fetch_add(stats.generated_tokens, std::memory_order_relaxed);
+}
+
+// Measures the enclosing scope as JNI marshaling time
+struct JniMarshalTimer {
+    Clock::time_point start = Clock::now();
+    ~JniMarshalTimer() {
+        g_metrics.jni_marshal_ns.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+    }
+};
+
+// Sampler pipeline configured once per request: greedy argmax when temperature <= 0,
+// otherwise top-k (bounded heap), top-p, temperature and a seeded draw, applied in
+// the same order as llama.cpp's default sampler chain. Only the k best logits are
+// ever copied or sorted, and the candidate buffer is reused across tokens.
+// With a grammar, the sampled token is checked against it first and the whole
+// vocabulary is masked and resampled only when the grammar rejects it.
+struct TokenSampler {
+    int n_vocab;
+    float temperature;
+    float top_p;
+    int top_k;
+    std::mt19937 rng;
+    std::vector<llama_token_data> candidates;
+    llama_sampler* grammar = nullptr;
+    std::vector<llama_token_data> grammar_candidates;  // whole vocabulary, only for rejections
+    std::vector<float> masked_logits;
+    
+    TokenSampler(const llama_vocab* vocab, const GenerationParams& params)
+        : n_vocab(llama_vocab_n_tokens(vocab)),
+          temperature(params.temperature),
+          top_p(params.top_p),
+          top_k((params.top_k > 0 && params.top_k < n_vocab) ? params.top_k : n_vocab),
+          rng(params.seed) {
+        if (temperature > 0.0f) {
+            candidates.reserve(top_k);
+        }
+        if (!params.grammar.empty()) {
+            grammar = llama_sampler_init_grammar(vocab, params.grammar.c_str(), params.grammar_root.c_str());
+        }
+    }
+    
+    ~TokenSampler() {
+        if (grammar != nullptr) {
+            llama_sampler_free(grammar);
+        }
+    }
+    
+    TokenSampler(const TokenSampler&) = delete;
+    TokenSampler& operator=(const TokenSampler&) = delete;
+    
+    bool is_greedy() const {
+        return temperature <= 0.0f || top_k == 1;
+    }
+    
+    llama_token sample(const float* logits) {
+        if (grammar == nullptr) {
+            return select(logits);
+        }
+        
+        // Most tokens already satisfy the grammar, so check the unconstrained choice alone
+        llama_token token = select(logits);
+        llama_token_data single = {token, logits[token], 0.0f};
+        llama_token_data_array single_array = {&single, 1, -1, false};
+        llama_sampler_apply(grammar, &single_array);
+        
+        if (std::isinf(single.logit)) {
+            grammar_candidates.resize(n_vocab);
+            for (int i = 0; i < n_vocab; i++) {
+                grammar_candidates[i] = {i, logits[i], 0.0f};
+            }
+            llama_token_data_array all = {grammar_candidates.data(), grammar_candidates.size(), -1, false};
+            llama_sampler_apply(grammar, &all);
+            
+            masked_logits.resize(n_vocab);
+            for (int i = 0; i < n_vocab; i++) {
+                masked_logits[grammar_candidates[i].id] = grammar_candidates[i].logit;
+            }
+            token = select(masked_logits.data());
+        }
+        
+        llama_sampler_accept(grammar, token);
+        return token;
+    }
+    
+    llama_token select(const float* logits) {
+        if (is_greedy()) {
+            return argmax_token(logits, n_vocab);
+        }
+        
+        // Keep the top_k logits in a min-heap so each token costs one comparison
+        auto heap_cmp = [](const llama_token_data& a, const llama_token_data& b) { return a.logit > b.logit; };
+        candidates.clear();
+        for (int i = 0; i < n_vocab; i++) {
+            if (static_cast<int>(candidates.size()) < top_k) {
+                candidates.push_back({i, logits[i], 0.0f});
+                std::push_heap(candidates.begin(), candidates.end(), heap_cmp);
+            } else if (logits[i] > candidates.front().logit) {
+                std::pop_heap(candidates.begin(), candidates.end(), heap_cmp);
+                candidates.back() = {i, logits[i], 0.0f};
+                std::push_heap(candidates.begin(), candidates.end(), heap_cmp);
+            }
+        }
+        // Sorting the heap with the min-heap comparator leaves logits in descending order
+        std::sort_heap(candidates.begin(), candidates.end(), heap_cmp);
+        
+        // Top-p: keep the smallest prefix whose probability mass reaches top_p
+        const float max_logit = candidates.front().logit;
+        size_t n_keep = candidates.size();
+        if (top_p > 0.0f && top_p < 1.0f) {
+            float sum = 0.0f;
+            for (auto& c : candidates) {
+                c.p = std::exp(c.logit - max_logit);
+                sum += c.p;
+            }
+            float cumulative = 0.0f;
+            for (size_t i = 0; i < candidates.size(); i++) {
+                cumulative += candidates[i].p / sum;
+                if (cumulative >= top_p) {
+                    n_keep = i + 1;
+                    break;
+                }
+            }
+        }
+        
+        // Temperature-scaled softmax over the survivors, then a seeded draw
+        float sum = 0.0f;
+        for (size_t i = 0; i < n_keep; i++) {
+            candidates[i].p = std::exp((candidates[i].logit - max_logit) / temperature);
+            sum += candidates[i].p;
+        }
+        
+        float r = std::uniform_real_distribution<float>(0.0f, sum)(rng);
+        for (size_t i = 0; i < n_keep; i++) {
+            r -= candidates[i].p;
+            if (r <= 0.0f) {
+                return candidates[i].id;
+            }
+        }
+        return candidates[n_keep - 1].id;
+    }
+};
+
+// Whether params has no grammar or one llama.cpp can compile against vocab
+bool grammar_is_valid(const llama_vocab* vocab, const GenerationParams& params) {
+    if (params.grammar.empty()) {
+        return true;
+    }
+    llama_sampler* grammar = llama_sampler_init_grammar(vocab, params.grammar.c_str(), params.grammar_root.c_str());
+    if (grammar == nullptr) {
+        return false;
+    }
+    llama_sampler_free(grammar);
+    return true;
+}
+
+// Serialized KV state of sequence 0 together with the tokens it holds
+struct StateSnapshot {
+    std::vector<llama_token> tokens;
+    std::vector<uint8_t> data;
+    
+    size_t size_bytes() const {
+        return data.size() + tokens.size() * sizeof(llama_token);
+    }
+};
+
+// Named snapshots kept per context in LRU order. Entries evicted past max_bytes
+// are written to spill_dir when one is configured, and dropped otherwise.
+struct SessionCache {
+    size_t max_bytes = 256u * 1024u * 1024u;
+    std::string spill_dir;
+    std::list<std::pair<std::string, StateSnapshot>> entries;  // most recently used first
+    std::unordered_map<std::string, std::list<std::pair<std::string, StateSnapshot>>::iterator> index;
+    std::atomic<size_t> used_bytes{0};  // also read by nativeGetResourceUsage without the exec lock
+};
+
+struct LlamaContext;
+
+// Length of the longest prefix of str that does not end inside a multi-byte UTF-8 sequence
+size_t utf8_complete_prefix_len(const std::string& str) {
+    size_t i = str.size();
+    int continuation = 0;
+    
+    // Walk back over continuation bytes to the lead byte of the last sequence
+    while (i > 0 && continuation < 4) {
+        unsigned char c = static_cast<unsigned char>(str[i - 1]);
+        if ((c & 0xC0) != 0x80) {
+            int expected = 1;
+            if ((c & 0xE0) == 0xC0) expected = 2;
+            else if ((c & 0xF0) == 0xE0) expected = 3;
+            else if ((c & 0xF8) == 0xF0) expected = 4;
+            return (continuation + 1 >= expected) ? str.size() : i - 1;
+        }
+        continuation++;
+        i--;
+    }
+    return str.size();
+}
+
+// Incremental detokenizer: converts one token at a time and releases text only up to
+// the last complete UTF-8 code point, holding a character split across tokens back for
+// the next one. The piece buffer grows for tokens longer than its current size.
+// With stop strings, text that could still become a stop string is held back too, and
+// once one appears the output ends right before it and stopped is set.
+struct Detokenizer {
+    const llama_vocab* vocab = nullptr;
+    std::vector<std::string> stop;
+    bool stopped = false;
+    std::string buffer;                   // decoded bytes; the first n_ready were last returned
+    size_t n_ready = 0;
+    std::vector<char> piece = std::vector<char>(256);
+    
+    void reset(const llama_vocab* v, const std::vector<std::string>& stop_strings = {}) {
+        vocab = v;
+        stop.clear();
+        for (const auto& s : stop_strings) {
+            if (!s.empty()) {
+                stop.push_back(s);
+            }
+        }
+        stopped = false;
+        buffer.clear();
+        n_ready = 0;
+    }
+    
+    // Decode token and return the newly completed text, valid until the next call.
+    // Empty when the token only added part of a multi-byte character or of a stop string.
+    std::string_view push(llama_token token) {
+        buffer.erase(0, n_ready);
+        n_ready = 0;
+        if (stopped) {
+            return std::string_view();
+        }
+        
+        int n = llama_token_to_piece(vocab, token, piece.data(), static_cast<int32_t>(piece.size()), 0, false);
+        if (n < 0) {
+            // Too small: llama.cpp returns the negated required size
+            piece.resize(-n);
+            n = llama_token_to_piece(vocab, token, piece.data(), static_cast<int32_t>(piece.size()), 0, false);
+        }
+        if (n > 0) {
+            buffer.append(piece.data(), n);
+        }
+        
+        n_ready = utf8_complete_prefix_len(buffer);
+        if (!stop.empty()) {
+            n_ready = match_stop(n_ready);
+        }
+        return std::string_view(buffer.data(), n_ready);
+    }
+    
+    // Release what is left at the end of generation. A character that never completed
+    // becomes U+FFFD instead of invalid UTF-8.
+    std::string_view flush() {
+        buffer.erase(0, n_ready);
+        n_ready = 0;
+        if (stopped) {
+            buffer.clear();
+        }
+        const size_t complete = utf8_complete_prefix_len(buffer);
+        if (complete < buffer.size()) {
+            buffer.resize(complete);
+            buffer += "\xEF\xBF\xBD";
+        }
+        n_ready = buffer.size();
+        return std::string_view(buffer.data(), n_ready);
+    }
+    
+    // Length of buffer[0, complete) that can be released. Only unreleased text is
+    // buffered, so the search spans a few tokens at most.
+    size_t match_stop(size_t complete) {
+        const std::string_view text(buffer.data(), complete);
+        size_t first = std::string_view::npos;
+        for (const auto& s : stop) {
+            first = std::min(first, text.find(s));
+        }
+        if (first != std::string_view::npos) {
+            stopped = true;
+            buffer.resize(first);
+            return first;
+        }
+        
+        // Hold back the longest tail that is the start of some stop string
+        size_t held = 0;
+        for (const auto& s : stop) {
+            for (size_t len = std::min(s.size() - 1, complete); len > held; len--) {
+                if (text.compare(complete - len, len, s, 0, len) == 0) {
+                    held = len;
+                    break;
+                }
+            }
+        }
+        return complete - held;
+    }
+};
+
+// A generation request submitted to the scheduler by a JVM thread
+struct SchedulerRequest {
+    std::vector<llama_token> prompt;  // extended with the generated tokens when preempted
+    size_t n_prompt = 0;              // length of the original prompt
+    int max_tokens = 256;
+    std::vector<std::string> stop;
+    std::unique_ptr<TokenSampler> sampler;
+    
+    // Scheduling class; see GenerationParams
+    int priority = LLAMA_JNI_PRIORITY_NORMAL;
+    Clock::time_point deadline;       // default-constructed for none
+    std::string tenant;
+    
+    // Generation progress, kept across preemptions; only the scheduler thread touches these
+    Detokenizer detokenizer;
+    int n_generated = 0;
+    
+    // Guards output, done and error; the submitter waits on cv for new output
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string output;
+    bool done = false;
+    std::string error;
+    
+    // Set by the submitter when its listener asks to stop
+    std::atomic<bool> cancelled{false};
+    
+    // Filled by the scheduler thread; read by the submitter once done is set
+    GenerationStats stats;
+    Clock::time_point t_submitted;
+    Clock::time_point t_queued;       // submission, or the latest preemption
+    Clock::time_point t_admitted;
+    Clock::time_point t_first_token;
+};
+
+// One sequence slot of the shared batch, bound to at most one request at a time
+struct SchedulerSlot {
+    llama_seq_id seq_id = 0;
+    std::shared_ptr<SchedulerRequest> request;
+    size_t n_prefilled = 0;     // prompt tokens already decoded
+    llama_pos n_past = 0;       // next position in this sequence
+    llama_token last_token = 0; // sampled token waiting to be decoded
+    int n_generated = 0;
+    int32_t i_batch = -1;       // index of this slot's logits in the current batch
+    int32_t n_batched = 0;      // tokens this slot added to the current batch
+    bool batched_prompt = false; // whether those were prompt tokens rather than last_token
+    std::vector<llama_token> cached; // tokens whose KV is held in this slot's sequence
+};
+
+// Continuous batching scheduler: a native thread that owns the llama_context and
+// decodes the next token of every active sequence in one shared llama_batch.
+// Requests join free slots and finished ones leave between decode steps.
+// Queued requests are admitted by priority class, then by fair share between tenants,
+// then by deadline. A request that finds no free slot preempts the least urgent
+// sequence of a lower class, which is requeued with its token history to resume later.
+// All slots share one unified KV cache: a request is admitted only once its prompt fits
+// in the cells left, and when the cache fills up mid-generation the longest sequence is
+// requeued to free its cells instead of failing the whole batch.
+struct Scheduler {
+    LlamaContext* owner;
+    std::vector<SchedulerSlot> slots;
+    llama_batch& batch;  // the owning context's batch buffer
+    int32_t n_batch;
+    
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<SchedulerRequest>> queue;  // in submission order; see next_request
+    bool stopping = false;
+    std::thread worker;
+    std::mutex stop_mutex;  // serializes concurrent stop() calls
+    
+    Scheduler(LlamaContext* owner, int n_slots);
+    ~Scheduler();
+    
+    void submit(const std::shared_ptr<SchedulerRequest>& request);
+    void stop();
+    void run();
+    
+private:
+    // Decoded tokens charged to each tenant with active sequences
+    std::unordered_map<std::string, uint64_t> tenant_usage;
+    
+    bool has_active_slots() const;
+    int kv_cells_used() const;
+    uint64_t usage_floor() const;
+    void expire_queued();
+    std::deque<std::shared_ptr<SchedulerRequest>>::iterator next_request();
+    void requeue(SchedulerSlot& slot);
+    bool preempt(int priority);
+    bool preempt_longest();
+    SchedulerSlot* free_slot(const SchedulerRequest& request);
+    bool fits(const SchedulerRequest& request, const SchedulerSlot& slot, int n_ctx) const;
+    void admit(const std::shared_ptr<SchedulerRequest>& request, SchedulerSlot& slot);
+    bool evict_idle_caches();
+    void rollback_batch();
+    void finish(SchedulerSlot& slot, const std::string& error);
+};
+
+// Create a CPU threadpool pinned to mask through the CPU backend's registry, so the
+// library keeps working when ggml's CPU backend is loaded dynamically
+ggml_threadpool_t create_threadpool(int n_threads, const std::vector<bool>& mask, bool strict_cpu) {
+    ggml_backend_dev_t cpu_dev = ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU);
+    if (cpu_dev == nullptr) {
+        return nullptr;
+    }
+    auto threadpool_new = reinterpret_cast<ggml_threadpool_t (*)(struct ggml_threadpool_params*)>(
+        ggml_backend_reg_get_proc_address(ggml_backend_dev_backend_reg(cpu_dev), "ggml_threadpool_new"));
+    if (threadpool_new == nullptr) {
+        return nullptr;
+    }
+    
+    struct ggml_threadpool_params tpp = ggml_threadpool_params_default(n_threads);
+    for (size_t cpu = 0; cpu < mask.size() && cpu < GGML_MAX_N_THREADS; cpu++) {
+        tpp.cpumask[cpu] = mask[cpu];
+    }
+    tpp.strict_cpu = strict_cpu;
+    return threadpool_new(&tpp);
+}
+
+void free_threadpool(ggml_threadpool_t threadpool) {
+    if (threadpool == nullptr) {
+        return;
+    }
+    ggml_backend_dev_t cpu_dev = ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU);
+    auto threadpool_free = cpu_dev == nullptr ? nullptr : reinterpret_cast<void (*)(ggml_threadpool_t)>(
+        ggml_backend_reg_get_proc_address(ggml_backend_dev_backend_reg(cpu_dev), "ggml_threadpool_free"));
+    if (threadpool_free != nullptr) {
+        threadpool_free(threadpool);
+    }
+}
 
 // Structure to hold llama context and associated data
 struct LlamaContext {
+    std::shared_ptr<LlamaModel> weights;
     llama_model* model;
     llama_context* context;
-    std::vector<llama_token> tokens;
+    llama_context_params params;
+    std::vector<llama_token> tokens;  // tokens whose KV is cached in sequence 0
+    llama_batch batch;                // reusable batch sized to n_batch
+    Detokenizer detokenizer;          // reused across requests, keeping its buffers
+    
+    // KV occupancy published by publish_kv_usage and the scheduler after each step, so the
+    // metrics and resource snapshots never read the llama_context or take the exec lock
+    std::atomic<int> kv_cells_used{0};
+    std::atomic<int> kv_cells_total{0};
+    std::atomic<int> draft_cells_used{0};
+    
+    // nativeGetModelInfo reads these without the exec lock: facts about the weights and
+    // context fixed at creation, and the counts that change with the context under it
+    std::vector<jlong> info_numbers;
+    std::vector<std::string> info_strings;
+    std::atomic<int> n_seq_max{1};
+    std::atomic<int> n_adapters{0};
     std::mt19937 rng;
+    std::mutex rng_mutex;
+    std::unique_ptr<Scheduler> scheduler;
+    SessionCache sessions;
+    
+    // Speculative decoding: draft context on the model's draft weights, mirroring sequence 0
+    llama_context* draft_context = nullptr;
+    std::vector<llama_token> draft_cached;  // tokens whose KV is cached in the draft context
+    int n_draft = 0;                        // tokens proposed per verification step
     
-    LlamaContext() : model(nullptr), context(nullptr), rng(std::random_device{}()) {}
+    // Sliding window: when sequence 0 fills the context, drop the oldest tokens after
+    // the pinned n_keep prefix and shift the remaining KV cells down instead of stopping
+    bool context_shift = false;
+    int n_keep = 0;
+    
+    // Memory reserved against the process budget: the KV caches up front, then the
+    // compute and output buffers llama.cpp reported while creating the contexts
+    BudgetReservation reservation;
+    std::atomic<uint64_t> kv_bytes{0};       // KV cache of the target and draft contexts
+    uint64_t kv_cell_bytes = 0;              // K and V of one token across the target's layers
+    uint64_t draft_kv_cell_bytes = 0;
+    std::atomic<uint64_t> compute_bytes{0};  // compute and output buffers of both contexts
+    uint64_t draft_compute_bytes = 0;
+    
+    // LoRA adapters applied to context with their scales, reapplied when it is recreated
+    std::vector<std::pair<llama_adapter_lora*, float>> adapters;
+    
+    // CPU-pinned threadpools from ContextOptions.cpuMask; null when llama.cpp manages threads
+    ggml_threadpool_t threadpool = nullptr;
+    ggml_threadpool_t threadpool_batch = nullptr;  // null when batch and decode share a pool
+    
+    // Serializes everything that touches the llama_context directly: single-sequence
+    // generation, session state and the scheduler lifecycle. Requests routed through a
+    // running scheduler hold it shared, so they still batch concurrently.
+    std::shared_mutex exec_mutex;
+    
+    LlamaContext() : model(nullptr), context(nullptr), params(llama_context_default_params()), batch(), rng(std::random_device{}()) {}
     
     ~LlamaContext() {
         cleanup();
     }
     
-    void cleanup() {
-        if (context != nullptr) {
-            llama_free(context);
-            context = nullptr;
+    void cleanup() {
+        // The scheduler thread decodes on the context, so stop it first
+        scheduler.reset();
+        if (draft_context != nullptr) {
+            llama_free(draft_context);
+            draft_context = nullptr;
+        }
+        draft_cached.clear();
+        if (context != nullptr) {
+            llama_free(context);
+            context = nullptr;
+        }
+        if (batch.token != nullptr) {
+            llama_batch_free(batch);
+            batch = llama_batch();
+        }
+        // Threadpools outlive every context they were attached to
+        free_threadpool(threadpool_batch);
+        free_threadpool(threadpool);
+        threadpool = nullptr;
+        threadpool_batch = nullptr;
+        // Drop this context's reference; the weights are freed with the last one
+        weights.reset();
+        model = nullptr;
+        tokens.clear();
+        sessions.entries.clear();
+        sessions.index.clear();
+        sessions.used_bytes = 0;
+        reservation.release();
+        kv_bytes = 0;
+        compute_bytes = 0;
+        draft_compute_bytes = 0;
+    }
+};
+
+// Global handle management with thread safety. Lookups take a shared lock and pin the
+// entry, so a concurrent nativeCleanup only drops the table's reference and the context
+// is destroyed once the last in-flight call on it returns.
+static std::unordered_map<jlong, std::shared_ptr<LlamaContext>> g_contexts;
+static std::unordered_map<jlong, std::shared_ptr<LlamaModel>> g_models;
+static std::shared_mutex g_contexts_mutex;
+static jlong g_next_handle = 1;
+static bool g_backend_initialized = false;
+static bool g_numa_initialized = false;
+static std::mutex g_init_mutex;
+
+// JVM and CompletableFuture members cached in JNI_OnLoad for native worker threads
+static JavaVM* g_jvm = nullptr;
+static jclass g_runtime_exception_class = nullptr;
+static jmethodID g_runtime_exception_init = nullptr;
+static jmethodID g_future_complete = nullptr;
+static jmethodID g_future_complete_exceptionally = nullptr;
+static jmethodID g_future_is_done = nullptr;
+
+// Helper function to convert jstring to UTF-8 std::string with proper error handling.
+// Reads the UTF-16 contents directly so characters outside the BMP (emoji, rare CJK)
+// come out as standard 4-byte UTF-8 rather than JNI's modified UTF-8 surrogates.
+std::string jstring_to_string(JNIEnv* env, jstring jstr) {
+    if (jstr == nullptr) return "";
+    JniMarshalTimer timer;
+    
+    const jsize length = env->GetStringLength(jstr);
+    const jchar* chars = env->GetStringCritical(jstr, nullptr);
+    if (chars == nullptr) return "";
+    
+    std::string result;
+    result.reserve(length);
+    for (jsize i = 0; i < length; i++) {
+        uint32_t cp = chars[i];
+        if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < length && chars[i + 1] >= 0xDC00 && chars[i + 1] <= 0xDFFF) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (chars[++i] - 0xDC00);
+        } else if (cp >= 0xD800 && cp <= 0xDFFF) {
+            cp = 0xFFFD;  // Unpaired surrogate
+        }
+        
+        if (cp < 0x80) {
+            result += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            result += static_cast<char>(0xC0 | (cp >> 6));
+            result += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            result += static_cast<char>(0xE0 | (cp >> 12));
+            result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            result += static_cast<char>(0xF0 | (cp >> 18));
+            result += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            result += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            result += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+    
+    env->ReleaseStringCritical(jstr, chars);
+    return result;
+}
+
+// Helper function to convert UTF-8 text to jstring with error handling.
+// Decodes to UTF-16 so 4-byte sequences become surrogate pairs instead of
+// being rejected by NewStringUTF; invalid bytes become U+FFFD.
+jstring string_to_jstring(JNIEnv* env, std::string_view str) {
+    if (env == nullptr) return nullptr;
+    JniMarshalTimer timer;
+    
+    std::u16string utf16;
+    utf16.reserve(str.size());
+    
+    size_t i = 0;
+    while (i < str.size()) {
+        const unsigned char c = static_cast<unsigned char>(str[i]);
+        uint32_t cp = 0xFFFD;
+        size_t extra = 0;
+        if (c < 0x80) {
+            cp = c;
+        } else if ((c & 0xE0) == 0xC0) {
+            cp = c & 0x1F;
+            extra = 1;
+        } else if ((c & 0xF0) == 0xE0) {
+            cp = c & 0x0F;
+            extra = 2;
+        } else if ((c & 0xF8) == 0xF0) {
+            cp = c & 0x07;
+            extra = 3;
+        }
+        
+        // A stray continuation byte or an invalid lead byte has no sequence length
+        bool valid = c < 0x80 || extra > 0;
+        for (size_t k = 1; valid && k <= extra; k++) {
+            if (i + k >= str.size() || (static_cast<unsigned char>(str[i + k]) & 0xC0) != 0x80) {
+                valid = false;
+            } else {
+                cp = (cp << 6) | (static_cast<unsigned char>(str[i + k]) & 0x3F);
+            }
+        }
+        
+        if (!valid) {
+            utf16 += u'\uFFFD';
+            i++;
+            continue;
+        }
+        i += extra + 1;
+        
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            utf16 += static_cast<char16_t>(0xD800 + (cp >> 10));
+            utf16 += static_cast<char16_t>(0xDC00 + (cp & 0x3FF));
+        } else {
+            utf16 += static_cast<char16_t>(cp);
+        }
+    }
+    
+    return env->NewString(reinterpret_cast<const jchar*>(utf16.data()), static_cast<jsize>(utf16.size()));
+}
+
+// Helper function to raise a RuntimeException carrying an error message.
+// Returns nullptr so JNI functions can `return throw_runtime_exception(...)`.
+jstring throw_runtime_exception(JNIEnv* env, std::string_view message) {
+    if (env == nullptr || g_runtime_exception_class == nullptr) return nullptr;
+    jobject exception = env->NewObject(g_runtime_exception_class, g_runtime_exception_init, string_to_jstring(env, message));
+    if (exception != nullptr) {
+        env->Throw(static_cast<jthrowable>(exception));
+    }
+    return nullptr;
+}
+
+// Look up a field of a Kotlin options object, or nullptr when the object is null
+// or has no such field
+jfieldID find_field(JNIEnv* env, jobject obj, const char* name, const char* signature) {
+    if (env == nullptr || obj == nullptr) return nullptr;
+    
+    jclass cls = env->GetObjectClass(obj);
+    jfieldID field = env->GetFieldID(cls, name, signature);
+    env->DeleteLocalRef(cls);
+    if (field == nullptr) {
+        env->ExceptionClear();
+    }
+    return field;
+}
+
+// Helper function to read an Int property of a Kotlin options object.
+// Returns fallback when the object is null or has no such field.
+jint get_int_field(JNIEnv* env, jobject obj, const char* name, jint fallback) {
+    jfieldID field = find_field(env, obj, name, "I");
+    return (field != nullptr) ? env->GetIntField(obj, field) : fallback;
+}
+
+jlong get_long_field(JNIEnv* env, jobject obj, const char* name, jlong fallback) {
+    jfieldID field = find_field(env, obj, name, "J");
+    return (field != nullptr) ? env->GetLongField(obj, field) : fallback;
+}
+
+jboolean get_bool_field(JNIEnv* env, jobject obj, const char* name, jboolean fallback) {
+    jfieldID field = find_field(env, obj, name, "Z");
+    return (field != nullptr) ? env->GetBooleanField(obj, field) : fallback;
+}
+
+// Reads a String? property; null and missing fields both read as an empty string
+std::string get_string_field(JNIEnv* env, jobject obj, const char* name) {
+    jfieldID field = find_field(env, obj, name, "Ljava/lang/String;");
+    if (field == nullptr) {
+        return "";
+    }
+    jstring value = static_cast<jstring>(env->GetObjectField(obj, field));
+    std::string result = jstring_to_string(env, value);
+    env->DeleteLocalRef(value);
+    return result;
+}
+
+// Reads a List<String> property into out, skipping null elements; a null or missing list
+// leaves out empty
+void get_string_list_field(JNIEnv* env, jobject obj, const char* name, std::vector<std::string>& out) {
+    out.clear();
+    jfieldID field = find_field(env, obj, name, "Ljava/util/List;");
+    if (field == nullptr) {
+        return;
+    }
+    jobject list = env->GetObjectField(obj, field);
+    if (list == nullptr) {
+        return;
+    }
+    
+    jclass list_class = env->FindClass("java/util/List");
+    jmethodID size_method = env->GetMethodID(list_class, "size", "()I");
+    jmethodID get_method = env->GetMethodID(list_class, "get", "(I)Ljava/lang/Object;");
+    env->DeleteLocalRef(list_class);
+    
+    const jint size = env->CallIntMethod(list, size_method);
+    for (jint i = 0; i < size; i++) {
+        jstring item = static_cast<jstring>(env->CallObjectMethod(list, get_method, i));
+        if (item != nullptr) {
+            out.push_back(jstring_to_string(env, item));
+            env->DeleteLocalRef(item);
+        }
+    }
+    env->DeleteLocalRef(list);
+}
+
+// Reads the nativeValue of an enum property such as ModelLoadOptions.splitMode
+jint get_enum_field(JNIEnv* env, jobject obj, const char* name, const char* signature, jint fallback) {
+    jfieldID field = find_field(env, obj, name, signature);
+    if (field == nullptr) {
+        return fallback;
+    }
+    jobject value = env->GetObjectField(obj, field);
+    jint result = get_int_field(env, value, "nativeValue", fallback);
+    env->DeleteLocalRef(value);
+    return result;
+}
+
+// Reads a FloatArray? property into out; returns false when it is null or missing
+bool get_float_array_field(JNIEnv* env, jobject obj, const char* name, std::vector<float>& out) {
+    jfieldID field = find_field(env, obj, name, "[F");
+    if (field == nullptr) {
+        return false;
+    }
+    jfloatArray value = static_cast<jfloatArray>(env->GetObjectField(obj, field));
+    if (value == nullptr) {
+        return false;
+    }
+    out.resize(env->GetArrayLength(value));
+    env->GetFloatArrayRegion(value, 0, static_cast<jsize>(out.size()), out.data());
+    env->DeleteLocalRef(value);
+    return true;
+}
+
+// Parse a CPU list such as "0-7,16,18-19" into a mask. Returns false on malformed input.
+bool parse_cpu_list(const std::string& list, std::vector<bool>& mask) {
+    mask.assign(GGML_MAX_N_THREADS, false);
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        const std::string item = list.substr(pos, end - pos);
+        pos = end + 1;
+        
+        int first = 0;
+        int last = 0;
+        char extra = 0;
+        if (std::sscanf(item.c_str(), "%d-%d%c", &first, &last, &extra) != 2) {
+            if (std::sscanf(item.c_str(), "%d%c", &first, &extra) != 1) {
+                return false;
+            }
+            last = first;
+        }
+        if (first < 0 || last < first || last >= GGML_MAX_N_THREADS) {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            mask[cpu] = true;
+        }
+    }
+    return std::find(mask.begin(), mask.end(), true) != mask.end();
+}
+
+// One CPU per physical core (the first SMT sibling), restricted to allowed when it is set.
+// Reads the Linux sysfs topology; returns an empty list where that is unavailable.
+std::vector<int> physical_core_cpus(const std::vector<bool>& allowed) {
+    std::vector<int> cpus;
+    std::set<std::string> seen_cores;
+    for (int cpu = 0; cpu < GGML_MAX_N_THREADS; cpu++) {
+        std::ifstream siblings("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+        if (!siblings) {
+            continue;
+        }
+        std::string core;
+        std::getline(siblings, core);
+        if (!allowed.empty() && !allowed[cpu]) {
+            continue;
+        }
+        if (seen_cores.insert(core).second) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Directory holding this library, where build.sh also installs the ggml backends
+std::string library_directory() {
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(&library_directory), &info) == 0 || info.dli_fname == nullptr) {
+        return "";
+    }
+    const std::string path = info.dli_fname;
+    const size_t slash = path.find_last_of('/');
+    return (slash == std::string::npos) ? "" : path.substr(0, slash);
+}
+
+// Buffer sizes llama.cpp logs while creating a context, collected on the creating thread.
+// llama.cpp's public API does not expose the size of a context's compute buffers, and free
+// device memory measured around the allocation is unreliable for host memory, so the sizes
+// are parsed from the lines llama_init_from_model logs. llama_jni_bench fails if a llama.cpp
+// upgrade stops logging them, since every context would then be rejected under a budget.
+struct BufferLog {
+    uint64_t compute_bytes = 0;  // compute and output buffers across backends
+    int n_compute = 0;           // compute buffer lines parsed
+};
+
+// Points at the BufferLog of the context being created on this thread; llama.cpp logs
+// from the creating thread, so concurrent creations each see only their own lines
+thread_local BufferLog* t_buffer_log = nullptr;
+
+// Logger installed before ours, which every line is forwarded to
+static ggml_log_callback g_prev_log_callback = nullptr;
+static void* g_prev_log_user_data = nullptr;
+
+// Forwards to the previous logger, adding lines such as
+// "llama_context:        CPU compute buffer size =   298.50 MiB" to the active BufferLog
+void log_callback(enum ggml_log_level level, const char* text, void* user_data) {
+    if (t_buffer_log != nullptr) {
+        const char* size = std::strstr(text, "compute buffer size =");
+        const bool compute = size != nullptr;
+        if (size == nullptr) {
+            size = std::strstr(text, "output buffer size =");
+        }
+        double mib = 0.0;
+        if (size != nullptr && std::sscanf(std::strchr(size, '=') + 1, "%lf MiB", &mib) == 1) {
+            t_buffer_log->compute_bytes += static_cast<uint64_t>(mib * 1024.0 * 1024.0);
+            t_buffer_log->n_compute += compute ? 1 : 0;
+        }
+    }
+    if (g_prev_log_callback != nullptr) {
+        g_prev_log_callback(level, text, g_prev_log_user_data);
+    } else {
+        std::fputs(text, stderr);
+        std::fflush(stderr);
+    }
+}
+
+// Create a llama_context, adding the buffer sizes it reports to log. Under a memory
+// budget a context whose compute buffers could not be measured is rejected, rather than
+// admitted as if they took no memory.
+llama_context* init_context_logged(llama_model* model, const llama_context_params& params, BufferLog& log) {
+    t_buffer_log = &log;
+    llama_context* context = llama_init_from_model(model, params);
+    t_buffer_log = nullptr;
+    
+    bool limited = false;
+    {
+        std::lock_guard<std::mutex> lock(g_budget.mutex);
+        limited = g_budget.limit > 0;
+    }
+    if (context != nullptr && log.n_compute == 0 && limited) {
+        std::cerr << "Memory budget: llama.cpp did not report the compute buffer size, context rejected" << std::endl;
+        llama_free(context);
+        return nullptr;
+    }
+    return context;
+}
+
+// Integer GGUF metadata value, or fallback when absent
+int64_t model_meta_int(const llama_model* model, const char* key, int64_t fallback) {
+    char value[64];
+    if (llama_model_meta_val_str(model, key, value, sizeof(value)) < 0) {
+        return fallback;
+    }
+    return std::strtoll(value, nullptr, 10);
+}
+
+// Integer GGUF metadata value <architecture>.<key>, or fallback when absent
+int64_t model_arch_int(const llama_model* model, const char* key, int64_t fallback) {
+    char arch[64];
+    if (llama_model_meta_val_str(model, "general.architecture", arch, sizeof(arch)) < 0) {
+        return fallback;
+    }
+    return model_meta_int(model, (std::string(arch) + "." + key).c_str(), fallback);
+}
+
+// Name of a llama_ftype ("general.file_type") as used in GGUF file names, e.g. "Q4_K_M"
+const char* ftype_name(int ftype) {
+    switch (ftype) {
+        case LLAMA_FTYPE_ALL_F32:         return "F32";
+        case LLAMA_FTYPE_MOSTLY_F16:      return "F16";
+        case LLAMA_FTYPE_MOSTLY_BF16:     return "BF16";
+        case LLAMA_FTYPE_MOSTLY_Q4_0:     return "Q4_0";
+        case LLAMA_FTYPE_MOSTLY_Q4_1:     return "Q4_1";
+        case LLAMA_FTYPE_MOSTLY_Q5_0:     return "Q5_0";
+        case LLAMA_FTYPE_MOSTLY_Q5_1:     return "Q5_1";
+        case LLAMA_FTYPE_MOSTLY_Q8_0:     return "Q8_0";
+        case LLAMA_FTYPE_MOSTLY_MXFP4_MOE: return "MXFP4_MOE";
+        case LLAMA_FTYPE_MOSTLY_Q2_K:     return "Q2_K";
+        case LLAMA_FTYPE_MOSTLY_Q2_K_S:   return "Q2_K_S";
+        case LLAMA_FTYPE_MOSTLY_Q3_K_S:   return "Q3_K_S";
+        case LLAMA_FTYPE_MOSTLY_Q3_K_M:   return "Q3_K_M";
+        case LLAMA_FTYPE_MOSTLY_Q3_K_L:   return "Q3_K_L";
+        case LLAMA_FTYPE_MOSTLY_Q4_K_S:   return "Q4_K_S";
+        case LLAMA_FTYPE_MOSTLY_Q4_K_M:   return "Q4_K_M";
+        case LLAMA_FTYPE_MOSTLY_Q5_K_S:   return "Q5_K_S";
+        case LLAMA_FTYPE_MOSTLY_Q5_K_M:   return "Q5_K_M";
+        case LLAMA_FTYPE_MOSTLY_Q6_K:     return "Q6_K";
+        case LLAMA_FTYPE_MOSTLY_TQ1_0:    return "TQ1_0";
+        case LLAMA_FTYPE_MOSTLY_TQ2_0:    return "TQ2_0";
+        case LLAMA_FTYPE_MOSTLY_IQ1_S:    return "IQ1_S";
+        case LLAMA_FTYPE_MOSTLY_IQ1_M:    return "IQ1_M";
+        case LLAMA_FTYPE_MOSTLY_IQ2_XXS:  return "IQ2_XXS";
+        case LLAMA_FTYPE_MOSTLY_IQ2_XS:   return "IQ2_XS";
+        case LLAMA_FTYPE_MOSTLY_IQ2_S:    return "IQ2_S";
+        case LLAMA_FTYPE_MOSTLY_IQ2_M:    return "IQ2_M";
+        case LLAMA_FTYPE_MOSTLY_IQ3_XXS:  return "IQ3_XXS";
+        case LLAMA_FTYPE_MOSTLY_IQ3_XS:   return "IQ3_XS";
+        case LLAMA_FTYPE_MOSTLY_IQ3_S:    return "IQ3_S";
+        case LLAMA_FTYPE_MOSTLY_IQ3_M:    return "IQ3_M";
+        case LLAMA_FTYPE_MOSTLY_IQ4_NL:   return "IQ4_NL";
+        case LLAMA_FTYPE_MOSTLY_IQ4_XS:   return "IQ4_XS";
+        default:                          return "unknown";
+    }
+}
+
+// K and V bytes of one KV cell across all layers. Head sizes come from the GGUF metadata
+// since they need not be n_embd / n_head (Qwen3 uses 128-wide heads on a 1024 embedding).
+uint64_t kv_cell_bytes(const llama_model* model, const llama_context_params& params) {
+    const int64_t head_dim = llama_model_n_embd(model) / std::max(1, llama_model_n_head(model));
+    const int64_t n_head_kv = llama_model_n_head_kv(model);
+    const int64_t n_embd_k = n_head_kv * model_arch_int(model, "attention.key_length", head_dim);
+    const int64_t n_embd_v = n_head_kv * model_arch_int(model, "attention.value_length", head_dim);
+    return (ggml_row_size(params.type_k, n_embd_k) + ggml_row_size(params.type_v, n_embd_v)) * llama_model_n_layer(model);
+}
+
+uint64_t file_size(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    return in ? static_cast<uint64_t>(in.tellg()) : 0;
+}
+
+// Initialize llama.cpp once; callers hold g_init_mutex. A GGML_BACKEND_DL build links no
+// backend in, so they are loaded from this library's directory first. ggml then picks the
+// libggml-cpu variant that scores best on the host's CPU features (AVX2, AVX-512, AMX, SVE...).
+void init_backend_locked() {
+    if (g_backend_initialized) {
+        return;
+    }
+    if (ggml_backend_reg_count() == 0) {
+        const std::string dir = library_directory();
+        if (!dir.empty()) {
+            ggml_backend_load_all_from_path(dir.c_str());
+        }
+        // Fall back to ggml's default search: the executable's directory and the working directory
+        if (ggml_backend_reg_count() == 0) {
+            ggml_backend_load_all();
+        }
+    }
+    llama_backend_init();
+    llama_log_get(&g_prev_log_callback, &g_prev_log_user_data);
+    if (g_prev_log_callback == log_callback) {
+        g_prev_log_callback = nullptr;  // Already installed, e.g. after a backend reload
+    }
+    llama_log_set(log_callback, nullptr);
+    g_backend_initialized = true;
+}
+
+// Helper function to get context by handle with thread safety
+std::shared_ptr<LlamaContext> get_context(jlong handle) {
+    std::shared_lock<std::shared_mutex> lock(g_contexts_mutex);
+    auto it = g_contexts.find(handle);
+    return (it != g_contexts.end()) ? it->second : nullptr;
+}
+
+// Whether a context from get_context is usable. ctx->context is swapped by ensure_seq_capacity
+// under the exclusive exec lock, so checks made without it read the published cell count
+bool context_ready(const LlamaContext* ctx) {
+    return ctx != nullptr && ctx->model != nullptr && ctx->kv_cells_total.load(std::memory_order_relaxed) > 0;
+}
+
+// Helper function to get model weights by handle with thread safety
+std::shared_ptr<LlamaModel> get_model(jlong handle) {
+    std::shared_lock<std::shared_mutex> lock(g_contexts_mutex);
+    auto it = g_models.find(handle);
+    return (it != g_models.end()) ? it->second : nullptr;
+}
+
+// Load a LoRA adapter onto weights and register it under a new handle; 0 on failure
+jlong load_adapter(LlamaModel& weights, const std::string& path) {
+    // Held throughout: it also guards the weights' reservation
+    std::lock_guard<std::mutex> adapters_lock(weights.adapters_mutex);
+    const uint64_t bytes = file_size(path);
+    if (!weights.reservation.grow(bytes)) {
+        std::cerr << "Memory budget exceeded: adapter " << path << " needs " << bytes << " bytes" << std::endl;
+        return 0;
+    }
+    llama_adapter_lora* adapter = llama_adapter_lora_init(weights.model, path.c_str());
+    if (adapter == nullptr) {
+        weights.reservation.bytes -= bytes;
+        budget_release(bytes);
+        return 0;
+    }
+    
+    jlong handle = 0;
+    {
+        std::lock_guard<std::shared_mutex> lock(g_contexts_mutex);
+        handle = g_next_handle++;
+    }
+    weights.adapters[handle] = adapter;
+    return handle;
+}
+
+// Draw a per-request seed from the context's generator
+uint32_t next_seed(LlamaContext* ctx) {
+    std::lock_guard<std::mutex> lock(ctx->rng_mutex);
+    return static_cast<uint32_t>(ctx->rng());
+}
+
+// Resolve JNI generation arguments, applying defaults and drawing the request's seed.
+// constraints is a GenerationConstraints? read by field name.
+GenerationParams make_generation_params(JNIEnv* env, LlamaContext* ctx, jint maxTokens, jfloat temperature, jfloat topP, jint topK,
+                                        jobject constraints) {
+    GenerationParams params;
+    params.max_tokens = (maxTokens > 0) ? maxTokens : 256;  // Default
+    params.temperature = temperature;
+    params.top_p = topP;
+    params.top_k = topK;
+    params.seed = next_seed(ctx);
+    if (constraints != nullptr) {
+        get_string_list_field(env, constraints, "stop", params.stop);
+        params.grammar = get_string_field(env, constraints, "grammar");
+        const std::string root = get_string_field(env, constraints, "grammarRoot");
+        if (!root.empty()) {
+            params.grammar_root = root;
+        }
+        params.priority = get_enum_field(env, constraints, "priority", "Lcom/traycer/llama/RequestPriority;", params.priority);
+        params.deadline_ms = get_long_field(env, constraints, "deadlineMs", 0);
+        params.tenant = get_string_field(env, constraints, "tenant");
+    }
+    return params;
+}
+
+// Callback receiving each decoded chunk of text; returning false stops generation early
+using PieceCallback = std::function<bool(std::string_view piece)>;
+
+// Append a single token to a batch
+void batch_add(llama_batch& batch, llama_token token, llama_pos pos, llama_seq_id seq_id, bool logits) {
+    const int32_t i = batch.n_tokens;
+    batch.token[i] = token;
+    batch.pos[i] = pos;
+    batch.n_seq_id[i] = 1;
+    batch.seq_id[i][0] = seq_id;
+    batch.logits[i] = logits;
+    batch.n_tokens++;
+}
+
+// llama_decode on a target model context, recorded in the process metrics and the trace:
+// step latency, tokens and how full the batch was relative to the context's n_batch
+int decode_traced(llama_context* context, const llama_batch& batch) {
+    const Clock::time_point start = Clock::now();
+    const int result = llama_decode(context, batch);
+    const Clock::time_point end = Clock::now();
+    
+    g_metrics.decode_calls.fetch_add(1, std::memory_order_relaxed);
+    g_metrics.decode_tokens.fetch_add(batch.n_tokens, std::memory_order_relaxed);
+    if (result != 0) {
+        g_metrics.decode_failures.fetch_add(1, std::memory_order_relaxed);
+    }
+    g_metrics.decode_us.record(elapsed_us(start, end));
+    g_metrics.batch_fill_pct.record(static_cast<uint64_t>(batch.n_tokens) * 100 / std::max<uint32_t>(1, llama_n_batch(context)));
+    trace_event("llama_decode", 'X', start, end, "tokens", batch.n_tokens, "result", result);
+    return result;
+}
+
+// llama_decode on a draft model context: latency goes to its own histogram so speculative
+// decoding does not skew the target model's decode counters, latency and batch fill
+int decode_draft_traced(llama_context* context, const llama_batch& batch) {
+    const Clock::time_point start = Clock::now();
+    const int result = llama_decode(context, batch);
+    const Clock::time_point end = Clock::now();
+    
+    g_metrics.draft_decode_us.record(elapsed_us(start, end));
+    trace_event("llama_decode_draft", 'X', start, end, "tokens", batch.n_tokens, "result", result);
+    return result;
+}
+
+// Tokenize the whole text into out (with BOS). Callers enforce their own length limits.
+// Returns false if tokenization fails.
+bool tokenize_text(const llama_vocab* vocab, std::string_view text, std::vector<llama_token>& out, bool add_bos = true) {
+    // Rarely more tokens than bytes plus BOS/EOS; on a short buffer llama_tokenize returns -needed
+    int n_tokens = 0;
+    for (int capacity = static_cast<int>(text.length()) + 2; ; capacity = -n_tokens) {
+        out.resize(capacity);
+        n_tokens = llama_tokenize(
+            vocab,
+            text.data(),
+            static_cast<int32_t>(text.length()),
+            out.data(),
+            capacity,
+            add_bos,  // beginning of sequence
+            false  // special tokens
+        );
+        if (n_tokens >= 0 || -n_tokens <= capacity) {
+            break;
+        }
+    }
+    
+    if (n_tokens < 0) {
+        out.clear();
+        return false;
+    }
+    
+    out.resize(n_tokens);
+    return true;
+}
+
+// Prompt of a generation: UTF-8 text tokenized natively, or token IDs the caller
+// tokenized earlier, e.g. a cached template
+struct PromptInput {
+    std::string_view text;
+    const std::vector<llama_token>* tokens = nullptr;
+    
+    PromptInput(std::string_view text) : text(text) {}
+    PromptInput(const std::string& text) : text(text) {}
+    PromptInput(const std::vector<llama_token>& tokens) : tokens(&tokens) {}
+};
+
+// Resolve a prompt into token IDs, rejecting IDs outside the vocabulary
+bool resolve_prompt(const llama_vocab* vocab, const PromptInput& input, std::vector<llama_token>& out) {
+    if (input.tokens == nullptr) {
+        return tokenize_text(vocab, input.text, out);
+    }
+    
+    const llama_token n_vocab = llama_vocab_n_tokens(vocab);
+    for (llama_token token : *input.tokens) {
+        if (token < 0 || token >= n_vocab) {
+            out.clear();
+            return false;
+        }
+    }
+    out.assign(input.tokens->begin(), input.tokens->end());
+    return true;
+}
+
+// Number of leading tokens two sequences have in common
+size_t common_prefix_len(const std::vector<llama_token>& a, const std::vector<llama_token>& b) {
+    size_t n = 0;
+    const size_t limit = std::min(a.size(), b.size());
+    while (n < limit && a[n] == b[n]) {
+        n++;
+    }
+    return n;
+}
+
+// Trim a sequence's KV cache to the prefix it shares with the next prompt.
+// cached holds the tokens currently in the cache for seq_id. At least one prompt
+// token is always left to decode so the prompt produces logits. Falls back to
+// clearing the sequence if the memory cannot remove a partial range.
+// Returns the number of prompt tokens whose KV is reused.
+size_t reuse_cached_prefix(llama_memory_t memory, llama_seq_id seq_id, const std::vector<llama_token>& cached, const std::vector<llama_token>& prompt) {
+    size_t n_reused = common_prefix_len(cached, prompt);
+    if (n_reused >= prompt.size()) {
+        n_reused = prompt.empty() ? 0 : prompt.size() - 1;
+    }
+    
+    if (!llama_memory_seq_rm(memory, seq_id, n_reused, -1)) {
+        llama_memory_seq_rm(memory, seq_id, -1, -1);
+        n_reused = 0;
+    }
+    return n_reused;
+}
+
+// Publish the cells cached in sequence 0 of the target and draft contexts. Called by the
+// exec lock holder whenever tokens or draft_cached change length.
+void publish_kv_usage(LlamaContext* ctx) {
+    ctx->kv_cells_used.store(static_cast<int>(ctx->tokens.size()), std::memory_order_relaxed);
+    ctx->draft_cells_used.store(static_cast<int>(ctx->draft_cached.size()), std::memory_order_relaxed);
+}
+
+// Forget the cached prompt after a failed decode left the KV cache in an unknown state
+void invalidate_cache(LlamaContext* ctx) {
+    ctx->tokens.clear();
+    llama_memory_clear(llama_get_memory(ctx->context), true);
+    if (ctx->draft_context != nullptr) {
+        ctx->draft_cached.clear();
+        llama_memory_clear(llama_get_memory(ctx->draft_context), true);
+    }
+    publish_kv_usage(ctx);
+}
+
+// Make room for n_needed more tokens in sequence 0. With context shifting, the older half
+// of the tokens after the pinned prefix is discarded and later KV cells are shifted down,
+// keeping positions contiguous. Returns the number of tokens discarded, or -1 when the
+// window is full and cannot shift.
+int shift_context(LlamaContext* ctx, int n_needed) {
+    const int n_ctx = static_cast<int>(llama_n_ctx(ctx->context));
+    const int n_past = static_cast<int>(ctx->tokens.size());
+    if (n_past + n_needed <= n_ctx) {
+        return 0;
+    }
+    
+    llama_memory_t memory = llama_get_memory(ctx->context);
+    if (!ctx->context_shift || !llama_memory_can_shift(memory)) {
+        return -1;
+    }
+    
+    const int n_keep = std::min(ctx->n_keep, n_past);
+    const int n_left = n_past - n_keep;
+    const int n_discard = std::max(n_left / 2, n_past + n_needed - n_ctx);
+    if (n_discard <= 0 || n_discard > n_left) {
+        return -1;
+    }
+    
+    llama_memory_seq_rm(memory, 0, n_keep, n_keep + n_discard);
+    llama_memory_seq_add(memory, 0, n_keep + n_discard, n_past, -n_discard);
+    ctx->tokens.erase(ctx->tokens.begin() + n_keep, ctx->tokens.begin() + n_keep + n_discard);
+    
+    // Apply the same window to the draft so it keeps mirroring the target's tokens
+    if (ctx->draft_context != nullptr && static_cast<int>(ctx->draft_cached.size()) > n_keep) {
+        llama_memory_t draft_memory = llama_get_memory(ctx->draft_context);
+        if (llama_memory_can_shift(draft_memory)) {
+            const int n_draft_past = static_cast<int>(ctx->draft_cached.size());
+            const int n_draft_discard = std::min(n_discard, n_draft_past - n_keep);
+            llama_memory_seq_rm(draft_memory, 0, n_keep, n_keep + n_draft_discard);
+            llama_memory_seq_add(draft_memory, 0, n_keep + n_draft_discard, n_draft_past, -n_draft_discard);
+            ctx->draft_cached.erase(ctx->draft_cached.begin() + n_keep, ctx->draft_cached.begin() + n_keep + n_draft_discard);
+        } else {
+            ctx->draft_cached.clear();
+            llama_memory_clear(draft_memory, true);
+        }
+    }
+    return n_discard;
+}
+
+// Decode a throwaway BOS/EOS batch so the first real request does not pay for compute
+// buffer allocation and first-touch of the weights, then drop its KV and perf counters
+bool warmup_decode(llama_context* context, llama_batch& batch, uint32_t n_batch) {
+    const llama_vocab* vocab = llama_model_get_vocab(llama_get_model(context));
+    std::vector<llama_token> tokens;
+    if (llama_vocab_bos(vocab) != LLAMA_TOKEN_NULL) {
+        tokens.push_back(llama_vocab_bos(vocab));
+    }
+    if (llama_vocab_eos(vocab) != LLAMA_TOKEN_NULL) {
+        tokens.push_back(llama_vocab_eos(vocab));
+    }
+    if (tokens.empty()) {
+        tokens.push_back(0);
+    }
+    tokens.resize(std::min<size_t>(tokens.size(), n_batch));
+    
+    batch.n_tokens = 0;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        batch_add(batch, tokens[i], static_cast<llama_pos>(i), 0, i + 1 == tokens.size());
+    }
+    const bool ok = llama_decode(context, batch) == 0;
+    llama_synchronize(context);
+    
+    llama_memory_clear(llama_get_memory(context), true);
+    llama_perf_context_reset(context);
+    return ok;
+}
+
+// Read a file end to end so its pages sit in the page cache, turning the major faults
+// a cold mmap would take during the first decode into minor ones
+bool prefault_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::vector<char> chunk(4 * 1024 * 1024);
+    while (in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()))) {
+        // Only the page cache side effect matters
+    }
+    return in.eof() && !in.bad();
+}
+
+// Catch the draft context up with the target's cached tokens plus the pending token,
+// then greedily propose up to n_draft tokens. Returns fewer on a draft decode failure.
+std::vector<llama_token> draft_tokens(LlamaContext* ctx, llama_token pending, int n_draft) {
+    std::vector<llama_token> drafted;
+    llama_context* dctx = ctx->draft_context;
+    llama_memory_t memory = llama_get_memory(dctx);
+    llama_batch& batch = ctx->batch;
+    const int n_batch = static_cast<int>(llama_n_batch(dctx));
+    const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(llama_get_model(dctx)));
+    
+    std::vector<llama_token> history = ctx->tokens;
+    history.push_back(pending);
+    const size_t n_reused = reuse_cached_prefix(memory, 0, ctx->draft_cached, history);
+    ctx->draft_cached.resize(n_reused);
+    
+    for (size_t start = n_reused; start < history.size(); start += n_batch) {
+        const size_t end = std::min(start + n_batch, history.size());
+        batch.n_tokens = 0;
+        for (size_t i = start; i < end; i++) {
+            batch_add(batch, history[i], static_cast<llama_pos>(i), 0, i == history.size() - 1);
+        }
+        if (decode_draft_traced(dctx, batch) != 0) {
+            ctx->draft_cached.clear();
+            llama_memory_clear(memory, true);
+            return drafted;
+        }
+        ctx->draft_cached.insert(ctx->draft_cached.end(), history.begin() + start, history.begin() + end);
+    }
+    
+    while (static_cast<int>(drafted.size()) < n_draft) {
+        llama_token token = argmax_token(llama_get_logits_ith(dctx, batch.n_tokens - 1), n_vocab);
+        drafted.push_back(token);
+        if (static_cast<int>(drafted.size()) == n_draft) {
+            break;
+        }
+        
+        batch.n_tokens = 0;
+        batch_add(batch, token, static_cast<llama_pos>(ctx->draft_cached.size()), 0, true);
+        if (decode_draft_traced(dctx, batch) != 0) {
+            ctx->draft_cached.clear();
+            llama_memory_clear(memory, true);
+            break;
+        }
+        ctx->draft_cached.push_back(token);
+    }
+    return drafted;
+}
+
+// Tokenize, prefill and run the decode loop, forwarding each decoded chunk to on_piece.
+// Shared by the blocking and streaming entry points.
+// Returns an empty string on success or an error message otherwise.
+std::string run_generation(LlamaContext* ctx, const PromptInput& input, const GenerationParams& params, const PieceCallback& on_piece,
+                           GenerationStats* stats) {
+    const Clock::time_point t_start = Clock::now();
+    GenerationStats local_stats;
+    GenerationStats& st = stats ? *stats : local_stats;
+    st = GenerationStats();
+    st.kv_size = static_cast<int>(llama_n_ctx(ctx->context));
+    
+    llama_memory_t memory = llama_get_memory(ctx->context);
+    
+    // Get vocab for tokenization
+    const auto* vocab = llama_model_get_vocab(ctx->model);
+    
+    // Sampler is configured once for the whole request; an invalid grammar is rejected
+    // here, before it can cost a prefill or replace the cached prefix
+    TokenSampler sampler(vocab, params);
+    if (!params.grammar.empty() && sampler.grammar == nullptr) {
+        return "Error: Invalid grammar";
+    }
+    
+    // Tokenize input
+    std::vector<llama_token> prompt_tokens;
+    if (!resolve_prompt(vocab, input, prompt_tokens) || prompt_tokens.empty()) {
+        return (input.tokens != nullptr) ? "Error: Invalid prompt tokens" : "Error: Tokenization failed";
+    }
+    
+    const int n_ctx = static_cast<int>(llama_n_ctx(ctx->context));
+    if (ctx->context_shift) {
+        // Too long for the window: keep the pinned prefix and drop whole blocks after it,
+        // as later context shifts would have
+        const int n_keep = std::min(ctx->n_keep, n_ctx / 2);
+        const int n_prompt = static_cast<int>(prompt_tokens.size());
+        if (n_prompt >= n_ctx) {
+            const int n_block = (n_ctx - n_keep) / 2;
+            const int n_erased = ((n_prompt - n_keep - n_block) / n_block) * n_block;
+            prompt_tokens.erase(prompt_tokens.begin() + n_keep, prompt_tokens.begin() + n_keep + n_erased);
+            st.discarded_tokens += n_erased;
+        }
+    } else if (static_cast<int>(prompt_tokens.size()) > n_ctx / 2) {
+        // Without shifting, half the window stays free for the response
+        return "Error: Prompt too long (" + std::to_string(prompt_tokens.size()) + " tokens, limit " + std::to_string(n_ctx / 2) + ")";
+    }
+    
+    const Clock::time_point t_tokenized = Clock::now();
+    st.tokenize_ms = elapsed_ms(t_start, t_tokenized);
+    
+    const int n_tokens = static_cast<int>(prompt_tokens.size());
+    
+    // Keep the KV cache for the prefix shared with the previous call and drop only the divergent tail
+    const size_t n_reused = reuse_cached_prefix(memory, 0, ctx->tokens, prompt_tokens);
+    ctx->tokens = std::move(prompt_tokens);
+    st.prompt_tokens = n_tokens;
+    st.cached_tokens = static_cast<int>(n_reused);
+    
+    // Prefill only the uncached suffix, in chunks of at most n_batch tokens
+    llama_batch& batch = ctx->batch;
+    const int n_batch = static_cast<int>(llama_n_batch(ctx->context));
+    
+    for (int start = static_cast<int>(n_reused); start < n_tokens; start += n_batch) {
+        const int end = std::min(start + n_batch, n_tokens);
+        
+        batch.n_tokens = 0;
+        for (int i = start; i < end; i++) {
+            // Only the final prompt token needs logits
+            batch_add(batch, ctx->tokens[i], i, 0, i == n_tokens - 1);
+        }
+        
+        if (decode_traced(ctx->context, batch) != 0) {
+            invalidate_cache(ctx);
+            return "Error: Failed to decode prompt";
+        }
+    }
+    publish_kv_usage(ctx);
+    
+    const Clock::time_point t_prefilled = Clock::now();
+    st.prefill_ms = elapsed_ms(t_tokenized, t_prefilled);
+    Clock::time_point t_last_token = t_prefilled;
+    
+    // Bytes of a multi-byte character split across tokens, held until it is complete
+    ctx->detokenizer.reset(vocab, params.stop);
+    bool stopped_by_caller = false;
+    
+    // Calculate maximum generation tokens; a sliding window is bounded only by max_tokens
+    int max_gen_tokens = ctx->context_shift ? params.max_tokens : std::min(params.max_tokens, n_ctx - n_tokens);
+    
+    // Record and forward one sampled token; returns false once generation should stop
+    auto emit = [&](llama_token token) {
+        t_last_token = Clock::now();
+        if (st.ttft_ms == 0) {
+            st.ttft_ms = elapsed_ms(t_start, t_last_token);
+        }
+        
+        // Check for end of sequence
+        if (llama_vocab_is_eog(vocab, token)) {
+            return false;
+        }
+        st.generated_tokens++;
+        
+        // Forward only complete characters, up to a stop string
+        std::string_view chunk = ctx->detokenizer.push(token);
+        if (!chunk.empty() && !on_piece(chunk)) {
+            stopped_by_caller = true;
+            return false;
+        }
+        return !ctx->detokenizer.stopped;
+    };
+    
+    if (ctx->draft_context != nullptr && ctx->n_draft > 0 && max_gen_tokens > 0) {
+        // First token from the prompt logits, then draft-and-verify steps
+        llama_token token = sampler.sample(llama_get_logits_ith(ctx->context, batch.n_tokens - 1));
+        int n_generated = 1;
+        bool keep_going = emit(token);
+        
+        while (keep_going && n_generated < max_gen_tokens) {
+            const int n_draft = std::min(ctx->n_draft, max_gen_tokens - n_generated - 1);
+            const int n_discarded = shift_context(ctx, n_draft + 1);
+            if (n_discarded < 0) {
+                break;
+            }
+            st.discarded_tokens += n_discarded;
+            std::vector<llama_token> drafted = (n_draft > 0) ? draft_tokens(ctx, token, n_draft) : std::vector<llama_token>();
+            
+            // Verify the pending token and every proposal in one target decode
+            const llama_pos n_past = static_cast<llama_pos>(ctx->tokens.size());
+            batch.n_tokens = 0;
+            batch_add(batch, token, n_past, 0, true);
+            for (size_t i = 0; i < drafted.size(); i++) {
+                batch_add(batch, drafted[i], n_past + 1 + static_cast<llama_pos>(i), 0, true);
+            }
+            if (decode_traced(ctx->context, batch) != 0) {
+                invalidate_cache(ctx);
+                break;
+            }
+            ctx->tokens.push_back(token);
+            st.draft_rounds += drafted.empty() ? 0 : 1;
+            st.draft_tokens += static_cast<int>(drafted.size());
+            
+            // Sample from the target at each position and keep drafts while they match.
+            // Every emitted token is the target's own sample, so output is unchanged.
+            for (size_t i = 0; ; i++) {
+                token = sampler.sample(llama_get_logits_ith(ctx->context, static_cast<int32_t>(i)));
+                n_generated++;
+                keep_going = emit(token);
+                if (keep_going && i < drafted.size() && token == drafted[i] && n_generated < max_gen_tokens) {
+                    ctx->tokens.push_back(token);
+                    st.draft_accepted++;
+                    continue;
+                }
+                break;
+            }
+            
+            // Drop the KV of rejected proposals
+            llama_memory_seq_rm(llama_get_memory(ctx->context), 0, static_cast<llama_pos>(ctx->tokens.size()), -1);
+            publish_kv_usage(ctx);
+        }
+    } else {
+        // Generate tokens one by one
+        for (int i = 0; i < max_gen_tokens; i++) {
+            // Get logits for the last token
+            float* logits = llama_get_logits_ith(ctx->context, batch.n_tokens - 1);
+            if (logits == nullptr) {
+                break;
+            }
+            
+            // Sample next token
+            llama_token new_token = sampler.sample(logits);
+            if (!emit(new_token)) {
+                break;
+            }
+            
+            // Slide the window when the context is full
+            const int n_discarded = shift_context(ctx, 1);
+            if (n_discarded < 0) {
+                break;
+            }
+            st.discarded_tokens += n_discarded;
+            
+            // Prepare for next iteration
+            batch.n_tokens = 0;
+            batch_add(batch, new_token, ctx->tokens.size(), 0, true);
+            
+            ctx->tokens.push_back(new_token);
+            
+            // Decode the new token
+            if (decode_traced(ctx->context, batch) != 0) {
+                invalidate_cache(ctx);
+                break;
+            }
+            publish_kv_usage(ctx);
+        }
+    }
+    
+    // A character still split at the end is replaced rather than dropped
+    std::string_view tail = ctx->detokenizer.flush();
+    if (!stopped_by_caller && !tail.empty()) {
+        on_piece(tail);
+    }
+    
+    st.decode_ms = elapsed_ms(t_prefilled, t_last_token);
+    st.kv_used = static_cast<int>(ctx->tokens.size());
+    st.total_ms = elapsed_ms(t_start, Clock::now());
+    return "";
+}
+
+// Apply ctx->adapters to its llama_context, replacing whatever was applied before.
+// Returns false if llama.cpp rejects one.
+bool apply_adapters(LlamaContext* ctx) {
+    llama_clear_adapter_lora(ctx->context);
+    for (const auto& entry : ctx->adapters) {
+        if (llama_set_adapter_lora(ctx->context, entry.first, entry.second) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Recreate the llama_context so it can hold n_seq parallel sequences in one unified KV cache.
+// Only needed when ContextOptions.maxSequences was too small; drops the prefix cache.
+bool ensure_seq_capacity(LlamaContext* ctx, int n_seq) {
+    if (static_cast<int>(llama_n_seq_max(ctx->context)) >= n_seq) {
+        return true;
+    }
+    
+    llama_context_params params = ctx->params;
+    params.n_seq_max = n_seq;
+    params.kv_unified = true;
+    
+    // The unified KV cache keeps n_ctx cells, but llama.cpp may pad it; re-account both
+    // the KV cache and the compute buffers against the budget before swapping contexts
+    BufferLog buffers;
+    llama_context* resized = init_context_logged(ctx->model, params, buffers);
+    if (resized == nullptr) {
+        return false;
+    }
+    const uint64_t kv_bytes = std::max<uint64_t>(ctx->kv_bytes.load(), (ctx->kv_cell_bytes + ctx->draft_kv_cell_bytes) * llama_n_ctx(resized));
+    const uint64_t compute_bytes = std::max<uint64_t>(ctx->compute_bytes.load(), buffers.compute_bytes + ctx->draft_compute_bytes);
+    const uint64_t extra = (kv_bytes - ctx->kv_bytes.load()) + (compute_bytes - ctx->compute_bytes.load());
+    if (extra > 0 && !ctx->reservation.grow(extra)) {
+        std::cerr << "Memory budget exceeded: " << n_seq << " sequences need " << kv_bytes << " bytes of KV cache and "
+                  << compute_bytes << " bytes of compute buffers" << std::endl;
+        llama_free(resized);
+        return false;
+    }
+    ctx->kv_bytes = kv_bytes;
+    ctx->compute_bytes = compute_bytes;
+    
+    llama_free(ctx->context);
+    ctx->context = resized;
+    ctx->params = params;
+    ctx->n_seq_max.store(static_cast<int>(llama_n_seq_max(resized)), std::memory_order_relaxed);
+    ctx->kv_cells_total.store(static_cast<int>(llama_n_ctx(resized)), std::memory_order_relaxed);
+    if (ctx->threadpool != nullptr) {
+        llama_attach_threadpool(resized, ctx->threadpool, ctx->threadpool_batch ? ctx->threadpool_batch : ctx->threadpool);
+    }
+    apply_adapters(ctx);
+    ctx->tokens.clear();
+    publish_kv_usage(ctx);
+    return true;
+}
+
+Scheduler::Scheduler(LlamaContext* owner, int n_slots) : owner(owner), batch(owner->batch) {
+    n_batch = static_cast<int32_t>(llama_n_batch(owner->context));
+    
+    slots.resize(n_slots);
+    for (int i = 0; i < n_slots; i++) {
+        slots[i].seq_id = i;
+    }
+    
+    // The scheduler owns the whole KV cache from here on
+    llama_memory_clear(llama_get_memory(owner->context), true);
+    owner->tokens.clear();
+    
+    worker = std::thread(&Scheduler::run, this);
+}
+
+Scheduler::~Scheduler() {
+    stop();
+    
+    // Hand the context back with an empty cache
+    llama_memory_clear(llama_get_memory(owner->context), true);
+    owner->tokens.clear();
+    publish_kv_usage(owner);
+}
+
+void fail_request(SchedulerRequest& request, const std::string& error) {
+    record_request(GenerationStats(), error);
+    {
+        std::lock_guard<std::mutex> lock(request.mutex);
+        request.error = error;
+        request.done = true;
+    }
+    request.cv.notify_all();
+}
+
+void Scheduler::submit(const std::shared_ptr<SchedulerRequest>& request) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!stopping) {
+            request->t_queued = Clock::now();
+            queue.push_back(request);
+            g_metrics.queue_depth.fetch_add(1, std::memory_order_relaxed);
+            cv.notify_one();
+            return;
+        }
+    }
+    fail_request(*request, "Error: Scheduler stopped");
+}
+
+// Join the worker thread and fail everything still in flight so no submitter waits
+// forever. Safe to call from several threads; later calls find nothing left to do.
+void Scheduler::stop() {
+    std::lock_guard<std::mutex> stop_lock(stop_mutex);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    
+    for (auto& slot : slots) {
+        if (slot.request) {
+            finish(slot, "Error: Scheduler stopped");
+        }
+    }
+    
+    std::deque<std::shared_ptr<SchedulerRequest>> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.swap(queue);
+        g_metrics.queue_depth.fetch_sub(static_cast<int64_t>(pending.size()), std::memory_order_relaxed);
+    }
+    for (auto& request : pending) {
+        fail_request(*request, "Error: Scheduler stopped");
+    }
+}
+
+bool Scheduler::has_active_slots() const {
+    for (const auto& slot : slots) {
+        if (slot.request) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// KV cells held by every slot's sequence, idle prefix caches included
+int Scheduler::kv_cells_used() const {
+    int n_used = 0;
+    for (const auto& slot : slots) {
+        n_used += static_cast<int>(slot.cached.size());
+    }
+    return n_used;
+}
+
+// Lowest usage among tenants with active sequences. A tenant joining later starts from
+// here instead of 0, so it gets a fair share from now on rather than catching up on the past.
+uint64_t Scheduler::usage_floor() const {
+    uint64_t floor = UINT64_MAX;
+    for (const auto& slot : slots) {
+        if (slot.request) {
+            auto it = tenant_usage.find(slot.request->tenant);
+            floor = std::min<uint64_t>(floor, (it != tenant_usage.end()) ? it->second : 0);
+        }
+    }
+    return (floor == UINT64_MAX) ? 0 : floor;
+}
+
+// Fail queued requests whose deadline has passed; callers hold mutex
+void Scheduler::expire_queued() {
+    const Clock::time_point now = Clock::now();
+    for (auto it = queue.begin(); it != queue.end();) {
+        if ((*it)->deadline != Clock::time_point() && now >= (*it)->deadline) {
+            fail_request(**it, "Error: Deadline exceeded");
+            it = queue.erase(it);
+            g_metrics.queue_depth.fetch_sub(1, std::memory_order_relaxed);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// The queued request to admit next: the most urgent priority class, then the tenant
+// with the least usage, then the earliest deadline, then the earliest submission.
+// Callers hold mutex and ensure the queue is not empty.
+std::deque<std::shared_ptr<SchedulerRequest>>::iterator Scheduler::next_request() {
+    const uint64_t floor = usage_floor();
+    auto usage = [this, floor](const SchedulerRequest& request) {
+        auto it = tenant_usage.find(request.tenant);
+        return std::max<uint64_t>(floor, (it != tenant_usage.end()) ? it->second : 0);
+    };
+    auto deadline = [](const SchedulerRequest& request) {
+        return (request.deadline != Clock::time_point()) ? request.deadline : Clock::time_point::max();
+    };
+    
+    auto best = queue.begin();
+    for (auto it = std::next(queue.begin()); it != queue.end(); ++it) {
+        const SchedulerRequest& a = **it;
+        const SchedulerRequest& b = **best;
+        if (a.priority != b.priority) {
+            if (a.priority < b.priority) best = it;
+        } else if (usage(a) != usage(b)) {
+            if (usage(a) < usage(b)) best = it;
+        } else if (deadline(a) < deadline(b)) {
+            best = it;
+        }
+    }
+    return best;
+}
+
+// Unbind the slot's request and requeue it with its prompt extended by the tokens
+// generated so far; the sampler and detokenizer keep their state, so it resumes where
+// it left off. Callers hold mutex.
+void Scheduler::requeue(SchedulerSlot& slot) {
+    std::shared_ptr<SchedulerRequest> request = std::move(slot.request);
+    slot.request.reset();
+    slot.i_batch = -1;
+    
+    // Past prefill the cache holds the prompt and all generated tokens but the last one,
+    // which was sampled and not yet decoded. During prefill the prompt is unchanged.
+    if (slot.n_prefilled >= request->prompt.size()) {
+        request->prompt = slot.cached;
+        request->prompt.push_back(slot.last_token);
+    }
+    request->n_generated = slot.n_generated;
+    request->stats.preemptions++;
+    
+    request->t_queued = Clock::now();
+    trace_event("preempt", 'i', request->t_queued, request->t_queued, "generated", request->n_generated, "priority", request->priority);
+    queue.push_back(std::move(request));
+    g_metrics.queue_depth.fetch_add(1, std::memory_order_relaxed);
+    g_metrics.active_sequences.fetch_sub(1, std::memory_order_relaxed);
+    g_metrics.preemptions.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Free a slot for a request of the given priority by evicting the sequence of the least
+// urgent lower class with the fewest cached tokens, so the least work is recomputed.
+// Callers hold mutex. Returns false if no active sequence has a lower priority.
+bool Scheduler::preempt(int priority) {
+    SchedulerSlot* victim = nullptr;
+    for (auto& slot : slots) {
+        if (!slot.request || slot.request->priority <= priority) {
+            continue;
+        }
+        if (victim == nullptr || slot.request->priority > victim->request->priority ||
+            (slot.request->priority == victim->request->priority && slot.cached.size() < victim->cached.size())) {
+            victim = &slot;
+        }
+    }
+    if (victim == nullptr) {
+        return false;
+    }
+    
+    // The KV stays in the slot as a prefix cache until the admitted request overwrites it
+    requeue(*victim);
+    return true;
+}
+
+// Free KV cells when the shared cache is full by requeueing the running sequence that
+// holds the most, dropping its KV. It resumes once enough cells are free again. A lone
+// sequence cannot make room for itself and fails instead. Returns false if none is running.
+bool Scheduler::preempt_longest() {
+    SchedulerSlot* victim = nullptr;
+    int n_active = 0;
+    for (auto& slot : slots) {
+        if (!slot.request) {
+            continue;
+        }
+        n_active++;
+        if (victim == nullptr || slot.cached.size() > victim->cached.size()) {
+            victim = &slot;
+        }
+    }
+    if (victim == nullptr) {
+        return false;
+    }
+    if (n_active == 1) {
+        finish(*victim, "Error: KV cache full");
+        return true;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requeue(*victim);
+    }
+    llama_memory_seq_rm(llama_get_memory(owner->context), victim->seq_id, -1, -1);
+    victim->cached.clear();
+    return true;
+}
+
+// The free slot whose cached tokens share the longest prefix with the request's prompt,
+// or null if every slot is busy
+SchedulerSlot* Scheduler::free_slot(const SchedulerRequest& request) {
+    SchedulerSlot* best = nullptr;
+    size_t best_prefix = 0;
+    for (auto& slot : slots) {
+        if (slot.request) {
+            continue;
+        }
+        size_t prefix = common_prefix_len(slot.cached, request.prompt);
+        if (best == nullptr || prefix > best_prefix) {
+            best = &slot;
+            best_prefix = prefix;
+        }
+    }
+    return best;
+}
+
+// Whether the request's prompt fits in the cells left in the shared KV cache once it
+// replaces the slot's cached tokens, keeping one decode step of room for every sequence
+bool Scheduler::fits(const SchedulerRequest& request, const SchedulerSlot& slot, int n_ctx) const {
+    int n_active = 0;
+    for (const auto& other : slots) {
+        n_active += other.request ? 1 : 0;
+    }
+    const int n_free = n_ctx - kv_cells_used() + static_cast<int>(slot.cached.size());
+    return static_cast<int>(request.prompt.size()) + n_active + 1 <= n_free;
+}
+
+// Bind a request to a free slot, reusing the prefix of its prompt cached there
+void Scheduler::admit(const std::shared_ptr<SchedulerRequest>& request, SchedulerSlot& slot) {
+    const size_t n_reused = reuse_cached_prefix(llama_get_memory(owner->context), slot.seq_id, slot.cached, request->prompt);
+    slot.cached.resize(n_reused);
+    
+    slot.request = request;
+    slot.n_prefilled = n_reused;
+    slot.n_past = static_cast<llama_pos>(n_reused);
+    slot.n_generated = request->n_generated;
+    
+    auto& usage = tenant_usage[request->tenant];
+    usage = std::max(usage, usage_floor());
+    
+    const Clock::time_point now = Clock::now();
+    request->stats.queue_ms += elapsed_ms(request->t_queued, now);
+    g_metrics.queue_wait_us.record(elapsed_us(request->t_queued, now));
+    g_metrics.active_sequences.fetch_add(1, std::memory_order_relaxed);
+    if (request->stats.preemptions > 0) {
+        return;  // resuming: output, prefill and TTFT stats carry over
+    }
+    request->detokenizer.reset(llama_model_get_vocab(owner->model), request->stop);
+    request->n_prompt = request->prompt.size();
+    request->t_admitted = now;
+    request->stats.prompt_tokens = static_cast<int>(request->prompt.size());
+    request->stats.cached_tokens = static_cast<int>(n_reused);
+}
+
+// Drop the KV cached by idle slots to make room in the shared cache.
+// Returns true if anything was freed.
+bool Scheduler::evict_idle_caches() {
+    bool evicted = false;
+    for (auto& slot : slots) {
+        if (!slot.request && !slot.cached.empty()) {
+            llama_memory_seq_rm(llama_get_memory(owner->context), slot.seq_id, -1, -1);
+            slot.cached.clear();
+            evicted = true;
+        }
+    }
+    return evicted;
+}
+
+// Undo the bookkeeping of a batch llama.cpp rejected for lack of KV cells; the rejected
+// batch left the cache itself unchanged
+void Scheduler::rollback_batch() {
+    for (auto& slot : slots) {
+        if (slot.n_batched == 0) {
+            continue;
+        }
+        slot.cached.resize(slot.cached.size() - slot.n_batched);
+        slot.n_past -= slot.n_batched;
+        if (slot.batched_prompt) {
+            slot.n_prefilled -= slot.n_batched;
+        }
+        if (slot.request) {
+            uint64_t& usage = tenant_usage[slot.request->tenant];
+            usage -= std::min<uint64_t>(usage, slot.n_batched);
+        }
+        slot.n_batched = 0;
+        slot.i_batch = -1;
+    }
+}
+
+void Scheduler::finish(SchedulerSlot& slot, const std::string& error) {
+    std::shared_ptr<SchedulerRequest> request = std::move(slot.request);
+    slot.request.reset();
+    slot.i_batch = -1;
+    
+    // Keep the sequence's KV for prefix reuse unless a failed decode left it inconsistent
+    if (!error.empty()) {
+        llama_memory_seq_rm(llama_get_memory(owner->context), slot.seq_id, -1, -1);
+        slot.cached.clear();
+    }
+    
+    // A tenant without active sequences gives up its usage
+    if (std::none_of(slots.begin(), slots.end(), [&request](const SchedulerSlot& other) {
+            return other.request && other.request->tenant == request->tenant; })) {
+        tenant_usage.erase(request->tenant);
+    }
+    
+    GenerationStats& stats = request->stats;
+    stats.generated_tokens = slot.n_generated;
+    if (request->t_first_token != Clock::time_point()) {
+        stats.prefill_ms = elapsed_ms(request->t_admitted, request->t_first_token);
+        stats.ttft_ms = elapsed_ms(request->t_submitted, request->t_first_token);
+        stats.decode_ms = elapsed_ms(request->t_first_token, Clock::now());
+    }
+    stats.kv_size = static_cast<int>(llama_n_ctx(owner->context));
+    stats.kv_used = kv_cells_used();
+    
+    owner->kv_cells_used.store(stats.kv_used, std::memory_order_relaxed);
+    g_metrics.active_sequences.fetch_sub(1, std::memory_order_relaxed);
+    record_request(stats, error);
+    trace_event("generate", 'X', request->t_submitted, Clock::now(), "prompt_tokens", stats.prompt_tokens, "generated_tokens", stats.generated_tokens);
+    
+    std::string_view tail = request->detokenizer.flush();
+    {
+        std::lock_guard<std::mutex> lock(request->mutex);
+        if (error.empty()) {
+            request->output.append(tail);
+        }
+        request->error = error;
+        request->done = true;
+    }
+    request->cv.notify_all();
+}
+
+void Scheduler::run() {
+    llama_context* lctx = owner->context;
+    const auto* vocab = llama_model_get_vocab(owner->model);
+    const int n_ctx = static_cast<int>(llama_n_ctx(lctx));
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return stopping || !queue.empty() || has_active_slots(); });
+            if (stopping) {
+                return;
+            }
+            
+            // Admit queued requests into free slots between decode steps, preempting
+            // lower priority sequences when every slot is busy. The most urgent request
+            // waits for KV cells rather than being overtaken, so it cannot starve.
+            expire_queued();
+            while (!queue.empty()) {
+                auto next = next_request();
+                SchedulerSlot* slot = free_slot(**next);
+                if (slot == nullptr) {
+                    if (!preempt((*next)->priority)) {
+                        break;
+                    }
+                    continue;  // preempt() requeued a request, invalidating next
+                }
+                if (!fits(**next, *slot, n_ctx)) {
+                    // Idle prefix caches are the first cells to give up
+                    if (evict_idle_caches()) {
+                        continue;
+                    }
+                    if (has_active_slots()) {
+                        break;
+                    }
+                    // Even an empty cache cannot hold it, e.g. a long preempted sequence
+                    fail_request(**next, "Error: KV cache full");
+                    queue.erase(next);
+                    g_metrics.queue_depth.fetch_sub(1, std::memory_order_relaxed);
+                    continue;
+                }
+                std::shared_ptr<SchedulerRequest> request = std::move(*next);
+                queue.erase(next);
+                g_metrics.queue_depth.fetch_sub(1, std::memory_order_relaxed);
+                admit(request, *slot);
+            }
+        }
+        
+        // Cancelled requests and those past their deadline leave before the next step
+        const Clock::time_point now = Clock::now();
+        for (auto& slot : slots) {
+            if (slot.request && slot.request->cancelled) {
+                finish(slot, "");
+            } else if (slot.request && slot.request->deadline != Clock::time_point() && now >= slot.request->deadline) {
+                finish(slot, "Error: Deadline exceeded");
+            }
+        }
+        
+        batch.n_tokens = 0;
+        
+        // Sequences past prefill contribute their last sampled token. nativeStartScheduler and
+        // generate_batch cap the slots at n_batch, so they always fit; the check guards the buffer regardless.
+        for (auto& slot : slots) {
+            slot.i_batch = -1;
+            slot.n_batched = 0;
+            slot.batched_prompt = false;
+            if (!slot.request || slot.n_prefilled < slot.request->prompt.size() || batch.n_tokens >= n_batch) {
+                continue;
+            }
+            slot.i_batch = batch.n_tokens;
+            slot.n_batched = 1;
+            slot.cached.push_back(slot.last_token);
+            batch_add(batch, slot.last_token, slot.n_past++, slot.seq_id, true);
+            tenant_usage[slot.request->tenant]++;
+        }
+        
+        // Sequences still in prefill fill the remaining batch space and free KV cells
+        const int32_t n_limit = std::min<int32_t>(n_batch, batch.n_tokens + n_ctx - kv_cells_used());
+        for (auto& slot : slots) {
+            if (!slot.request || slot.n_prefilled >= slot.request->prompt.size()) {
+                continue;
+            }
+            const auto& prompt = slot.request->prompt;
+            const int32_t n_before = batch.n_tokens;
+            while (slot.n_prefilled < prompt.size() && batch.n_tokens < n_limit) {
+                slot.cached.push_back(prompt[slot.n_prefilled]);
+                batch_add(batch, prompt[slot.n_prefilled++], slot.n_past++, slot.seq_id, false);
+            }
+            slot.n_batched = batch.n_tokens - n_before;
+            slot.batched_prompt = true;
+            tenant_usage[slot.request->tenant] += slot.n_batched;
+            
+            // Request logits once the final prompt token is in the batch
+            if (slot.n_prefilled == prompt.size()) {
+                slot.i_batch = batch.n_tokens - 1;
+                batch.logits[slot.i_batch] = true;
+            }
+        }
+        
+        // With sequences active, an empty batch means only prefills are left and no
+        // KV cells are free for them
+        if (batch.n_tokens == 0) {
+            if (has_active_slots() && !evict_idle_caches()) {
+                preempt_longest();
+            }
+            continue;
+        }
+        
+        // llama.cpp rejects a batch it finds no KV cells for (return value 1) before
+        // decoding any of it. Undo the step, free cells from idle prefix caches or else the
+        // longest running sequence, and rebuild the batch from the remaining sequences.
+        int decode_result = decode_traced(lctx, batch);
+        if (decode_result == 1) {
+            rollback_batch();
+            if (!evict_idle_caches()) {
+                preempt_longest();
+            }
+            continue;
+        }
+        
+        // Any other failure may have left the cache inconsistent for every sequence
+        if (decode_result != 0) {
+            for (auto& slot : slots) {
+                if (slot.request) {
+                    finish(slot, "Error: Failed to decode batch");
+                }
+            }
+            continue;
+        }
+        
+        owner->kv_cells_used.store(kv_cells_used(), std::memory_order_relaxed);
+        
+        for (auto& slot : slots) {
+            if (!slot.request || slot.i_batch < 0) {
+                continue;
+            }
+            
+            float* logits = llama_get_logits_ith(lctx, slot.i_batch);
+            if (logits == nullptr) {
+                finish(slot, "");
+                continue;
+            }
+            
+            llama_token new_token = slot.request->sampler->sample(logits);
+            if (slot.n_generated == 0) {
+                slot.request->t_first_token = Clock::now();
+            }
+            if (llama_vocab_is_eog(vocab, new_token)) {
+                finish(slot, "");
+                continue;
+            }
+            
+            std::string_view chunk = slot.request->detokenizer.push(new_token);
+            if (!chunk.empty()) {
+                {
+                    std::lock_guard<std::mutex> lock(slot.request->mutex);
+                    slot.request->output.append(chunk);
+                }
+                slot.request->cv.notify_all();
+            }
+            
+            slot.last_token = new_token;
+            slot.n_generated++;
+            if (slot.request->detokenizer.stopped) {
+                finish(slot, "");
+                continue;
+            }
+            
+            // Positions are per sequence, so one sequence can grow to the whole context;
+            // the cells it shares with the others are managed when a decode finds none left
+            const int prompt_size = static_cast<int>(slot.request->n_prompt);
+            const int max_gen_tokens = std::min(slot.request->max_tokens, n_ctx - prompt_size);
+            if (slot.n_generated >= max_gen_tokens) {
+                finish(slot, "");
+            }
+        }
+    }
+}
+
+// Tokenize input into a request for the context's scheduler.
+// Returns an empty string on success.
+std::string make_scheduler_request(LlamaContext* ctx, const PromptInput& input, const GenerationParams& params,
+                                   std::shared_ptr<SchedulerRequest>& request) {
+    const auto* vocab = llama_model_get_vocab(ctx->model);
+    
+    request = std::make_shared<SchedulerRequest>();
+    request->max_tokens = params.max_tokens;
+    request->stop = params.stop;
+    request->priority = params.priority;
+    request->tenant = params.tenant;
+    if (params.deadline_ms > 0) {
+        request->deadline = Clock::now() + std::chrono::milliseconds(params.deadline_ms);
+    }
+    request->sampler = std::make_unique<TokenSampler>(vocab, params);
+    if (!params.grammar.empty() && request->sampler->grammar == nullptr) {
+        return "Error: Invalid grammar";
+    }
+    
+    if (!resolve_prompt(vocab, input, request->prompt) || request->prompt.empty()) {
+        return (input.tokens != nullptr) ? "Error: Invalid prompt tokens" : "Error: Tokenization failed";
+    }
+    
+    const size_t n_limit = llama_n_ctx(ctx->context) / 2;
+    if (request->prompt.size() > n_limit) {
+        return "Error: Prompt too long (" + std::to_string(request->prompt.size()) + " tokens, limit " + std::to_string(n_limit) + ")";
+    }
+    return "";
+}
+
+// Submit a prompt to the context's scheduler and forward its output to on_piece
+// on the calling thread until the request finishes.
+std::string scheduler_generate(LlamaContext* ctx, const PromptInput& input, const GenerationParams& params, const PieceCallback& on_piece,
+                               GenerationStats* stats) {
+    const Clock::time_point t_start = Clock::now();
+    
+    std::shared_ptr<SchedulerRequest> request;
+    std::string error = make_scheduler_request(ctx, input, params, request);
+    if (!error.empty()) {
+        return error;
+    }
+    
+    request->t_submitted = Clock::now();
+    ctx->scheduler->submit(request);
+    
+    while (true) {
+        std::string chunk;
+        bool done = false;
+        {
+            std::unique_lock<std::mutex> lock(request->mutex);
+            request->cv.wait(lock, [&request] { return request->done || !request->output.empty(); });
+            chunk.swap(request->output);
+            done = request->done;
+        }
+        
+        if (!chunk.empty() && !request->cancelled && !on_piece(chunk)) {
+            request->cancelled = true;
+        }
+        if (done) {
+            if (stats != nullptr) {
+                *stats = request->stats;
+                stats->tokenize_ms = elapsed_ms(t_start, request->t_submitted);
+                if (stats->ttft_ms > 0) {
+                    stats->ttft_ms += stats->tokenize_ms;
+                }
+                stats->total_ms = elapsed_ms(t_start, Clock::now());
+            }
+            return request->error;
+        }
+    }
+}
+
+// Run a generation, routing it through the scheduler when one owns the context.
+// Fills stats when it is non-null.
+std::string generate(LlamaContext* ctx, const PromptInput& input, const GenerationParams& params, const PieceCallback& on_piece,
+                     GenerationStats* stats = nullptr) {
+    // The scheduler may start or stop between the two checks, so re-check under each lock
+    while (true) {
+        {
+            std::shared_lock<std::shared_mutex> lock(ctx->exec_mutex);
+            if (ctx->scheduler) {
+                return scheduler_generate(ctx, input, params, on_piece, stats);
+            }
+        }
+        {
+            std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+            if (!ctx->scheduler) {
+                const Clock::time_point t_start = Clock::now();
+                GenerationStats local_stats;
+                GenerationStats* st = stats ? stats : &local_stats;
+                std::string error = run_generation(ctx, input, params, on_piece, st);
+                publish_kv_usage(ctx);
+                record_request(*st, error);
+                trace_event("generate", 'X', t_start, Clock::now(), "prompt_tokens", st->prompt_tokens, "generated_tokens", st->generated_tokens);
+                return error;
+            }
+        }
+    }
+}
+
+// Queue every prompt on scheduler at once and collect each output into results.
+// Prompts after the first draw their own seed. Returns the first error, if any.
+std::string run_batch(LlamaContext* ctx, Scheduler& scheduler, const std::vector<std::string>& prompts, const GenerationParams& params,
+                      std::vector<std::string>& results) {
+    std::vector<std::shared_ptr<SchedulerRequest>> requests(prompts.size());
+    for (size_t i = 0; i < prompts.size(); i++) {
+        GenerationParams prompt_params = params;
+        if (i > 0) {
+            prompt_params.seed = next_seed(ctx);
+        }
+        std::string error = make_scheduler_request(ctx, prompts[i], prompt_params, requests[i]);
+        if (!error.empty()) {
+            return error;
+        }
+    }
+    
+    for (auto& request : requests) {
+        request->t_submitted = Clock::now();
+        scheduler.submit(request);
+    }
+    
+    // Outputs accumulate natively; each request is read once it is done
+    std::string error;
+    results.assign(prompts.size(), std::string());
+    for (size_t i = 0; i < requests.size(); i++) {
+        SchedulerRequest& request = *requests[i];
+        std::unique_lock<std::mutex> lock(request.mutex);
+        request.cv.wait(lock, [&request] { return request.done; });
+        results[i].swap(request.output);
+        if (error.empty()) {
+            error = request.error;
+        }
+    }
+    return error;
+}
+
+// Generate every prompt as its own sequence, decoded together in shared batches.
+// Uses the running scheduler, or else a temporary one sized to the batch while the
+// context is held exclusively; that clears the KV cache of single-sequence calls.
+std::string generate_batch(LlamaContext* ctx, const std::vector<std::string>& prompts, const GenerationParams& params,
+                           std::vector<std::string>& results) {
+    // Reject a bad grammar before a temporary scheduler clears the prefix cache
+    if (!grammar_is_valid(llama_model_get_vocab(ctx->model), params)) {
+        return "Error: Invalid grammar";
+    }
+    
+    // The scheduler may start or stop between the two checks, so re-check under each lock
+    while (true) {
+        {
+            std::shared_lock<std::shared_mutex> lock(ctx->exec_mutex);
+            if (ctx->scheduler) {
+                return run_batch(ctx, *ctx->scheduler, prompts, params, results);
+            }
+        }
+        {
+            std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+            if (!ctx->scheduler) {
+                // Every sequence adds a token to each decode step, so the slots are capped at
+                // n_batch as in nativeStartScheduler; keep the current capacity if the context cannot grow
+                const int n_wanted = std::min<int>({static_cast<int>(prompts.size()), LLAMA_JNI_MAX_BATCH_SEQUENCES,
+                                                    static_cast<int>(llama_n_batch(ctx->context))});
+                ensure_seq_capacity(ctx, n_wanted);
+                const int n_seq = std::min<int>(n_wanted, static_cast<int>(llama_n_seq_max(ctx->context)));
+                
+                Scheduler scheduler(ctx, n_seq);
+                return run_batch(ctx, scheduler, prompts, params, results);
+            }
+        }
+    }
+}
+
+void l2_normalize(float* v, int n) {
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += static_cast<double>(v[i]) * v[i];
+    }
+    if (sum > 0.0) {
+        const float scale = static_cast<float>(1.0 / std::sqrt(sum));
+        for (int i = 0; i < n; i++) {
+            v[i] *= scale;
+        }
+    }
+}
+
+// Tokenize texts for run_embeddings. Every sequence has to fit in a single micro-batch, so a
+// longer text is cut to n_ubatch tokens when truncate is set and rejected otherwise, rather
+// than silently embedding only its start. The caller holds the context's exec lock.
+llama_jni_error_t tokenize_embedding_texts(LlamaContext* ctx, const std::vector<std::string>& texts, bool truncate,
+                                           std::vector<std::vector<llama_token>>& tokenized) {
+    const auto* vocab = llama_model_get_vocab(ctx->model);
+    const int n_ubatch = static_cast<int>(llama_n_ubatch(ctx->context));
+    
+    tokenized.assign(texts.size(), {});
+    for (size_t i = 0; i < texts.size(); i++) {
+        if (!tokenize_text(vocab, texts[i], tokenized[i]) || tokenized[i].empty()) {
+            std::cerr << "Embedding text " << i << ": tokenization failed" << std::endl;
+            return LLAMA_JNI_ERR_TOKENIZATION_FAILED;
+        }
+        if (static_cast<int>(tokenized[i].size()) > n_ubatch) {
+            if (!truncate) {
+                std::cerr << "Embedding text " << i << " has " << tokenized[i].size() << " tokens, more than the micro-batch size "
+                          << n_ubatch << std::endl;
+                return LLAMA_JNI_ERR_INVALID_PARAMS;
+            }
+            tokenized[i].resize(n_ubatch);
+        }
+    }
+    return LLAMA_JNI_ERR_NONE;
+}
+
+// Embed every tokenized text into out (tokenized.size() * n_embd floats). Texts are packed as
+// separate sequences into as few decodes as n_ubatch and n_seq_max allow. Contexts created
+// without a pooling type are pooled here from per-token embeddings; others use llama.cpp's
+// pooling. The caller holds the context's exec lock. Returns an empty string on success.
+std::string run_embeddings(LlamaContext* ctx, const std::vector<std::vector<llama_token>>& tokenized, enum llama_pooling_type pooling,
+                           bool normalize, float* out) {
+    // Let one decode carry many texts; keep the current capacity if the context cannot grow
+    ensure_seq_capacity(ctx, std::min<int>(static_cast<int>(tokenized.size()), LLAMA_JNI_MAX_EMBED_SEQUENCES));
+    
+    const int n_embd = llama_model_n_embd(ctx->model);
+    const int n_ubatch = static_cast<int>(llama_n_ubatch(ctx->context));
+    const int n_seq = static_cast<int>(llama_n_seq_max(ctx->context));
+    
+    const enum llama_pooling_type ctx_pooling = llama_pooling_type(ctx->context);
+    const bool native_pooling = ctx_pooling == LLAMA_POOLING_TYPE_NONE;
+    if (!native_pooling && pooling != LLAMA_POOLING_TYPE_UNSPECIFIED && pooling != ctx_pooling) {
+        return "Error: Context was created with a different pooling type";
+    }
+    if (native_pooling && pooling == LLAMA_POOLING_TYPE_UNSPECIFIED) {
+        pooling = LLAMA_POOLING_TYPE_MEAN;
+    }
+    
+    // Embedding decodes overwrite the KV cache, so the cached prompt prefix is dropped
+    invalidate_cache(ctx);
+    llama_set_embeddings(ctx->context, true);
+    
+    llama_batch& batch = ctx->batch;
+    std::vector<int32_t> seq_start;
+    std::string error;
+    
+    for (size_t next = 0; next < tokenized.size() && error.empty();) {
+        const size_t first = next;
+        batch.n_tokens = 0;
+        seq_start.clear();
+        
+        while (next < tokenized.size() && static_cast<int>(next - first) < n_seq &&
+               batch.n_tokens + static_cast<int>(tokenized[next].size()) <= n_ubatch) {
+            const auto& tokens = tokenized[next];
+            const int last = static_cast<int>(tokens.size()) - 1;
+            seq_start.push_back(batch.n_tokens);
+            for (int j = 0; j <= last; j++) {
+                // Natively pooled sequences only need outputs for the tokens being pooled
+                bool output = !native_pooling || pooling == LLAMA_POOLING_TYPE_MEAN ||
+                              (pooling == LLAMA_POOLING_TYPE_CLS && j == 0) ||
+                              (pooling == LLAMA_POOLING_TYPE_LAST && j == last);
+                batch_add(batch, tokens[j], j, static_cast<llama_seq_id>(next - first), output);
+            }
+            next++;
+        }
+        
+        if (decode_traced(ctx->context, batch) != 0) {
+            error = "Error: Failed to decode embedding batch";
+            break;
+        }
+        
+        for (size_t s = 0; s < seq_start.size(); s++) {
+            float* dst = out + (first + s) * n_embd;
+            const int start = seq_start[s];
+            const int len = static_cast<int>(tokenized[first + s].size());
+            
+            if (!native_pooling) {
+                const float* embd = llama_get_embeddings_seq(ctx->context, static_cast<llama_seq_id>(s));
+                if (embd == nullptr) {
+                    error = "Error: Failed to get sequence embeddings";
+                    break;
+                }
+                std::memcpy(dst, embd, n_embd * sizeof(float));
+            } else if (pooling == LLAMA_POOLING_TYPE_MEAN) {
+                std::fill(dst, dst + n_embd, 0.0f);
+                for (int j = 0; j < len && error.empty(); j++) {
+                    const float* embd = llama_get_embeddings_ith(ctx->context, start + j);
+                    if (embd == nullptr) {
+                        error = "Error: Failed to get token embeddings";
+                        break;
+                    }
+                    for (int k = 0; k < n_embd; k++) {
+                        dst[k] += embd[k];
+                    }
+                }
+                for (int k = 0; k < n_embd; k++) {
+                    dst[k] /= len;
+                }
+            } else {
+                const int index = (pooling == LLAMA_POOLING_TYPE_CLS) ? start : start + len - 1;
+                const float* embd = llama_get_embeddings_ith(ctx->context, index);
+                if (embd == nullptr) {
+                    error = "Error: Failed to get token embeddings";
+                    break;
+                }
+                std::memcpy(dst, embd, n_embd * sizeof(float));
+            }
+            
+            if (normalize) {
+                l2_normalize(dst, n_embd);
+            }
+        }
+        
+        // Sequence ids are reused by the next chunk
+        llama_memory_clear(llama_get_memory(ctx->context), true);
+    }
+    
+    llama_set_embeddings(ctx->context, false);
+    return error;
+}
+
+// File used to spill a named snapshot; the hash keeps sanitized names unique
+std::string session_spill_path(const SessionCache& cache, const std::string& session_id) {
+    std::string name;
+    for (char c : session_id) {
+        name += (std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_') ? c : '_';
+    }
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016zx", std::hash<std::string>{}(session_id));
+    return cache.spill_dir + "/" + name.substr(0, 64) + "-" + hash + ".llamastate";
+}
+
+static const uint32_t SESSION_FILE_MAGIC = 0x53534a4c;  // "LJSS"
+static const uint32_t SESSION_FILE_VERSION = 1;
+
+bool write_snapshot_file(const std::string& path, const StateSnapshot& snapshot) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    
+    const uint64_t n_tokens = snapshot.tokens.size();
+    const uint64_t n_bytes = snapshot.data.size();
+    out.write(reinterpret_cast<const char*>(&SESSION_FILE_MAGIC), sizeof(SESSION_FILE_MAGIC));
+    out.write(reinterpret_cast<const char*>(&SESSION_FILE_VERSION), sizeof(SESSION_FILE_VERSION));
+    out.write(reinterpret_cast<const char*>(&n_tokens), sizeof(n_tokens));
+    out.write(reinterpret_cast<const char*>(snapshot.tokens.data()), n_tokens * sizeof(llama_token));
+    out.write(reinterpret_cast<const char*>(&n_bytes), sizeof(n_bytes));
+    out.write(reinterpret_cast<const char*>(snapshot.data.data()), n_bytes);
+    return static_cast<bool>(out);
+}
+
+// Read a spilled snapshot of at most max_tokens tokens. Both lengths are checked against
+// the file size before anything is allocated, so a truncated or corrupt file is rejected.
+bool read_snapshot_file(const std::string& path, size_t max_tokens, StateSnapshot& snapshot) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+    const uint64_t file_bytes = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+    
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t n_tokens = 0;
+    uint64_t n_bytes = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    if (!in || magic != SESSION_FILE_MAGIC || version != SESSION_FILE_VERSION) {
+        return false;
+    }
+    
+    const uint64_t header_bytes = sizeof(magic) + sizeof(version) + sizeof(n_tokens) + sizeof(n_bytes);
+    in.read(reinterpret_cast<char*>(&n_tokens), sizeof(n_tokens));
+    if (!in || n_tokens > max_tokens || header_bytes + n_tokens * sizeof(llama_token) > file_bytes) {
+        return false;
+    }
+    snapshot.tokens.resize(n_tokens);
+    in.read(reinterpret_cast<char*>(snapshot.tokens.data()), n_tokens * sizeof(llama_token));
+    in.read(reinterpret_cast<char*>(&n_bytes), sizeof(n_bytes));
+    if (!in || n_bytes != file_bytes - header_bytes - n_tokens * sizeof(llama_token)) {
+        snapshot.tokens.clear();
+        return false;
+    }
+    snapshot.data.resize(n_bytes);
+    in.read(reinterpret_cast<char*>(snapshot.data.data()), n_bytes);
+    return static_cast<bool>(in);
+}
+
+// Evict least recently used snapshots until the cache fits its byte budget
+void session_cache_trim(SessionCache& cache) {
+    while (cache.used_bytes > cache.max_bytes && !cache.entries.empty()) {
+        auto& victim = cache.entries.back();
+        if (!cache.spill_dir.empty() && !write_snapshot_file(session_spill_path(cache, victim.first), victim.second)) {
+            std::cerr << "Failed to spill session '" << victim.first << "' to " << cache.spill_dir << std::endl;
+        }
+        cache.used_bytes -= victim.second.size_bytes();
+        cache.index.erase(victim.first);
+        cache.entries.pop_back();
+    }
+}
+
+void session_cache_put(SessionCache& cache, const std::string& session_id, StateSnapshot snapshot) {
+    auto it = cache.index.find(session_id);
+    if (it != cache.index.end()) {
+        cache.used_bytes -= it->second->second.size_bytes();
+        cache.entries.erase(it->second);
+        cache.index.erase(it);
+    }
+    
+    cache.used_bytes += snapshot.size_bytes();
+    cache.entries.emplace_front(session_id, std::move(snapshot));
+    cache.index[session_id] = cache.entries.begin();
+    session_cache_trim(cache);
+}
+
+// Find a snapshot in memory, falling back to the spill directory. Spilled snapshots
+// are cached again when they fit the budget and are read into scratch otherwise.
+// Returns nullptr if the session is unknown or its spill file holds more than max_tokens.
+const StateSnapshot* session_cache_get(SessionCache& cache, const std::string& session_id, size_t max_tokens, StateSnapshot& scratch) {
+    auto it = cache.index.find(session_id);
+    if (it != cache.index.end()) {
+        cache.entries.splice(cache.entries.begin(), cache.entries, it->second);
+        return &cache.entries.front().second;
+    }
+    
+    if (cache.spill_dir.empty() || !read_snapshot_file(session_spill_path(cache, session_id), max_tokens, scratch)) {
+        return nullptr;
+    }
+    
+    if (scratch.size_bytes() > cache.max_bytes) {
+        return &scratch;
+    }
+    session_cache_put(cache, session_id, std::move(scratch));
+    return &cache.entries.front().second;
+}
+
+// A generation submitted through nativeGenerateAsync, completed from a pool worker
+struct AsyncJob {
+    jlong handle = 0;
+    std::string prompt;
+    GenerationParams params;
+    bool batched = false;     // the context's scheduler accepts concurrent requests
+    jobject future = nullptr; // global reference to the CompletableFuture
+};
+
+// Native threads attached to the JVM once at startup. Jobs on the same context run
+// one at a time in submission order, except when a scheduler batches them.
+struct AsyncWorkerPool {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<AsyncJob> queue;
+    std::unordered_set<jlong> busy;  // contexts with a job running
+    std::vector<std::thread> workers;
+};
+
+// Started on first use and never torn down: its daemon threads live until the JVM exits
+static AsyncWorkerPool* g_async_pool = nullptr;
+static int g_async_worker_count = LLAMA_JNI_DEFAULT_ASYNC_WORKERS;
+static std::mutex g_async_pool_mutex;
+
+bool future_is_done(JNIEnv* env, jobject future) {
+    jboolean done = env->CallBooleanMethod(future, g_future_is_done);
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+        return true;
+    }
+    return done == JNI_TRUE;
+}
+
+// Run one job and complete its future with the text or a RuntimeException
+void run_async_job(JNIEnv* env, AsyncJob& job) {
+    // Worker threads never return to Java, so local references are released per job
+    if (env->PushLocalFrame(8) != JNI_OK) {
+        env->ExceptionClear();
+        env->DeleteGlobalRef(job.future);
+        return;
+    }
+    
+    // A future cancelled while queued is skipped; one cancelled mid-run stops at the next token
+    if (!future_is_done(env, job.future)) {
+        std::string result;
+        std::string error;
+        std::shared_ptr<LlamaContext> ctx = get_context(job.handle);
+        if (!context_ready(ctx.get())) {
+            error = "Error: Invalid handle or model not loaded";
+        } else {
+            try {
+                error = generate(ctx.get(), job.prompt, job.params, [&](std::string_view piece) {
+                    result += piece;
+                    return !future_is_done(env, job.future);
+                });
+            } catch (const std::exception& e) {
+                std::cerr << "Exception in async generation: " << e.what() << std::endl;
+                error = "Error: Exception during text generation";
+            } catch (...) {
+                std::cerr << "Unknown exception in async generation" << std::endl;
+                error = "Error: Unknown exception during text generation";
+            }
+        }
+        
+        if (error.empty()) {
+            env->CallBooleanMethod(job.future, g_future_complete, string_to_jstring(env, result));
+        } else {
+            jobject exception = env->NewObject(g_runtime_exception_class, g_runtime_exception_init, string_to_jstring(env, error));
+            env->CallBooleanMethod(job.future, g_future_complete_exceptionally, exception);
+        }
+        if (env->ExceptionCheck()) {
+            env->ExceptionDescribe();
+            env->ExceptionClear();
+        }
+    }
+    
+    env->PopLocalFrame(nullptr);
+    env->DeleteGlobalRef(job.future);
+}
+
+void async_worker_main(AsyncWorkerPool* pool) {
+    JNIEnv* env = nullptr;
+    JavaVMAttachArgs args{JNI_VERSION_1_6, const_cast<char*>("llama-async-worker"), nullptr};
+    if (g_jvm->AttachCurrentThreadAsDaemon(reinterpret_cast<void**>(&env), &args) != JNI_OK) {
+        std::cerr << "Failed to attach async worker to the JVM" << std::endl;
+        return;
+    }
+    
+    while (true) {
+        AsyncJob job;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            auto next = pool->queue.end();
+            pool->cv.wait(lock, [&] {
+                next = std::find_if(pool->queue.begin(), pool->queue.end(), [pool](const AsyncJob& queued) {
+                    return queued.batched || pool->busy.count(queued.handle) == 0;
+                });
+                return next != pool->queue.end();
+            });
+            job = std::move(*next);
+            pool->queue.erase(next);
+            if (!job.batched) {
+                pool->busy.insert(job.handle);
+            }
+        }
+        
+        run_async_job(env, job);
+        
+        if (!job.batched) {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->busy.erase(job.handle);
+        }
+        // Jobs queued behind this context may now be runnable
+        pool->cv.notify_all();
+    }
+}
+
+AsyncWorkerPool* get_async_pool() {
+    std::lock_guard<std::mutex> lock(g_async_pool_mutex);
+    if (g_async_pool == nullptr) {
+        g_async_pool = new AsyncWorkerPool();
+        for (int i = 0; i < g_async_worker_count; i++) {
+            g_async_pool->workers.emplace_back(async_worker_main, g_async_pool);
+        }
+    }
+    return g_async_pool;
+}
+
+// Capture the facts nativeGetModelInfo reports that stay fixed for the context's lifetime:
+// model dimensions and size, cache types, system info and the GGUF metadata
+void capture_model_info(LlamaContext* ctx) {
+    const auto* vocab = llama_model_get_vocab(ctx->model);
+    
+    std::vector<jlong>& numbers = ctx->info_numbers;
+    numbers.assign(LLAMA_JNI_INFO_COUNT, 0);
+    numbers[LLAMA_JNI_INFO_VOCAB_SIZE] = llama_vocab_n_tokens(vocab);
+    numbers[LLAMA_JNI_INFO_TRAIN_CONTEXT] = llama_model_n_ctx_train(ctx->model);
+    numbers[LLAMA_JNI_INFO_EMBEDDING] = llama_model_n_embd(ctx->model);
+    numbers[LLAMA_JNI_INFO_LAYERS] = llama_model_n_layer(ctx->model);
+    numbers[LLAMA_JNI_INFO_HEADS] = llama_model_n_head(ctx->model);
+    numbers[LLAMA_JNI_INFO_HEADS_KV] = llama_model_n_head_kv(ctx->model);
+    numbers[LLAMA_JNI_INFO_PARAMETERS] = static_cast<jlong>(llama_model_n_params(ctx->model));
+    numbers[LLAMA_JNI_INFO_SIZE_BYTES] = static_cast<jlong>(llama_model_size(ctx->model));
+    
+    // Fixed strings first, then GGUF metadata as key/value pairs
+    char desc[256];
+    llama_model_desc(ctx->model, desc, sizeof(desc));
+    std::vector<std::string>& strings = ctx->info_strings;
+    strings = {
+        desc,
+        ftype_name(static_cast<int>(model_meta_int(ctx->model, "general.file_type", -1))),
+        ggml_type_name(ctx->params.type_k),
+        ggml_type_name(ctx->params.type_v),
+        llama_print_system_info(),
+    };
+    const int32_t n_meta = llama_model_meta_count(ctx->model);
+    std::vector<char> buffer(256);
+    for (int32_t i = 0; i < n_meta; i++) {
+        int32_t n = llama_model_meta_key_by_index(ctx->model, i, buffer.data(), buffer.size());
+        if (n < 0) {
+            continue;
+        }
+        strings.emplace_back(buffer.data(), std::min<size_t>(n, buffer.size() - 1));
+        
+        // Array values such as the tokenizer's vocabulary are cut off rather than copied whole
+        n = llama_model_meta_val_str_by_index(ctx->model, i, buffer.data(), buffer.size());
+        if (n >= static_cast<int32_t>(buffer.size()) && buffer.size() < LLAMA_JNI_MAX_META_VALUE_BYTES) {
+            buffer.resize(std::min<size_t>(n + 1, LLAMA_JNI_MAX_META_VALUE_BYTES));
+            n = llama_model_meta_val_str_by_index(ctx->model, i, buffer.data(), buffer.size());
+        }
+        std::string value(buffer.data(), std::max(0, std::min<int32_t>(n, static_cast<int32_t>(buffer.size()) - 1)));
+        if (n >= static_cast<int32_t>(buffer.size())) {
+            value += "...";
+        }
+        strings.push_back(std::move(value));
+    }
+}
+
+// Create a context on loaded weights from ContextOptions, with its KV cache, batch and
+// token buffers allocated and reserved against the memory budget; null on failure
+std::shared_ptr<LlamaContext> create_context(JNIEnv* env, const std::shared_ptr<LlamaModel>& weights, jint contextSize, jint threads, jobject options) {
+    // Validate context size
+    if (contextSize <= 0) {
+        contextSize = 2048;  // Default value
+    }
+    
+    // Create new context holding its own reference to the weights
+    auto ctx = std::make_shared<LlamaContext>();
+    ctx->weights = weights;
+    ctx->model = weights->model;
+    
+    // Set up context parameters
+    llama_context_params ctx_params = llama_context_default_params();
+    ctx_params.n_ctx = contextSize;
+    
+    // Prompts are prefilled in chunks of n_batch tokens, each split into n_ubatch-sized compute passes
+    jint batch_size = get_int_field(env, options, "batchSize", 0);
+    jint ubatch_size = get_int_field(env, options, "ubatchSize", 0);
+    ctx_params.n_batch = (batch_size > 0) ? std::min(batch_size, contextSize) : std::max(1, std::min(512, contextSize / 4));
+    ctx_params.n_ubatch = (ubatch_size > 0) ? std::min<uint32_t>(ubatch_size, ctx_params.n_batch) : ctx_params.n_batch;
+    
+    // Parallel sequences (scheduler, batch generation, embeddings) share one unified KV cache of
+    // n_ctx cells; sizing it here avoids recreating the context, and its prefix cache, later
+    jint max_sequences = get_int_field(env, options, "maxSequences", 0);
+    if (max_sequences > 1) {
+        ctx_params.n_seq_max = static_cast<uint32_t>(std::min<size_t>(max_sequences, llama_max_parallel_sequences()));
+        ctx_params.kv_unified = true;
+    }
+    
+    // KV cache precision: a q8_0 cache takes about half the memory of f16
+    ctx_params.type_k = static_cast<enum ggml_type>(
+        get_enum_field(env, options, "typeK", "Lcom/traycer/llama/KvCacheType;", ctx_params.type_k));
+    ctx_params.type_v = static_cast<enum ggml_type>(
+        get_enum_field(env, options, "typeV", "Lcom/traycer/llama/KvCacheType;", ctx_params.type_v));
+    ctx_params.flash_attn_type = static_cast<enum llama_flash_attn_type>(
+        get_enum_field(env, options, "flashAttention", "Lcom/traycer/llama/FlashAttention;", ctx_params.flash_attn_type));
+    ctx_params.offload_kqv = get_bool_field(env, options, "offloadKqv", ctx_params.offload_kqv ? JNI_TRUE : JNI_FALSE) == JNI_TRUE;
+    
+    // llama.cpp can only read a quantized V cache through the flash attention kernel
+    if (ggml_is_quantized(ctx_params.type_v) && ctx_params.flash_attn_type == LLAMA_FLASH_ATTN_TYPE_DISABLED) {
+        std::cerr << "Quantized V cache (" << ggml_type_name(ctx_params.type_v) << ") requires flash attention" << std::endl;
+        return nullptr;
+    }
+    
+    // Optional CPU placement: an explicit CPU list and/or one thread per physical core
+    std::vector<bool> cpu_mask;
+    const std::string cpu_list = get_string_field(env, options, "cpuMask");
+    if (!cpu_list.empty() && !parse_cpu_list(cpu_list, cpu_mask)) {
+        std::cerr << "Invalid cpuMask: " << cpu_list << std::endl;
+        return nullptr;
+    }
+    const bool physical_only = get_bool_field(env, options, "physicalCoresOnly", JNI_FALSE) == JNI_TRUE;
+    const bool strict_cpu = get_bool_field(env, options, "strictCpu", JNI_FALSE) == JNI_TRUE;
+    std::vector<int> cores;
+    if (physical_only) {
+        cores = physical_core_cpus(cpu_mask);
+        if (!cores.empty()) {
+            cpu_mask.assign(GGML_MAX_N_THREADS, false);
+            for (int cpu : cores) {
+                cpu_mask[cpu] = true;
+            }
+        }
+    }
+    
+    // Handle thread count parameter
+    if (threads > 0) {
+        ctx_params.n_threads = threads;
+    } else if (threads == -1) {
+        // Auto-detect threads: every usable CPU, or one per physical core
+        unsigned int hw_threads = !cpu_mask.empty()
+            ? static_cast<unsigned int>(std::count(cpu_mask.begin(), cpu_mask.end(), true))
+            : std::thread::hardware_concurrency();
+        ctx_params.n_threads = (hw_threads > 0) ? hw_threads : 4;
+    } else {
+        // Default to 4 threads if invalid value
+        ctx_params.n_threads = 4;
+    }
+    
+    // Prefill is compute-bound and may use more threads than memory-bound decode
+    jint batch_threads = get_int_field(env, options, "batchThreads", 0);
+    ctx_params.n_threads_batch = (batch_threads > 0) ? batch_threads : ctx_params.n_threads;
+    
+    // Reserve the KV caches before allocating them; the compute buffers are added once
+    // llama.cpp has sized them. The reservation is released if creation fails below.
+    ctx->kv_cell_bytes = kv_cell_bytes(ctx->model, ctx_params);
+    ctx->draft_kv_cell_bytes = (weights->draft != nullptr) ? kv_cell_bytes(weights->draft, ctx_params) : 0;
+    ctx->kv_bytes = (ctx->kv_cell_bytes + ctx->draft_kv_cell_bytes) * ctx_params.n_ctx;
+    if (!ctx->reservation.grow(ctx->kv_bytes)) {
+        std::cerr << "Memory budget exceeded: context needs " << ctx->kv_bytes << " bytes of KV cache" << std::endl;
+        return nullptr;
+    }
+    BufferLog buffers;
+    
+    // Create context using new API
+    ctx->params = ctx_params;
+    ctx->context = init_context_logged(ctx->model, ctx_params, buffers);
+    if (ctx->context == nullptr) {
+        return nullptr;
+    }
+    
+    // Pinned threadpools replace llama.cpp's default unpinned ones
+    if (!cpu_mask.empty() || strict_cpu) {
+        if (cpu_mask.empty()) {
+            cpu_mask.assign(GGML_MAX_N_THREADS, true);
+        }
+        ctx->threadpool = create_threadpool(ctx_params.n_threads, cpu_mask, strict_cpu);
+        ctx->threadpool_batch = (ctx_params.n_threads_batch != ctx_params.n_threads)
+            ? create_threadpool(ctx_params.n_threads_batch, cpu_mask, strict_cpu)
+            : nullptr;
+        if (ctx->threadpool == nullptr || (ctx_params.n_threads_batch != ctx_params.n_threads && ctx->threadpool_batch == nullptr)) {
+            std::cerr << "Failed to create pinned threadpool" << std::endl;
+            return nullptr;
+        }
+        llama_attach_threadpool(ctx->context, ctx->threadpool, ctx->threadpool_batch ? ctx->threadpool_batch : ctx->threadpool);
+    }
+    
+    // Sliding window settings; BOS is always part of the pinned prefix
+    ctx->context_shift = get_bool_field(env, options, "contextShift", JNI_FALSE) == JNI_TRUE;
+    const int add_bos = llama_vocab_get_add_bos(llama_model_get_vocab(ctx->model)) ? 1 : 0;
+    ctx->n_keep = std::min<int>(std::max<int>(get_int_field(env, options, "keepTokens", 0), add_bos), ctx_params.n_ctx / 2);
+    
+    // Reserve space for tokens and allocate the batch buffer reused by every request
+    ctx->tokens.reserve(ctx_params.n_ctx);
+    ctx->kv_cells_total.store(static_cast<int>(ctx_params.n_ctx), std::memory_order_relaxed);
+    ctx->batch = llama_batch_init(ctx_params.n_batch, 0, 1);
+    
+    // The draft context mirrors the target's sequence; each verify step decodes n_draft + 1 tokens
+    if (weights->draft != nullptr) {
+        jint draft_tokens = get_int_field(env, options, "draftTokens", 0);
+        ctx->n_draft = std::min<int>((draft_tokens > 0) ? draft_tokens : LLAMA_JNI_DEFAULT_DRAFT_TOKENS, ctx_params.n_batch - 1);
+        BufferLog draft_buffers;
+        ctx->draft_context = init_context_logged(weights->draft, ctx_params, draft_buffers);
+        if (ctx->draft_context == nullptr) {
+            return nullptr;
+        }
+        if (ctx->threadpool != nullptr) {
+            llama_attach_threadpool(ctx->draft_context, ctx->threadpool, ctx->threadpool_batch ? ctx->threadpool_batch : ctx->threadpool);
+        }
+        ctx->draft_compute_bytes = draft_buffers.compute_bytes;
+    }
+    
+    ctx->compute_bytes = buffers.compute_bytes + ctx->draft_compute_bytes;
+    if (!ctx->reservation.grow(ctx->compute_bytes)) {
+        std::cerr << "Memory budget exceeded: context needs " << ctx->compute_bytes << " bytes of compute buffers" << std::endl;
+        return nullptr;
+    }
+    
+    capture_model_info(ctx.get());
+    ctx->n_seq_max.store(static_cast<int>(llama_n_seq_max(ctx->context)), std::memory_order_relaxed);
+    return ctx;
+}
+
+// A context returned to its pool, reset when it is next acquired rather than on release
+struct PooledContext {
+    std::shared_ptr<LlamaContext> ctx;
+    bool keep_prefix = true;  // keep the cached tokens and their KV for the next holder
+};
+
+// Contexts pre-created on one set of weights and leased out one holder at a time. A
+// leased context is registered in g_contexts under a fresh handle, so every LlamaWrapper
+// call works on it unchanged and a handle kept after release no longer resolves.
+struct ContextPool {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<PooledContext> idle;  // most recently released last
+    std::unordered_map<jlong, std::shared_ptr<LlamaContext>> leased;
+    int64_t seed = -1;                // reseeds each acquired context; negative keeps its generator
+    bool closed = false;
+};
+
+static std::unordered_map<jlong, std::shared_ptr<ContextPool>> g_pools;  // guarded by g_contexts_mutex
+
+std::shared_ptr<ContextPool> get_pool(jlong handle) {
+    std::shared_lock<std::shared_mutex> lock(g_contexts_mutex);
+    auto it = g_pools.find(handle);
+    return (it != g_pools.end()) ? it->second : nullptr;
+}
+
+// Return a released context to the state of a freshly created one, except for the cached
+// prompt when keep_prefix is set. Waits for calls still running on its previous handle.
+void reset_pooled_context(LlamaContext* ctx, bool keep_prefix, int64_t seed) {
+    {
+        std::shared_lock<std::shared_mutex> lock(ctx->exec_mutex);
+        if (ctx->scheduler) {
+            ctx->scheduler->stop();
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+    ctx->scheduler.reset();
+    
+    // KV computed with the previous holder's adapters does not match the base weights
+    if (!ctx->adapters.empty()) {
+        ctx->adapters.clear();
+        ctx->n_adapters.store(0, std::memory_order_relaxed);
+        llama_clear_adapter_lora(ctx->context);
+        keep_prefix = false;
+    }
+    if (!keep_prefix) {
+        invalidate_cache(ctx);
+    }
+    
+    // Snapshots and their settings belong to the previous holder
+    ctx->sessions.entries.clear();
+    ctx->sessions.index.clear();
+    ctx->sessions.used_bytes = 0;
+    ctx->sessions.max_bytes = LLAMA_JNI_DEFAULT_STATE_CACHE_BYTES;
+    ctx->sessions.spill_dir.clear();
+    if (seed >= 0) {
+        std::lock_guard<std::mutex> rng_lock(ctx->rng_mutex);
+        ctx->rng.seed(static_cast<std::mt19937::result_type>(seed));
+    }
+    publish_kv_usage(ctx);
+}
+
+extern "C" {
+
+// Cache the JVM and the classes used to complete futures from native threads
+JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM* vm, void* reserved) {
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    g_jvm = vm;
+    
+    jclass exception_class = env->FindClass("java/lang/RuntimeException");
+    jclass future_class = env->FindClass("java/util/concurrent/CompletableFuture");
+    if (exception_class == nullptr || future_class == nullptr) {
+        return JNI_ERR;
+    }
+    
+    g_runtime_exception_class = static_cast<jclass>(env->NewGlobalRef(exception_class));
+    g_runtime_exception_init = env->GetMethodID(exception_class, "<init>", "(Ljava/lang/String;)V");
+    g_future_complete = env->GetMethodID(future_class, "complete", "(Ljava/lang/Object;)Z");
+    g_future_complete_exceptionally = env->GetMethodID(future_class, "completeExceptionally", "(Ljava/lang/Throwable;)Z");
+    g_future_is_done = env->GetMethodID(future_class, "isDone", "()Z");
+    env->DeleteLocalRef(exception_class);
+    env->DeleteLocalRef(future_class);
+    
+    if (g_runtime_exception_init == nullptr || g_future_complete == nullptr ||
+        g_future_complete_exceptionally == nullptr || g_future_is_done == nullptr) {
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_6;
+}
+
+// Load model weights from file path - matches exactly: LlamaModel.nativeLoadModel(modelPath: String): Long
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_LlamaModel_nativeLoadModel(JNIEnv* env, jobject thiz, jstring modelPath, jstring draftModelPath, jobject options) {
+    try {
+        // Initialize backend if not already done (thread-safe)
+        {
+            std::lock_guard<std::mutex> init_lock(g_init_mutex);
+            init_backend_locked();
+        }
+        
+        // Validate input parameters
+        if (env == nullptr || modelPath == nullptr) {
+            return 0;
+        }
+        
+        std::string path = jstring_to_string(env, modelPath);
+        if (path.empty()) {
+            return 0;
+        }
+        
+        auto weights = std::make_shared<LlamaModel>();
+        weights->path = path;
+        
+        // Set up model parameters from ModelLoadOptions; a null object keeps the defaults
+        llama_model_params model_params = llama_model_default_params();
+        model_params.use_mmap = get_bool_field(env, options, "useMmap", JNI_TRUE) == JNI_TRUE;
+        model_params.use_mlock = get_bool_field(env, options, "useMlock", JNI_FALSE) == JNI_TRUE;
+        model_params.check_tensors = get_bool_field(env, options, "checkTensors", JNI_FALSE) == JNI_TRUE;
+        weights->use_mmap = model_params.use_mmap;
+        
+        jint gpu_layers = get_int_field(env, options, "gpuLayers", -1);
+        if (gpu_layers >= 0) {
+            model_params.n_gpu_layers = gpu_layers;
+        }
+        model_params.main_gpu = get_int_field(env, options, "mainGpu", model_params.main_gpu);
+        model_params.split_mode = static_cast<enum llama_split_mode>(
+            get_enum_field(env, options, "splitMode", "Lcom/traycer/llama/SplitMode;", model_params.split_mode));
+        
+        // llama.cpp reads one proportion per device
+        std::vector<float> tensor_split;
+        if (get_float_array_field(env, options, "tensorSplit", tensor_split)) {
+            tensor_split.resize(llama_max_devices(), 0.0f);
+            model_params.tensor_split = tensor_split.data();
+        }
+        
+        // Report load progress to the JVM listener; returning false aborts the load
+        struct ProgressState {
+            JNIEnv* env;
+            jobject listener;
+            jmethodID on_progress;
+        } progress{env, nullptr, nullptr};
+        jfieldID listener_field = find_field(env, options, "progressListener", "Lcom/traycer/llama/LoadProgressListener;");
+        if (listener_field != nullptr) {
+            progress.listener = env->GetObjectField(options, listener_field);
+        }
+        if (progress.listener != nullptr) {
+            jclass listener_class = env->GetObjectClass(progress.listener);
+            progress.on_progress = env->GetMethodID(listener_class, "onProgress", "(F)Z");
+            env->DeleteLocalRef(listener_class);
+            if (progress.on_progress == nullptr) {
+                env->ExceptionClear();
+            }
+        }
+        if (progress.on_progress != nullptr) {
+            model_params.progress_callback = [](float value, void* user_data) {
+                auto* state = static_cast<ProgressState*>(user_data);
+                // A listener exception stops the load and is rethrown once control returns to the JVM
+                if (state->env->ExceptionCheck()) {
+                    return false;
+                }
+                jboolean keep_going = state->env->CallBooleanMethod(state->listener, state->on_progress, static_cast<jfloat>(value));
+                return !state->env->ExceptionCheck() && keep_going == JNI_TRUE;
+            };
+            model_params.progress_callback_user_data = &progress;
+        }
+        
+        // Reserve the weights against the memory budget before mapping them
+        weights->draft_path = jstring_to_string(env, draftModelPath);
+        const uint64_t weight_bytes = file_size(path) + (weights->draft_path.empty() ? 0 : file_size(weights->draft_path));
+        if (!weights->reservation.grow(weight_bytes)) {
+            std::cerr << "Memory budget exceeded: " << path << " needs " << weight_bytes << " bytes" << std::endl;
+            return 0;
+        }
+        
+        // Load model using new API
+        weights->model = llama_model_load_from_file(path.c_str(), model_params);
+        if (weights->model == nullptr) {
+            return 0;
+        }
+        
+        // The draft loads with the same placement settings but reports no progress
+        model_params.progress_callback = nullptr;
+        model_params.progress_callback_user_data = nullptr;
+        
+        // Draft tokens are verified by id, so the draft must share the target's vocabulary
+        if (!weights->draft_path.empty()) {
+            weights->draft = llama_model_load_from_file(weights->draft_path.c_str(), model_params);
+            if (weights->draft == nullptr) {
+                return 0;
+            }
+            
+            const auto* vocab = llama_model_get_vocab(weights->model);
+            const auto* draft_vocab = llama_model_get_vocab(weights->draft);
+            if (llama_vocab_type(vocab) != llama_vocab_type(draft_vocab) ||
+                llama_vocab_n_tokens(vocab) != llama_vocab_n_tokens(draft_vocab)) {
+                std::cerr << "Draft model " << weights->draft_path << " does not share the vocabulary of " << path << std::endl;
+                return 0;
+            }
+        }
+        
+        // Store model and return handle (thread-safe)
+        {
+            std::lock_guard<std::shared_mutex> lock(g_contexts_mutex);
+            jlong handle = g_next_handle++;
+            g_models[handle] = std::move(weights);
+            return handle;
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeLoadModel: " << e.what() << std::endl;
+        return 0;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeLoadModel" << std::endl;
+        return 0;
+    }
+}
+
+// Release a model handle - matches exactly: LlamaModel.nativeFreeModel(modelHandle: Long)
+JNIEXPORT void JNICALL
+Java_com_traycer_llama_LlamaModel_nativeFreeModel(JNIEnv* env, jobject thiz, jlong modelHandle) {
+    if (modelHandle == 0) {
+        return;  // Invalid handle, nothing to release
+    }
+    
+    try {
+        // Weights stay mapped until the last context created from them is cleaned up
+        std::lock_guard<std::shared_mutex> lock(g_contexts_mutex);
+        g_models.erase(modelHandle);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeFreeModel: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeFreeModel" << std::endl;
+    }
+}
+
+// Load a LoRA adapter onto shared weights - matches exactly: LlamaModel.nativeLoadAdapter(modelHandle: Long, path: String): Long
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_LlamaModel_nativeLoadAdapter(JNIEnv* env, jobject thiz, jlong modelHandle, jstring path) {
+    if (env == nullptr || path == nullptr || modelHandle == 0) {
+        return 0;
+    }
+    
+    std::shared_ptr<LlamaModel> weights = get_model(modelHandle);
+    if (weights == nullptr) {
+        return 0;
+    }
+    
+    try {
+        return load_adapter(*weights, jstring_to_string(env, path));
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in LlamaModel.nativeLoadAdapter: " << e.what() << std::endl;
+        return 0;
+    } catch (...) {
+        std::cerr << "Unknown exception in LlamaModel.nativeLoadAdapter" << std::endl;
+        return 0;
+    }
+}
+
+// Create a context on loaded weights - matches exactly: nativeCreateContext(modelHandle: Long, contextSize: Int, threads: Int, options: ContextOptions?): Long
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeCreateContext(JNIEnv* env, jobject thiz, jlong modelHandle, jint contextSize, jint threads, jobject options) {
+    try {
+        std::shared_ptr<LlamaModel> weights = get_model(modelHandle);
+        if (weights == nullptr || weights->model == nullptr) {
+            return 0;
+        }
+        
+        std::shared_ptr<LlamaContext> ctx = create_context(env, weights, contextSize, threads, options);
+        if (ctx == nullptr) {
+            return 0;
+        }
+        
+        // Store context and return handle (thread-safe)
+        {
+            std::lock_guard<std::shared_mutex> lock(g_contexts_mutex);
+            jlong handle = g_next_handle++;
+            g_contexts[handle] = std::move(ctx);
+            return handle;
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeCreateContext: " << e.what() << std::endl;
+        return 0;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeCreateContext" << std::endl;
+        return 0;
+    }
+}
+
+// Pre-create a context pool - matches exactly: ContextPool.nativeCreatePool(modelHandle: Long, size: Int, contextSize: Int, threads: Int, options: ContextOptions?, seed: Long): Long
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_ContextPool_nativeCreatePool(JNIEnv* env, jobject thiz, jlong modelHandle, jint size, jint contextSize, jint threads, jobject options, jlong seed) {
+    if (size <= 0) {
+        return 0;
+    }
+    
+    try {
+        std::shared_ptr<LlamaModel> weights = get_model(modelHandle);
+        if (weights == nullptr || weights->model == nullptr) {
+            return 0;
+        }
+        
+        // Every context is created and admitted against the memory budget up front, so
+        // acquiring one later allocates nothing
+        auto pool = std::make_shared<ContextPool>();
+        pool->seed = seed;
+        pool->idle.reserve(size);
+        for (jint i = 0; i < size; i++) {
+            std::shared_ptr<LlamaContext> ctx = create_context(env, weights, contextSize, threads, options);
+            if (ctx == nullptr) {
+                std::cerr << "Failed to create pooled context " << (i + 1) << " of " << size << std::endl;
+                return 0;
+            }
+            pool->idle.push_back(PooledContext{std::move(ctx), false});
+        }
+        
+        std::lock_guard<std::shared_mutex> lock(g_contexts_mutex);
+        jlong handle = g_next_handle++;
+        g_pools[handle] = std::move(pool);
+        return handle;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeCreatePool: " << e.what() << std::endl;
+        return 0;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeCreatePool" << std::endl;
+        return 0;
+    }
+}
+
+// Lease an idle pooled context - matches exactly: ContextPool.nativeAcquire(poolHandle: Long, timeoutMs: Long): Long
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_ContextPool_nativeAcquire(JNIEnv* env, jobject thiz, jlong poolHandle, jlong timeoutMs) {
+    std::shared_ptr<ContextPool> pool = get_pool(poolHandle);
+    if (pool == nullptr) {
+        return 0;
+    }
+    
+    try {
+        PooledContext entry;
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            auto ready = [&] { return pool->closed || !pool->idle.empty(); };
+            if (timeoutMs < 0) {
+                pool->cv.wait(lock, ready);
+            } else if (!pool->cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready)) {
+                return 0;
+            }
+            if (pool->closed) {
+                return 0;
+            }
+            // The most recently released context is the likeliest to still be cache-warm
+            entry = std::move(pool->idle.back());
+            pool->idle.pop_back();
+        }
+        
+        // Reset outside the pool lock: it may wait for calls on the previous handle
+        reset_pooled_context(entry.ctx.get(), entry.keep_prefix, pool->seed);
+        
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        if (pool->closed) {
+            return 0;  // Freed with the pool
+        }
+        std::lock_guard<std::shared_mutex> contexts_lock(g_contexts_mutex);
+        jlong handle = g_next_handle++;
+        g_contexts[handle] = entry.ctx;
+        pool->leased[handle] = std::move(entry.ctx);
+        return handle;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeAcquire: " << e.what() << std::endl;
+        return 0;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeAcquire" << std::endl;
+        return 0;
+    }
+}
+
+// Return a leased context to its pool - matches exactly: ContextPool.nativeRelease(poolHandle: Long, handle: Long, keepPrefix: Boolean): Boolean
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_ContextPool_nativeRelease(JNIEnv* env, jobject thiz, jlong poolHandle, jlong handle, jboolean keepPrefix) {
+    std::shared_ptr<ContextPool> pool = get_pool(poolHandle);
+    if (pool == nullptr) {
+        return JNI_FALSE;
+    }
+    
+    try {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        auto it = pool->leased.find(handle);
+        if (pool->closed || it == pool->leased.end()) {
+            return JNI_FALSE;
+        }
+        
+        // Unregistering the handle is all release does; the reset waits for the next acquire.
+        // Calls still running on the handle keep the context pinned until they return.
+        {
+            std::lock_guard<std::shared_mutex> contexts_lock(g_contexts_mutex);
+            g_contexts.erase(handle);
+        }
+        pool->idle.push_back(PooledContext{std::move(it->second), keepPrefix == JNI_TRUE});
+        pool->leased.erase(it);
+        pool->cv.notify_one();
+        return JNI_TRUE;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeRelease: " << e.what() << std::endl;
+        return JNI_FALSE;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeRelease" << std::endl;
+        return JNI_FALSE;
+    }
+}
+
+// Count idle pooled contexts - matches exactly: ContextPool.nativeIdleCount(poolHandle: Long): Int
+JNIEXPORT jint JNICALL
+Java_com_traycer_llama_ContextPool_nativeIdleCount(JNIEnv* env, jobject thiz, jlong poolHandle) {
+    std::shared_ptr<ContextPool> pool = get_pool(poolHandle);
+    if (pool == nullptr) {
+        return 0;
+    }
+    
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    return static_cast<jint>(pool->idle.size());
+}
+
+// Free a context pool - matches exactly: ContextPool.nativeFreePool(poolHandle: Long)
+JNIEXPORT void JNICALL
+Java_com_traycer_llama_ContextPool_nativeFreePool(JNIEnv* env, jobject thiz, jlong poolHandle) {
+    if (poolHandle == 0) {
+        return;  // Invalid handle, nothing to free
+    }
+    
+    try {
+        std::shared_ptr<ContextPool> pool;
+        {
+            std::lock_guard<std::shared_mutex> lock(g_contexts_mutex);
+            auto it = g_pools.find(poolHandle);
+            if (it == g_pools.end()) {
+                return;
+            }
+            pool = std::move(it->second);
+            g_pools.erase(it);
+        }
+        
+        // Idle contexts are freed here; leased ones stay registered and are freed by their
+        // holder's nativeCleanup, as release now fails. Waiting acquires return 0.
+        std::vector<PooledContext> idle;
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->closed = true;
+            pool->leased.clear();
+            idle.swap(pool->idle);
+        }
+        pool->cv.notify_all();
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeFreePool: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeFreePool" << std::endl;
+    }
+}
+
+// Generate text - matches exactly: nativeGenerateText(handle: Long, prompt: String, maxTokens: Int, temperature: Float, topP: Float, topK: Int, constraints: GenerationConstraints?): String?
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateText(JNIEnv* env, jobject thiz, jlong handle, jstring prompt, jint maxTokens, jfloat temperature, jfloat topP, jint topK, jobject constraints) {
+    // Validate input parameters
+    if (env == nullptr || prompt == nullptr || handle == 0) {
+        return string_to_jstring(env, "Error: Invalid parameters");
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return string_to_jstring(env, "Error: Invalid handle or model not loaded");
+    }
+    
+    try {
+        std::string input = jstring_to_string(env, prompt);
+        if (input.empty()) {
+            return string_to_jstring(env, "Error: Empty prompt");
+        }
+        
+        std::string result;
+        GenerationParams params = make_generation_params(env, ctx.get(), maxTokens, temperature, topP, topK, constraints);
+        std::string error = generate(ctx.get(), input, params, [&result](std::string_view piece) {
+            result += piece;
+            return true;
+        });
+        if (!error.empty()) {
+            return string_to_jstring(env, error);
+        }
+        
+        return string_to_jstring(env, result);
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeGenerateText: " << e.what() << std::endl;
+        return string_to_jstring(env, "Error: Exception during text generation");
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeGenerateText" << std::endl;
+        return string_to_jstring(env, "Error: Unknown exception during text generation");
+    }
+}
+
+// Generate text and report its timings - matches exactly: nativeGenerateWithStats(handle: Long, prompt: String, maxTokens: Int, temperature: Float, topP: Float, topK: Int, constraints: GenerationConstraints?, stats: DoubleArray): String?
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateWithStats(JNIEnv* env, jobject thiz, jlong handle, jstring prompt, jint maxTokens, jfloat temperature, jfloat topP, jint topK, jobject constraints, jdoubleArray stats) {
+    // Validate input parameters
+    if (env == nullptr || prompt == nullptr || stats == nullptr || handle == 0 ||
+        env->GetArrayLength(stats) < LLAMA_JNI_STAT_COUNT) {
+        return throw_runtime_exception(env, "Error: Invalid parameters");
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return throw_runtime_exception(env, "Error: Invalid handle or model not loaded");
+    }
+    
+    try {
+        std::string input = jstring_to_string(env, prompt);
+        if (input.empty()) {
+            return throw_runtime_exception(env, "Error: Empty prompt");
+        }
+        
+        std::string result;
+        GenerationStats gen_stats;
+        GenerationParams params = make_generation_params(env, ctx.get(), maxTokens, temperature, topP, topK, constraints);
+        std::string error = generate(ctx.get(), input, params, [&result](std::string_view piece) {
+            result += piece;
+            return true;
+        }, &gen_stats);
+        if (!error.empty()) {
+            return throw_runtime_exception(env, error);
+        }
+        
+        jdouble values[LLAMA_JNI_STAT_COUNT];
+        values[LLAMA_JNI_STAT_PROMPT_TOKENS] = gen_stats.prompt_tokens;
+        values[LLAMA_JNI_STAT_CACHED_TOKENS] = gen_stats.cached_tokens;
+        values[LLAMA_JNI_STAT_GENERATED_TOKENS] = gen_stats.generated_tokens;
+        values[LLAMA_JNI_STAT_QUEUE_MS] = gen_stats.queue_ms;
+        values[LLAMA_JNI_STAT_TOKENIZE_MS] = gen_stats.tokenize_ms;
+        values[LLAMA_JNI_STAT_PREFILL_MS] = gen_stats.prefill_ms;
+        values[LLAMA_JNI_STAT_TTFT_MS] = gen_stats.ttft_ms;
+        values[LLAMA_JNI_STAT_DECODE_MS] = gen_stats.decode_ms;
+        values[LLAMA_JNI_STAT_TOTAL_MS] = gen_stats.total_ms;
+        values[LLAMA_JNI_STAT_KV_USED] = gen_stats.kv_used;
+        values[LLAMA_JNI_STAT_KV_SIZE] = gen_stats.kv_size;
+        values[LLAMA_JNI_STAT_DRAFT_ROUNDS] = gen_stats.draft_rounds;
+        values[LLAMA_JNI_STAT_DRAFT_TOKENS] = gen_stats.draft_tokens;
+        values[LLAMA_JNI_STAT_DRAFT_ACCEPTED] = gen_stats.draft_accepted;
+        values[LLAMA_JNI_STAT_DISCARDED_TOKENS] = gen_stats.discarded_tokens;
+        values[LLAMA_JNI_STAT_PREEMPTIONS] = gen_stats.preemptions;
+        env->SetDoubleArrayRegion(stats, 0, LLAMA_JNI_STAT_COUNT, values);
+        
+        return string_to_jstring(env, result);
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeGenerateWithStats: " << e.what() << std::endl;
+        return throw_runtime_exception(env, "Error: Exception during text generation");
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeGenerateWithStats" << std::endl;
+        return throw_runtime_exception(env, "Error: Unknown exception during text generation");
+    }
+}
+
+// Stream generated text - matches exactly: nativeGenerateStream(handle: Long, prompt: String, maxTokens: Int, temperature: Float, topP: Float, topK: Int, constraints: GenerationConstraints?, listener: TokenListener): String?
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateStream(JNIEnv* env, jobject thiz, jlong handle, jstring prompt, jint maxTokens, jfloat temperature, jfloat topP, jint topK, jobject constraints, jobject listener) {
+    // Validate input parameters
+    if (env == nullptr || prompt == nullptr || listener == nullptr || handle == 0) {
+        return string_to_jstring(env, "Error: Invalid parameters");
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return string_to_jstring(env, "Error: Invalid handle or model not loaded");
+    }
+    
+    try {
+        std::string input = jstring_to_string(env, prompt);
+        if (input.empty()) {
+            return string_to_jstring(env, "Error: Empty prompt");
+        }
+        
+        jclass listener_class = env->GetObjectClass(listener);
+        jmethodID on_token = env->GetMethodID(listener_class, "onToken", "(Ljava/lang/String;)Z");
+        env->DeleteLocalRef(listener_class);
+        if (on_token == nullptr) {
+            return string_to_jstring(env, "Error: Listener does not implement onToken");
+        }
+        
+        bool listener_failed = false;
+        GenerationParams params = make_generation_params(env, ctx.get(), maxTokens, temperature, topP, topK, constraints);
+        std::string error = generate(ctx.get(), input, params, [&](std::string_view piece) {
+            jstring jpiece = string_to_jstring(env, piece);
+            if (jpiece == nullptr) {
+                listener_failed = true;
+                return false;
+            }
+            
+            jboolean keep_going = env->CallBooleanMethod(listener, on_token, jpiece);
+            env->DeleteLocalRef(jpiece);
+            
+            // Stop on a listener exception; it is rethrown once control returns to the JVM
+            if (env->ExceptionCheck()) {
+                listener_failed = true;
+                return false;
+            }
+            return keep_going == JNI_TRUE;
+        });
+        
+        // A pending listener exception takes precedence over the error message
+        if (!listener_failed && !error.empty()) {
+            return string_to_jstring(env, error);
+        }
+        return nullptr;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeGenerateStream: " << e.what() << std::endl;
+        return string_to_jstring(env, "Error: Exception during text generation");
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeGenerateStream" << std::endl;
+        return string_to_jstring(env, "Error: Unknown exception during text generation");
+    }
+}
+
+// Generate text between direct buffers - matches exactly: nativeGenerateDirect(handle: Long, prompt: ByteBuffer, promptOffset: Int, promptLength: Int, output: ByteBuffer, outputOffset: Int, outputCapacity: Int, maxTokens: Int, temperature: Float, topP: Float, topK: Int, constraints: GenerationConstraints?, status: IntArray): Int
+JNIEXPORT jint JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateDirect(JNIEnv* env, jobject thiz, jlong handle, jobject prompt, jint promptOffset, jint promptLength,
+                                                         jobject output, jint outputOffset, jint outputCapacity,
+                                                         jint maxTokens, jfloat temperature, jfloat topP, jint topK, jobject constraints,
+                                                         jintArray status) {
+    // Validate input parameters
+    if (env == nullptr || prompt == nullptr || output == nullptr || status == nullptr || handle == 0 ||
+        promptOffset < 0 || promptLength <= 0 || outputOffset < 0 || outputCapacity < 0 ||
+        env->GetArrayLength(status) < 1) {
+        return -LLAMA_JNI_ERR_INVALID_PARAMS;
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return -LLAMA_JNI_ERR_INVALID_HANDLE;
+    }
+    
+    try {
+        // UTF-8 bytes are read and written in place: no jstring, no intermediate std::string
+        const char* prompt_bytes = static_cast<const char*>(env->GetDirectBufferAddress(prompt));
+        char* output_bytes = static_cast<char*>(env->GetDirectBufferAddress(output));
+        if (prompt_bytes == nullptr || output_bytes == nullptr ||
+            promptOffset + static_cast<jlong>(promptLength) > env->GetDirectBufferCapacity(prompt) ||
+            outputOffset + static_cast<jlong>(outputCapacity) > env->GetDirectBufferCapacity(output)) {
+            return -LLAMA_JNI_ERR_INVALID_PARAMS;
+        }
+        
+        std::string_view input(prompt_bytes + promptOffset, promptLength);
+        char* out = output_bytes + outputOffset;
+        size_t written = 0;
+        bool truncated = false;
+        
+        GenerationParams params = make_generation_params(env, ctx.get(), maxTokens, temperature, topP, topK, constraints);
+        std::string error = generate(ctx.get(), input, params, [&](std::string_view piece) {
+            // Stop once the next chunk no longer fits; output always ends on a whole character
+            if (written + piece.size() > static_cast<size_t>(outputCapacity)) {
+                truncated = true;
+                return false;
+            }
+            std::memcpy(out + written, piece.data(), piece.size());
+            written += piece.size();
+            return true;
+        });
+        
+        if (!error.empty()) {
+            std::cerr << "nativeGenerateDirect: " << error << std::endl;
+            return -LLAMA_JNI_ERR_GENERATION_FAILED;
+        }
+        
+        const jint direct_status = truncated ? LLAMA_JNI_DIRECT_TRUNCATED : LLAMA_JNI_DIRECT_COMPLETE;
+        env->SetIntArrayRegion(status, 0, 1, &direct_status);
+        return static_cast<jint>(written);
+        
+    } catch (const std::bad_alloc&) {
+        return -LLAMA_JNI_ERR_OUT_OF_MEMORY;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeGenerateDirect: " << e.what() << std::endl;
+        return -LLAMA_JNI_ERR_GENERATION_FAILED;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeGenerateDirect" << std::endl;
+        return -LLAMA_JNI_ERR_GENERATION_FAILED;
+    }
+}
+
+// Generate several prompts in one call - matches exactly: nativeGenerateBatch(handle: Long, prompts: Array<String>, maxTokens: Int, temperature: Float, topP: Float, topK: Int, constraints: GenerationConstraints?, results: Array<String?>): String?
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateBatch(JNIEnv* env, jobject thiz, jlong handle, jobjectArray prompts, jint maxTokens, jfloat temperature,
+                                                        jfloat topP, jint topK, jobject constraints, jobjectArray results) {
+    // Validate input parameters
+    if (env == nullptr || prompts == nullptr || results == nullptr || handle == 0 ||
+        env->GetArrayLength(results) < env->GetArrayLength(prompts)) {
+        return string_to_jstring(env, "Error: Invalid parameters");
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return string_to_jstring(env, "Error: Invalid handle or model not loaded");
+    }
+    
+    try {
+        const jsize n_prompts = env->GetArrayLength(prompts);
+        std::vector<std::string> inputs;
+        inputs.reserve(n_prompts);
+        for (jsize i = 0; i < n_prompts; i++) {
+            jstring prompt = static_cast<jstring>(env->GetObjectArrayElement(prompts, i));
+            inputs.push_back(jstring_to_string(env, prompt));
+            env->DeleteLocalRef(prompt);
+            if (inputs.back().empty()) {
+                return string_to_jstring(env, "Error: Empty prompt at index " + std::to_string(i));
+            }
+        }
+        if (inputs.empty()) {
+            return nullptr;
+        }
+        
+        std::vector<std::string> outputs;
+        GenerationParams params = make_generation_params(env, ctx.get(), maxTokens, temperature, topP, topK, constraints);
+        std::string error = generate_batch(ctx.get(), inputs, params, outputs);
+        if (!error.empty()) {
+            return string_to_jstring(env, error);
+        }
+        
+        for (jsize i = 0; i < n_prompts; i++) {
+            jstring text = string_to_jstring(env, outputs[i]);
+            env->SetObjectArrayElement(results, i, text);
+            env->DeleteLocalRef(text);
+        }
+        return nullptr;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeGenerateBatch: " << e.what() << std::endl;
+        return string_to_jstring(env, "Error: Exception during text generation");
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeGenerateBatch" << std::endl;
+        return string_to_jstring(env, "Error: Unknown exception during text generation");
+    }
+}
+
+// Tokenize text - matches exactly: nativeTokenize(handle: Long, text: String, addBos: Boolean): IntArray?
+JNIEXPORT jintArray JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeTokenize(JNIEnv* env, jobject thiz, jlong handle, jstring text, jboolean addBos) {
+    if (env == nullptr || text == nullptr || handle == 0) {
+        return nullptr;
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (ctx == nullptr || ctx->model == nullptr) {
+        return nullptr;
+    }
+    
+    try {
+        std::vector<llama_token> tokens;
+        if (!tokenize_text(llama_model_get_vocab(ctx->model), jstring_to_string(env, text), tokens, addBos == JNI_TRUE)) {
+            return nullptr;
+        }
+        
+        jintArray result = env->NewIntArray(static_cast<jsize>(tokens.size()));
+        if (result != nullptr) {
+            env->SetIntArrayRegion(result, 0, static_cast<jsize>(tokens.size()), tokens.data());
+        }
+        return result;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeTokenize: " << e.what() << std::endl;
+        return nullptr;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeTokenize" << std::endl;
+        return nullptr;
+    }
+}
+
+// Convert token IDs back to text - matches exactly: nativeDetokenize(handle: Long, tokens: IntArray): String?
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeDetokenize(JNIEnv* env, jobject thiz, jlong handle, jintArray tokens) {
+    if (env == nullptr || tokens == nullptr || handle == 0) {
+        return nullptr;
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (ctx == nullptr || ctx->model == nullptr) {
+        return nullptr;
+    }
+    
+    try {
+        const auto* vocab = llama_model_get_vocab(ctx->model);
+        const jsize n_tokens = env->GetArrayLength(tokens);
+        std::string text;
+        
+        // Read the IDs in place; nothing inside the critical section calls back into the JVM
+        jint* ids = static_cast<jint*>(env->GetPrimitiveArrayCritical(tokens, nullptr));
+        if (ids == nullptr) {
+            return nullptr;
+        }
+        const llama_token n_vocab = llama_vocab_n_tokens(vocab);
+        bool valid = std::all_of(ids, ids + n_tokens, [n_vocab](jint id) { return id >= 0 && id < n_vocab; });
+        int32_t n_chars = 0;
+        if (valid) {
+            // On a short buffer llama_detokenize returns -needed
+            text.resize(static_cast<size_t>(n_tokens) * 4);
+            n_chars = llama_detokenize(vocab, ids, n_tokens, text.data(), static_cast<int32_t>(text.size()), false, false);
+            if (n_chars < 0) {
+                text.resize(-n_chars);
+                n_chars = llama_detokenize(vocab, ids, n_tokens, text.data(), static_cast<int32_t>(text.size()), false, false);
+            }
+        }
+        env->ReleasePrimitiveArrayCritical(tokens, ids, JNI_ABORT);
+        
+        if (!valid || n_chars < 0) {
+            return nullptr;
+        }
+        text.resize(n_chars);
+        return string_to_jstring(env, text);
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeDetokenize: " << e.what() << std::endl;
+        return nullptr;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeDetokenize" << std::endl;
+        return nullptr;
+    }
+}
+
+// Generate text from token IDs - matches exactly: nativeGenerateTokens(handle: Long, tokens: IntArray, maxTokens: Int, temperature: Float, topP: Float, topK: Int, constraints: GenerationConstraints?): String?
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateTokens(JNIEnv* env, jobject thiz, jlong handle, jintArray tokens, jint maxTokens, jfloat temperature,
+                                                         jfloat topP, jint topK, jobject constraints) {
+    // Validate input parameters
+    if (env == nullptr || tokens == nullptr || handle == 0) {
+        return string_to_jstring(env, "Error: Invalid parameters");
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return string_to_jstring(env, "Error: Invalid handle or model not loaded");
+    }
+    
+    try {
+        // One bulk copy; generation itself may block far too long for a critical section
+        std::vector<llama_token> input(env->GetArrayLength(tokens));
+        if (input.empty()) {
+            return string_to_jstring(env, "Error: Empty prompt");
+        }
+        jint* ids = static_cast<jint*>(env->GetPrimitiveArrayCritical(tokens, nullptr));
+        if (ids == nullptr) {
+            return string_to_jstring(env, "Error: Invalid parameters");
+        }
+        std::memcpy(input.data(), ids, input.size() * sizeof(llama_token));
+        env->ReleasePrimitiveArrayCritical(tokens, ids, JNI_ABORT);
+        
+        std::string result;
+        GenerationParams params = make_generation_params(env, ctx.get(), maxTokens, temperature, topP, topK, constraints);
+        std::string error = generate(ctx.get(), input, params, [&result](std::string_view piece) {
+            result += piece;
+            return true;
+        });
+        if (!error.empty()) {
+            return string_to_jstring(env, error);
+        }
+        
+        return string_to_jstring(env, result);
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeGenerateTokens: " << e.what() << std::endl;
+        return string_to_jstring(env, "Error: Exception during text generation");
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeGenerateTokens" << std::endl;
+        return string_to_jstring(env, "Error: Unknown exception during text generation");
+    }
+}
+
+// Load a LoRA adapter onto the context's weights - matches exactly: nativeLoadAdapter(handle: Long, path: String): Long
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeLoadAdapter(JNIEnv* env, jobject thiz, jlong handle, jstring path) {
+    if (env == nullptr || path == nullptr || handle == 0) {
+        return 0;
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (ctx == nullptr || ctx->weights == nullptr) {
+        return 0;
+    }
+    
+    try {
+        return load_adapter(*ctx->weights, jstring_to_string(env, path));
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeLoadAdapter: " << e.what() << std::endl;
+        return 0;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeLoadAdapter" << std::endl;
+        return 0;
+    }
+}
+
+// Select the LoRA adapters applied to a context - matches exactly: nativeSetAdapters(handle: Long, adapters: LongArray, scales: FloatArray): Boolean
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSetAdapters(JNIEnv* env, jobject thiz, jlong handle, jlongArray adapters, jfloatArray scales) {
+    if (env == nullptr || adapters == nullptr || scales == nullptr || handle == 0 ||
+        env->GetArrayLength(adapters) != env->GetArrayLength(scales)) {
+        return JNI_FALSE;
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get()) || ctx->weights == nullptr) {
+        return JNI_FALSE;
+    }
+    
+    try {
+        const jsize n_adapters = env->GetArrayLength(adapters);
+        std::vector<jlong> handles(n_adapters);
+        std::vector<jfloat> weights(n_adapters);
+        env->GetLongArrayRegion(adapters, 0, n_adapters, handles.data());
+        env->GetFloatArrayRegion(scales, 0, n_adapters, weights.data());
+        
+        // Only adapters loaded on this context's weights can be applied
+        std::vector<std::pair<llama_adapter_lora*, float>> selected;
+        {
+            std::lock_guard<std::mutex> lock(ctx->weights->adapters_mutex);
+            for (jsize i = 0; i < n_adapters; i++) {
+                auto it = ctx->weights->adapters.find(handles[i]);
+                if (it == ctx->weights->adapters.end()) {
+                    return JNI_FALSE;
+                }
+                selected.emplace_back(it->second, weights[i]);
+            }
+        }
+        
+        std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+        if (ctx->scheduler) {
+            return JNI_FALSE;  // Adapters apply to every sequence, so they cannot change under running requests
+        }
+        if (selected == ctx->adapters) {
+            return JNI_TRUE;   // Same adapters: keep the KV cache
+        }
+        
+        ctx->adapters = std::move(selected);
+        bool applied = apply_adapters(ctx.get());
+        if (!applied) {
+            ctx->adapters.clear();
+            llama_clear_adapter_lora(ctx->context);
+        }
+        ctx->n_adapters.store(static_cast<int>(ctx->adapters.size()), std::memory_order_relaxed);
+        
+        // KV computed with other adapters would not match the new weights
+        ctx->tokens.clear();
+        llama_memory_clear(llama_get_memory(ctx->context), true);
+        publish_kv_usage(ctx.get());
+        return applied ? JNI_TRUE : JNI_FALSE;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeSetAdapters: " << e.what() << std::endl;
+        return JNI_FALSE;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeSetAdapters" << std::endl;
+        return JNI_FALSE;
+    }
+}
+
+// Snapshot the process metrics - matches exactly: nativeGetMetrics(): DoubleArray? (static)
+JNIEXPORT jdoubleArray JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGetMetrics(JNIEnv* env, jclass clazz) {
+    if (env == nullptr) {
+        return nullptr;
+    }
+    
+    try {
+        std::vector<jdouble> values(LLAMA_JNI_METRIC_COUNT);
+        values[LLAMA_JNI_METRIC_DECODE_CALLS] = g_metrics.decode_calls.load(std::memory_order_relaxed);
+        values[LLAMA_JNI_METRIC_DECODE_TOKENS] = g_metrics.decode_tokens.load(std::memory_order_relaxed);
+        values[LLAMA_JNI_METRIC_DECODE_FAILURES] = g_metrics.decode_failures.load(std::memory_order_relaxed);
+        values[LLAMA_JNI_METRIC_PROMPT_TOKENS] = g_metrics.prompt_tokens.load(std::memory_order_relaxed);
+        values[LLAMA_JNI_METRIC_CACHED_TOKENS] = g_metrics.cached_tokens.load(std::memory_order_relaxed);
+        values[LLAMA_JNI_METRIC_GENERATED_TOKENS] = g_metrics.generated_tokens.load(std::memory_order_relaxed);
+        values[LLAMA_JNI_METRIC_REQUESTS] = g_metrics.requests.load(std::memory_order_relaxed);
+        values[LLAMA_JNI_METRIC_REQUEST_ERRORS] = g_metrics.request_errors.load(std::memory_order_relaxed);
+        values[LLAMA_JNI_METRIC_PREEMPTIONS] = g_metrics.preemptions.load(std::memory_order_relaxed);
+        values[LLAMA_JNI_METRIC_QUEUE_DEPTH] = g_metrics.queue_depth.load(std::memory_order_relaxed);
+        values[LLAMA_JNI_METRIC_ACTIVE_SEQUENCES] = g_metrics.active_sequences.load(std::memory_order_relaxed);
+        
+        // Handle counts and KV occupancy come from the handle tables; contexts publish
+        // their occupancy atomically, so their exec_mutex is not needed
+        {
+            std::shared_lock<std::shared_mutex> lock(g_contexts_mutex);
+            for (const auto& entry : g_contexts) {
+                values[LLAMA_JNI_METRIC_KV_CELLS_USED] += entry.second->kv_cells_used.load(std::memory_order_relaxed);
+                values[LLAMA_JNI_METRIC_KV_CELLS_TOTAL] += entry.second->kv_cells_total.load(std::memory_order_relaxed);
+            }
+            values[LLAMA_JNI_METRIC_CONTEXTS] = static_cast<jdouble>(g_contexts.size());
+            values[LLAMA_JNI_METRIC_MODELS] = static_cast<jdouble>(g_models.size());
+        }
+        TraceBuffer* trace = g_trace.load(std::memory_order_acquire);
+        values[LLAMA_JNI_METRIC_TRACE_EVENTS] = (trace != nullptr) ? trace->next.load(std::memory_order_relaxed) : 0;
+        
+        // Histograms follow in LLAMA_JNI_HISTOGRAM_* order, each self-describing:
+        // bound count n, n bounds, n + 1 bucket counts (the last is +Inf), sum, count
+        for (const Histogram* histogram : {&g_metrics.decode_us, &g_metrics.batch_fill_pct,
+                                           &g_metrics.queue_wait_us, &g_metrics.jni_marshal_ns,
+                                           &g_metrics.draft_decode_us}) {
+            const size_t n = histogram->bounds.size();
+            values.push_back(static_cast<jdouble>(n));
+            for (uint64_t bound : histogram->bounds) {
+                values.push_back(bound * histogram->scale);
+            }
+            for (size_t i = 0; i <= n; i++) {
+                values.push_back(static_cast<jdouble>(histogram->buckets[i].load(std::memory_order_relaxed)));
+            }
+            values.push_back(histogram->sum.load(std::memory_order_relaxed) * histogram->scale);
+            values.push_back(static_cast<jdouble>(histogram->count.load(std::memory_order_relaxed)));
+        }
+        
+        jdoubleArray result = env->NewDoubleArray(static_cast<jsize>(values.size()));
+        if (result != nullptr) {
+            env->SetDoubleArrayRegion(result, 0, static_cast<jsize>(values.size()), values.data());
+        }
+        return result;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeGetMetrics: " << e.what() << std::endl;
+        return nullptr;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeGetMetrics" << std::endl;
+        return nullptr;
+    }
+}
+
+// Enable or disable trace recording - matches exactly: nativeSetTracing(enabled: Boolean): Boolean (static)
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSetTracing(JNIEnv* env, jclass clazz, jboolean enabled) {
+    try {
+        if (enabled == JNI_TRUE && g_trace.load(std::memory_order_acquire) == nullptr) {
+            std::lock_guard<std::mutex> init_lock(g_init_mutex);
+            if (g_trace.load(std::memory_order_acquire) == nullptr) {
+                g_trace.store(new TraceBuffer(), std::memory_order_release);
+            }
+        }
+        g_trace_enabled.store(enabled == JNI_TRUE, std::memory_order_relaxed);
+        return JNI_TRUE;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeSetTracing: " << e.what() << std::endl;
+        return JNI_FALSE;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeSetTracing" << std::endl;
+        return JNI_FALSE;
+    }
+}
+
+// Dump the trace ring buffer as Chrome trace JSON - matches exactly: nativeDumpTrace(clear: Boolean): String? (static)
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeDumpTrace(JNIEnv* env, jclass clazz, jboolean clear) {
+    if (env == nullptr) {
+        return nullptr;
+    }
+    
+    try {
+        struct Event {
+            const char* name;
+            char phase;
+            int64_t ts_us;
+            int64_t dur_us;
+            uint32_t tid;
+            const char* arg_names[2];
+            int64_t args[2];
+        };
+        std::vector<Event> events;
+        
+        TraceBuffer* trace = g_trace.load(std::memory_order_acquire);
+        if (trace != nullptr) {
+            const uint64_t end = trace->next.load(std::memory_order_acquire);
+            const uint64_t first = std::max<uint64_t>(trace->first.load(std::memory_order_relaxed),
+                                                      (end > LLAMA_JNI_TRACE_EVENTS) ? end - LLAMA_JNI_TRACE_EVENTS : 0);
+            events.reserve(end - first);
+            for (uint64_t index = first; index < end; index++) {
+                const TraceEvent& slot = trace->events[index % LLAMA_JNI_TRACE_EVENTS];
+                
+                // Skip slots being written or already reused by a newer event
+                if (slot.seq.load(std::memory_order_acquire) != 2 * index + 2) {
+                    continue;
+                }
+                Event event;
+                event.name = slot.name.load(std::memory_order_relaxed);
+                event.phase = slot.phase.load(std::memory_order_relaxed);
+                event.ts_us = slot.ts_us.load(std::memory_order_relaxed);
+                event.dur_us = slot.dur_us.load(std::memory_order_relaxed);
+                event.tid = slot.tid.load(std::memory_order_relaxed);
+                for (int i = 0; i < 2; i++) {
+                    event.arg_names[i] = slot.arg_names[i].load(std::memory_order_relaxed);
+                    event.args[i] = slot.args[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) == 2 * index + 2 && event.name != nullptr) {
+                    events.push_back(event);
+                }
+            }
+            if (clear == JNI_TRUE) {
+                trace->first.store(end, std::memory_order_relaxed);
+            }
         }
-        if (model != nullptr) {
-            llama_model_free(model);
-            model = nullptr;
+        std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.ts_us < b.ts_us; });
+        
+        // Names and argument names are static identifiers, so nothing needs escaping
+        std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (size_t i = 0; i < events.size(); i++) {
+            const Event& event = events[i];
+            json += (i > 0) ? ",\n" : "\n";
+            json += "{\"name\":\"" + std::string(event.name) + "\",\"ph\":\"" + event.phase + "\",\"pid\":1,\"tid\":" +
+                    std::to_string(event.tid) + ",\"ts\":" + std::to_string(event.ts_us);
+            if (event.phase == 'X') {
+                json += ",\"dur\":" + std::to_string(event.dur_us);
+            } else {
+                json += ",\"s\":\"t\"";
+            }
+            json += ",\"args\":{";
+            for (int a = 0; a < 2 && event.arg_names[a] != nullptr; a++) {
+                json += (a > 0) ? "," : "";
+                json += "\"" + std::string(event.arg_names[a]) + "\":" + std::to_string(event.args[a]);
+            }
+            json += "}}";
         }
-        tokens.clear();
+        json += "\n]}";
+        return string_to_jstring(env, json);
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeDumpTrace: " << e.what() << std::endl;
+        return nullptr;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeDumpTrace" << std::endl;
+        return nullptr;
     }
-};
-
-// Global handle management with thread safety
-static std::unordered_map<jlong, std::unique_ptr<LlamaContext>> g_contexts;
-static std::mutex g_contexts_mutex;
-static jlong g_next_handle = 1;
-static bool g_backend_initialized = false;
-static std::mutex g_init_mutex;
+}
 
-// Helper function to convert jstring to std::string with proper error handling
-std::string jstring_to_string(JNIEnv* env, jstring jstr) {
-    if (jstr == nullptr) return "";
+// Select the NUMA strategy - matches exactly: nativeInitNuma(strategy: Int): Boolean (static)
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeInitNuma(JNIEnv* env, jclass clazz, jint strategy) {
+    if (strategy < GGML_NUMA_STRATEGY_DISABLED || strategy >= GGML_NUMA_STRATEGY_COUNT) {
+        return JNI_FALSE;
+    }
     
-    const char* chars = env->GetStringUTFChars(jstr, nullptr);
-    if (chars == nullptr) return "";
+    // Weights are placed when they are loaded, so the strategy must be chosen first
+    {
+        std::shared_lock<std::shared_mutex> lock(g_contexts_mutex);
+        if (g_next_handle != 1) {
+            return JNI_FALSE;
+        }
+    }
     
-    std::string result(chars);
-    env->ReleaseStringUTFChars(jstr, chars);
-    return result;
+    std::lock_guard<std::mutex> init_lock(g_init_mutex);
+    if (g_numa_initialized) {
+        return JNI_FALSE;
+    }
+    init_backend_locked();
+    llama_numa_init(static_cast<enum ggml_numa_strategy>(strategy));
+    g_numa_initialized = true;
+    return JNI_TRUE;
 }
 
-// Helper function to convert std::string to jstring with error handling
-jstring string_to_jstring(JNIEnv* env, const std::string& str) {
-    if (env == nullptr) return nullptr;
-    return env->NewStringUTF(str.c_str());
+// Set the process memory budget - matches exactly: nativeSetMemoryBudget(limitBytes: Long, waitMs: Long): Boolean (static)
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSetMemoryBudget(JNIEnv* env, jclass clazz, jlong limitBytes, jlong waitMs) {
+    if (limitBytes < 0 || waitMs < 0) {
+        return JNI_FALSE;
+    }
+    
+    // Lowering the limit below what is reserved only affects later reservations
+    {
+        std::lock_guard<std::mutex> lock(g_budget.mutex);
+        g_budget.limit = static_cast<uint64_t>(limitBytes);
+        g_budget.wait_ms = waitMs;
+    }
+    g_budget.cv.notify_all();
+    return JNI_TRUE;
 }
 
-// Helper function to get context by handle with thread safety
-LlamaContext* get_context(jlong handle) {
-    std::lock_guard<std::mutex> lock(g_contexts_mutex);
-    auto it = g_contexts.find(handle);
-    return (it != g_contexts.end()) ? it->second.get() : nullptr;
+// Read the process memory budget - matches exactly: nativeGetMemoryBudget(): LongArray? (static)
+JNIEXPORT jlongArray JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGetMemoryBudget(JNIEnv* env, jclass clazz) {
+    if (env == nullptr) {
+        return nullptr;
+    }
+    
+    jlong values[2];
+    {
+        std::lock_guard<std::mutex> lock(g_budget.mutex);
+        values[0] = static_cast<jlong>(g_budget.limit);
+        values[1] = static_cast<jlong>(g_budget.reserved);
+    }
+    jlongArray result = env->NewLongArray(2);
+    if (result != nullptr) {
+        env->SetLongArrayRegion(result, 0, 2, values);
+    }
+    return result;
 }
 
-// Simplified sampling function using greedy approach
-llama_token sample_token_greedy(LlamaContext* ctx, float* logits) {
-    if (ctx == nullptr || logits == nullptr || ctx->model == nullptr || ctx->context == nullptr) {
-        return 0;
+// Report a context's memory use - matches exactly: nativeGetResourceUsage(handle: Long, usage: LongArray): Boolean
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGetResourceUsage(JNIEnv* env, jobject thiz, jlong handle, jlongArray usage) {
+    if (env == nullptr || usage == nullptr || handle == 0 || env->GetArrayLength(usage) < LLAMA_JNI_RES_COUNT) {
+        return JNI_FALSE;
     }
     
-    const auto* vocab = llama_model_get_vocab(ctx->model);
-    const int n_vocab = llama_vocab_n_tokens(vocab);
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get()) || ctx->weights == nullptr) {
+        return JNI_FALSE;
+    }
     
-    // Find token with highest logit (greedy sampling)
-    int best_token = 0;
-    float best_logit = logits[0];
+    try {
+        jlong values[LLAMA_JNI_RES_COUNT] = {};
+        values[LLAMA_JNI_RES_WEIGHTS] = static_cast<jlong>(llama_model_size(ctx->model) +
+            (ctx->weights->draft != nullptr ? llama_model_size(ctx->weights->draft) : 0));
+        
+        // Only published counters are read, so this never waits for a running generation
+        // or touches the llama_context while the scheduler decodes on it
+        const uint64_t used_cells = static_cast<uint64_t>(ctx->kv_cells_used.load(std::memory_order_relaxed));
+        const uint64_t draft_cells = static_cast<uint64_t>(ctx->draft_cells_used.load(std::memory_order_relaxed));
+        values[LLAMA_JNI_RES_KV] = static_cast<jlong>(ctx->kv_bytes.load());
+        values[LLAMA_JNI_RES_KV_USED] = static_cast<jlong>(used_cells * ctx->kv_cell_bytes + draft_cells * ctx->draft_kv_cell_bytes);
+        values[LLAMA_JNI_RES_COMPUTE] = static_cast<jlong>(ctx->compute_bytes.load());
+        values[LLAMA_JNI_RES_STATE_CACHE] = static_cast<jlong>(ctx->sessions.used_bytes.load());
+        values[LLAMA_JNI_RES_RESERVED] = static_cast<jlong>(ctx->reservation.bytes.load());
+        
+        env->SetLongArrayRegion(usage, 0, LLAMA_JNI_RES_COUNT, values);
+        return JNI_TRUE;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeGetResourceUsage: " << e.what() << std::endl;
+        return JNI_FALSE;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeGetResourceUsage" << std::endl;
+        return JNI_FALSE;
+    }
+}
+
+// Queue an asynchronous generation - matches exactly: nativeGenerateAsync(handle: Long, prompt: String, maxTokens: Int, temperature: Float, topP: Float, topK: Int, constraints: GenerationConstraints?, future: CompletableFuture<String>): Boolean
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateAsync(JNIEnv* env, jobject thiz, jlong handle, jstring prompt, jint maxTokens, jfloat temperature, jfloat topP, jint topK, jobject constraints, jobject future) {
+    if (env == nullptr || prompt == nullptr || future == nullptr || handle == 0) {
+        return JNI_FALSE;
+    }
     
-    for (int i = 1; i < n_vocab; i++) {
-        if (logits[i] > best_logit) {
-            best_logit = logits[i];
-            best_token = i;
-        }
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return JNI_FALSE;
     }
     
-    return best_token;
+    try {
+        AsyncJob job;
+        job.handle = handle;
+        job.prompt = jstring_to_string(env, prompt);
+        if (job.prompt.empty()) {
+            return JNI_FALSE;
+        }
+        job.params = make_generation_params(env, ctx.get(), maxTokens, temperature, topP, topK, constraints);
+        {
+            std::shared_lock<std::shared_mutex> lock(ctx->exec_mutex);
+            job.batched = ctx->scheduler != nullptr;
+        }
+        
+        AsyncWorkerPool* pool = get_async_pool();
+        job.future = env->NewGlobalRef(future);
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            pool->queue.push_back(std::move(job));
+        }
+        pool->cv.notify_one();
+        return JNI_TRUE;
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeGenerateAsync: " << e.what() << std::endl;
+        return JNI_FALSE;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeGenerateAsync" << std::endl;
+        return JNI_FALSE;
+    }
 }
 
-extern "C" {
+// Set the async worker count - matches exactly: nativeSetAsyncWorkers(count: Int): Boolean (static)
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSetAsyncWorkers(JNIEnv* env, jclass clazz, jint count) {
+    std::lock_guard<std::mutex> lock(g_async_pool_mutex);
+    if (count <= 0 || g_async_pool != nullptr) {
+        return JNI_FALSE;
+    }
+    g_async_worker_count = count;
+    return JNI_TRUE;
+}
 
-// Load model from file path - matches exactly: nativeLoadModel(modelPath: String, contextSize: Int, threads: Int): Long
-JNIEXPORT jlong JNICALL
-Java_com_traycer_llama_LlamaWrapper_nativeLoadModel(JNIEnv* env, jobject thiz, jstring modelPath, jint contextSize, jint threads) {
+// Embed texts into a direct buffer - matches exactly: nativeEmbed(handle: Long, texts: Array<String>, pooling: Int, normalize: Boolean, truncate: Boolean, output: FloatBuffer, outputOffset: Int): Int
+JNIEXPORT jint JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeEmbed(JNIEnv* env, jobject thiz, jlong handle, jobjectArray texts, jint pooling, jboolean normalize,
+                                                jboolean truncate, jobject output, jint outputOffset) {
+    if (env == nullptr || texts == nullptr || output == nullptr || handle == 0 || outputOffset < 0 ||
+        pooling < LLAMA_POOLING_TYPE_UNSPECIFIED || pooling > LLAMA_POOLING_TYPE_LAST || pooling == LLAMA_POOLING_TYPE_NONE) {
+        return -LLAMA_JNI_ERR_INVALID_PARAMS;
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return -LLAMA_JNI_ERR_INVALID_HANDLE;
+    }
+    
     try {
-        // Initialize backend if not already done (thread-safe)
-        {
-            std::lock_guard<std::mutex> init_lock(g_init_mutex);
-            if (!g_backend_initialized) {
-                llama_backend_init();
-                g_backend_initialized = true;
-            }
+        const jsize n_texts = env->GetArrayLength(texts);
+        const jlong n_floats = static_cast<jlong>(n_texts) * llama_model_n_embd(ctx->model);
+        float* out = static_cast<float*>(env->GetDirectBufferAddress(output));
+        if (n_texts == 0 || out == nullptr || outputOffset + n_floats > env->GetDirectBufferCapacity(output)) {
+            return -LLAMA_JNI_ERR_INVALID_PARAMS;
         }
         
-        // Validate input parameters
-        if (env == nullptr || modelPath == nullptr) {
-            return 0;
+        std::vector<std::string> inputs(n_texts);
+        for (jsize i = 0; i < n_texts; i++) {
+            jstring text = static_cast<jstring>(env->GetObjectArrayElement(texts, i));
+            inputs[i] = jstring_to_string(env, text);
+            env->DeleteLocalRef(text);
+            if (inputs[i].empty()) {
+                return -LLAMA_JNI_ERR_INVALID_PARAMS;
+            }
         }
         
-        std::string path = jstring_to_string(env, modelPath);
-        if (path.empty()) {
-            return 0;
+        // The scheduler owns every sequence while it runs
+        std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+        if (ctx->scheduler) {
+            return -LLAMA_JNI_ERR_INVALID_PARAMS;
         }
         
-        // Validate context size
-        if (contextSize <= 0) {
-            contextSize = 2048;  // Default value
+        // Rejected before the embedding decodes drop the prefix cache
+        std::vector<std::vector<llama_token>> tokenized;
+        const llama_jni_error_t code = tokenize_embedding_texts(ctx.get(), inputs, truncate == JNI_TRUE, tokenized);
+        if (code != LLAMA_JNI_ERR_NONE) {
+            return -code;
         }
         
-        // Create new context
-        auto ctx = std::make_unique<LlamaContext>();
+        std::string error = run_embeddings(ctx.get(), tokenized, static_cast<enum llama_pooling_type>(pooling), normalize == JNI_TRUE, out + outputOffset);
+        if (!error.empty()) {
+            std::cerr << "nativeEmbed: " << error << std::endl;
+            return -LLAMA_JNI_ERR_GENERATION_FAILED;
+        }
+        return n_texts;
         
-        // Set up model parameters
-        llama_model_params model_params = llama_model_default_params();
-        model_params.use_mmap = true;
-        model_params.use_mlock = false;
+    } catch (const std::bad_alloc&) {
+        return -LLAMA_JNI_ERR_OUT_OF_MEMORY;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeEmbed: " << e.what() << std::endl;
+        return -LLAMA_JNI_ERR_GENERATION_FAILED;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeEmbed" << std::endl;
+        return -LLAMA_JNI_ERR_GENERATION_FAILED;
+    }
+}
+
+// Get the embedding width - matches exactly: nativeGetEmbeddingSize(handle: Long): Int
+JNIEXPORT jint JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGetEmbeddingSize(JNIEnv* env, jobject thiz, jlong handle) {
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (ctx == nullptr || ctx->model == nullptr) {
+        return 0;
+    }
+    return llama_model_n_embd(ctx->model);
+}
+
+// Get model information - matches exactly: nativeGetModelInfo(handle: Long, values: LongArray): Array<String>?
+JNIEXPORT jobjectArray JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGetModelInfo(JNIEnv* env, jobject thiz, jlong handle, jlongArray values) {
+    if (env == nullptr || values == nullptr || handle == 0 || env->GetArrayLength(values) < LLAMA_JNI_INFO_COUNT) {
+        return nullptr;
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (ctx == nullptr || ctx->info_numbers.empty()) {
+        return nullptr;
+    }
+    
+    try {
+        // Everything but the counts was captured when the context was created
+        std::vector<jlong> numbers = ctx->info_numbers;
+        numbers[LLAMA_JNI_INFO_CONTEXT] = ctx->kv_cells_total.load(std::memory_order_relaxed);
+        numbers[LLAMA_JNI_INFO_SEQUENCES] = ctx->n_seq_max.load(std::memory_order_relaxed);
+        numbers[LLAMA_JNI_INFO_ADAPTERS] = ctx->n_adapters.load(std::memory_order_relaxed);
+        const std::vector<std::string>& strings = ctx->info_strings;
         
-        // Load model using new API
-        ctx->model = llama_model_load_from_file(path.c_str(), model_params);
-        if (ctx->model == nullptr) {
-            return 0;
+        jclass string_class = env->FindClass("java/lang/String");
+        jobjectArray result = env->NewObjectArray(static_cast<jsize>(strings.size()), string_class, nullptr);
+        if (result == nullptr) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < strings.size(); i++) {
+            jstring text = string_to_jstring(env, strings[i]);
+            env->SetObjectArrayElement(result, static_cast<jsize>(i), text);
+            env->DeleteLocalRef(text);
         }
+        env->SetLongArrayRegion(values, 0, LLAMA_JNI_INFO_COUNT, numbers.data());
+        return result;
         
-        // Set up context parameters
-        llama_context_params ctx_params = llama_context_default_params();
-        ctx_params.n_ctx = contextSize;
-        ctx_params.n_batch = std::min(512, contextSize / 4);
-        
-        // Handle thread count parameter
-        if (threads > 0) {
-            ctx_params.n_threads = threads;
-            ctx_params.n_threads_batch = threads;
-        } else if (threads == -1) {
-            // Auto-detect threads
-            unsigned int hw_threads = std::thread::hardware_concurrency();
-            ctx_params.n_threads = (hw_threads > 0) ? hw_threads : 4;
-            ctx_params.n_threads_batch = ctx_params.n_threads;
-        } else {
-            // Default to 4 threads if invalid value
-            ctx_params.n_threads = 4;
-            ctx_params.n_threads_batch = 4;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeGetModelInfo: " << e.what() << std::endl;
+        return nullptr;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeGetModelInfo" << std::endl;
+        return nullptr;
+    }
+}
+
+// Start the batching scheduler - matches exactly: nativeStartScheduler(handle: Long, maxSequences: Int): Boolean
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeStartScheduler(JNIEnv* env, jobject thiz, jlong handle, jint maxSequences) {
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return JNI_FALSE;
+    }
+    
+    try {
+        std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+        if (ctx->scheduler) {
+            return JNI_TRUE;  // Already running
         }
         
-        // Create context using new API
-        ctx->context = llama_init_from_model(ctx->model, ctx_params);
-        if (ctx->context == nullptr) {
-            return 0;
+        if (maxSequences <= 0) {
+            maxSequences = 4;  // Default
         }
         
-        // Reserve space for tokens
-        ctx->tokens.reserve(ctx_params.n_ctx);
+        // Each active sequence adds a token to every decode step, so the batch buffer
+        // bounds how many can run at once, as does llama.cpp's own sequence limit
+        const int n_seq_limit = std::min<int>(static_cast<int>(ctx->params.n_batch), static_cast<int>(llama_max_parallel_sequences()));
+        if (maxSequences > n_seq_limit) {
+            std::cerr << "maxSequences " << maxSequences << " exceeds the limit of " << n_seq_limit
+                      << " (batch size " << ctx->params.n_batch << "), using " << n_seq_limit << std::endl;
+            maxSequences = n_seq_limit;
+        }
         
-        // Store context and return handle (thread-safe)
-        {
-            std::lock_guard<std::mutex> lock(g_contexts_mutex);
-            jlong handle = g_next_handle++;
-            g_contexts[handle] = std::move(ctx);
-            return handle;
+        if (!ensure_seq_capacity(ctx.get(), maxSequences)) {
+            return JNI_FALSE;
         }
         
+        ctx->scheduler = std::make_unique<Scheduler>(ctx.get(), maxSequences);
+        return JNI_TRUE;
+        
     } catch (const std::exception& e) {
-        std::cerr << "Exception in nativeLoadModel: " << e.what() << std::endl;
-        return 0;
+        std::cerr << "Exception in nativeStartScheduler: " << e.what() << std::endl;
+        return JNI_FALSE;
     } catch (...) {
-        std::cerr << "Unknown exception in nativeLoadModel" << std::endl;
-        return 0;
+        std::cerr << "Unknown exception in nativeStartScheduler" << std::endl;
+        return JNI_FALSE;
     }
 }
 
-// Generate text - matches exactly: nativeGenerateText(handle: Long, prompt: String, maxTokens: Int, temperature: Float, topP: Float, topK: Int): String?
-JNIEXPORT jstring JNICALL
-Java_com_traycer_llama_LlamaWrapper_nativeGenerateText(JNIEnv* env, jobject thiz, jlong handle, jstring prompt, jint maxTokens, jfloat temperature, jfloat topP, jint topK) {
-    // Validate input parameters
-    if (env == nullptr || prompt == nullptr || handle == 0) {
-        return string_to_jstring(env, "Error: Invalid parameters");
+// Stop the batching scheduler - matches exactly: nativeStopScheduler(handle: Long)
+JNIEXPORT void JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeStopScheduler(JNIEnv* env, jobject thiz, jlong handle) {
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (ctx == nullptr) {
+        return;
     }
     
-    LlamaContext* ctx = get_context(handle);
-    if (ctx == nullptr || ctx->model == nullptr || ctx->context == nullptr) {
-        return string_to_jstring(env, "Error: Invalid handle or model not loaded");
+    try {
+        // Fail the requests in flight first so their submitters release the shared lock
+        {
+            std::shared_lock<std::shared_mutex> lock(ctx->exec_mutex);
+            if (ctx->scheduler) {
+                ctx->scheduler->stop();
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+        ctx->scheduler.reset();
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeStopScheduler: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeStopScheduler" << std::endl;
+    }
+}
+
+// Warm up a fresh context - matches exactly: nativeWarmup(handle: Long, prefault: Boolean): Boolean
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeWarmup(JNIEnv* env, jobject thiz, jlong handle, jboolean prefault) {
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return JNI_FALSE;
     }
     
     try {
-        std::string input = jstring_to_string(env, prompt);
-        if (input.empty()) {
-            return string_to_jstring(env, "Error: Empty prompt");
+        std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+        if (ctx->scheduler) {
+            std::cerr << "Warmup must run before the scheduler is started" << std::endl;
+            return JNI_FALSE;
         }
         
-        // Validate generation parameters
-        if (maxTokens <= 0) {
-            maxTokens = 256;  // Default
+        // Weights read into memory at load time are already resident
+        if (prefault == JNI_TRUE && ctx->weights->use_mmap) {
+            if (!prefault_file(ctx->weights->path)) {
+                std::cerr << "Failed to prefault " << ctx->weights->path << std::endl;
+            }
+            if (!ctx->weights->draft_path.empty() && !prefault_file(ctx->weights->draft_path)) {
+                std::cerr << "Failed to prefault " << ctx->weights->draft_path << std::endl;
+            }
         }
         
-        // Clear previous tokens and KV cache
+        // Warmup decodes overwrite the cache, so the next prompt starts from scratch
         ctx->tokens.clear();
-        llama_memory_t memory = llama_get_memory(ctx->context);
-        llama_memory_clear(memory, true);
-        
-        // Get vocab for tokenization
-        const auto* vocab = llama_model_get_vocab(ctx->model);
-        
-        // Tokenize input
-        const int max_input_tokens = llama_n_ctx(ctx->context) / 2;
-        ctx->tokens.resize(max_input_tokens);
-        
-        int n_tokens = llama_tokenize(
-            vocab,
-            input.c_str(),
-            input.length(),
-            ctx->tokens.data(),
-            max_input_tokens,
-            true,  // add_bos (beginning of sequence)
-            false  // special tokens
-        );
-        
-        if (n_tokens < 0) {
-            return string_to_jstring(env, "Error: Tokenization failed");
+        bool ok = warmup_decode(ctx->context, ctx->batch, ctx->params.n_batch);
+        if (ctx->draft_context != nullptr) {
+            ctx->draft_cached.clear();
+            ok = warmup_decode(ctx->draft_context, ctx->batch, ctx->params.n_batch) && ok;
         }
+        publish_kv_usage(ctx.get());
+        return ok ? JNI_TRUE : JNI_FALSE;
         
-        ctx->tokens.resize(n_tokens);
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeWarmup: " << e.what() << std::endl;
+        return JNI_FALSE;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeWarmup" << std::endl;
+        return JNI_FALSE;
+    }
+}
+
+// Reseed per-request sampling - matches exactly: nativeSetSeed(handle: Long, seed: Long)
+JNIEXPORT void JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSetSeed(JNIEnv* env, jobject thiz, jlong handle, jlong seed) {
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (ctx == nullptr) {
+        return;
+    }
+    
+    // Every following request draws its sampler seed from this generator
+    std::lock_guard<std::mutex> lock(ctx->rng_mutex);
+    ctx->rng.seed(static_cast<std::mt19937::result_type>(seed));
+}
+
+// Configure session snapshots - matches exactly: nativeConfigureStateCache(handle: Long, maxBytes: Long, spillDir: String?): Boolean
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeConfigureStateCache(JNIEnv* env, jobject thiz, jlong handle, jlong maxBytes, jstring spillDir) {
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get()) || maxBytes < 0) {
+        return JNI_FALSE;
+    }
+    
+    try {
+        std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+        ctx->sessions.max_bytes = static_cast<size_t>(maxBytes);
+        ctx->sessions.spill_dir = jstring_to_string(env, spillDir);
+        session_cache_trim(ctx->sessions);
+        return JNI_TRUE;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeConfigureStateCache: " << e.what() << std::endl;
+        return JNI_FALSE;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeConfigureStateCache" << std::endl;
+        return JNI_FALSE;
+    }
+}
+
+// Snapshot the KV state under a name - matches exactly: nativeSaveState(handle: Long, sessionId: String): Boolean
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSaveState(JNIEnv* env, jobject thiz, jlong handle, jstring sessionId) {
+    if (env == nullptr || sessionId == nullptr) {
+        return JNI_FALSE;
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return JNI_FALSE;
+    }
+    
+    try {
+        std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+        // The scheduler owns every sequence while it runs
+        if (ctx->scheduler) {
+            return JNI_FALSE;
+        }
         
-        // Process the prompt
-        llama_batch batch = llama_batch_init(n_tokens, 0, 1);
+        std::string id = jstring_to_string(env, sessionId);
+        if (id.empty() || ctx->tokens.empty()) {
+            return JNI_FALSE;
+        }
         
-        // Add all tokens to the batch
-        for (int i = 0; i < n_tokens; i++) {
-            batch.token[i] = ctx->tokens[i];
-            batch.pos[i] = i;
-            batch.n_seq_id[i] = 1;
-            batch.seq_id[i][0] = 0;
-            batch.logits[i] = false;
+        StateSnapshot snapshot;
+        snapshot.tokens = ctx->tokens;
+        snapshot.data.resize(llama_state_seq_get_size(ctx->context, 0));
+        size_t written = llama_state_seq_get_data(ctx->context, snapshot.data.data(), snapshot.data.size(), 0);
+        if (written == 0) {
+            return JNI_FALSE;
         }
+        snapshot.data.resize(written);
         
-        batch.n_tokens = n_tokens;
+        session_cache_put(ctx->sessions, id, std::move(snapshot));
+        return JNI_TRUE;
         
-        // Mark the last token for logits computation
-        if (batch.n_tokens > 0) {
-            batch.logits[batch.n_tokens - 1] = true;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in nativeSaveState: " << e.what() << std::endl;
+        return JNI_FALSE;
+    } catch (...) {
+        std::cerr << "Unknown exception in nativeSaveState" << std::endl;
+        return JNI_FALSE;
+    }
+}
+
+// Restore a named KV state snapshot - matches exactly: nativeRestoreState(handle: Long, sessionId: String): Boolean
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeRestoreState(JNIEnv* env, jobject thiz, jlong handle, jstring sessionId) {
+    if (env == nullptr || sessionId == nullptr) {
+        return JNI_FALSE;
+    }
+    
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (!context_ready(ctx.get())) {
+        return JNI_FALSE;
+    }
+    
+    try {
+        std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+        if (ctx->scheduler) {
+            return JNI_FALSE;
         }
         
-        // Process the prompt
-        if (llama_decode(ctx->context, batch) != 0) {
-            llama_batch_free(batch);
-            return string_to_jstring(env, "Error: Failed to decode prompt");
+        std::string id = jstring_to_string(env, sessionId);
+        StateSnapshot scratch;
+        const StateSnapshot* snapshot = session_cache_get(ctx->sessions, id, llama_n_ctx(ctx->context), scratch);
+        if (snapshot == nullptr) {
+            return JNI_FALSE;
         }
         
-        std::string result;
-        
-        // Calculate maximum generation tokens
-        int max_gen_tokens = std::min(static_cast<int>(maxTokens), static_cast<int>(llama_n_ctx(ctx->context)) - n_tokens);
-        
-        // Generate tokens one by one using simplified greedy sampling
-        for (int i = 0; i < max_gen_tokens; i++) {
-            // Get logits for the last token
-            float* logits = llama_get_logits_ith(ctx->context, batch.n_tokens - 1);
-            if (logits == nullptr) {
-                break;
-            }
-            
-            // Sample next token using greedy approach (ignore advanced parameters for now)
-            llama_token new_token = sample_token_greedy(ctx, logits);
-            
-            // Check for end of sequence
-            if (llama_vocab_is_eog(vocab, new_token)) {
-                break;
-            }
-            
-            // Convert token to text
-            char piece[256];
-            int piece_len = llama_token_to_piece(vocab, new_token, piece, sizeof(piece), 0, false);
-            
-            if (piece_len > 0) {
-                result.append(piece, piece_len);
-            }
-            
-            // Prepare for next iteration
-            batch.n_tokens = 1;
-            batch.token[0] = new_token;
-            batch.pos[0] = ctx->tokens.size();
-            batch.n_seq_id[0] = 1;
-            batch.seq_id[0][0] = 0;
-            batch.logits[0] = true;
-            
-            ctx->tokens.push_back(new_token);
-            
-            // Decode the new token
-            if (llama_decode(ctx->context, batch) != 0) {
-                break;
-            }
+        llama_memory_seq_rm(llama_get_memory(ctx->context), 0, -1, -1);
+        if (llama_state_seq_set_data(ctx->context, snapshot->data.data(), snapshot->data.size(), 0) == 0) {
+            invalidate_cache(ctx.get());
+            return JNI_FALSE;
         }
         
-        llama_batch_free(batch);
-        return string_to_jstring(env, result);
+        // The next prompt that extends this history only prefills the new turn
+        ctx->tokens = snapshot->tokens;
+        publish_kv_usage(ctx.get());
+        return JNI_TRUE;
         
     } catch (const std::exception& e) {
-        std::cerr << "Exception in nativeGenerateText: " << e.what() << std::endl;
-        return string_to_jstring(env, "Error: Exception during text generation");
+        std::cerr << "Exception in nativeRestoreState: " << e.what() << std::endl;
+        return JNI_FALSE;
     } catch (...) {
-        std::cerr << "Unknown exception in nativeGenerateText" << std::endl;
-        return string_to_jstring(env, "Error: Unknown exception during text generation");
+        std::cerr << "Unknown exception in nativeRestoreState" << std::endl;
+        return JNI_FALSE;
     }
 }
 
-// Get model information - matches exactly: nativeGetModelInfo(handle: Long): String?
-JNIEXPORT jstring JNICALL
-Java_com_traycer_llama_LlamaWrapper_nativeGetModelInfo(JNIEnv* env, jobject thiz, jlong handle) {
-    if (env == nullptr || handle == 0) {
-        return string_to_jstring(env, "Error: Invalid parameters");
+// Forget a named snapshot - matches exactly: nativeDeleteState(handle: Long, sessionId: String)
+JNIEXPORT void JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeDeleteState(JNIEnv* env, jobject thiz, jlong handle, jstring sessionId) {
+    if (env == nullptr || sessionId == nullptr) {
+        return;
     }
     
-    LlamaContext* ctx = get_context(handle);
-    if (ctx == nullptr || ctx->model == nullptr || ctx->context == nullptr) {
-        return string_to_jstring(env, "Error: No model loaded for this handle");
+    std::shared_ptr<LlamaContext> ctx = get_context(handle);
+    if (ctx == nullptr) {
+        return;
     }
     
     try {
-        const auto* vocab = llama_model_get_vocab(ctx->model);
-        
-        char model_desc[256];
-        llama_model_desc(ctx->model, model_desc, sizeof(model_desc));
-        
-        std::string info = "Model Information:\n";
-        info += "Handle: " + std::to_string(handle) + "\n";
-        info += "Vocabulary size: " + std::to_string(llama_vocab_n_tokens(vocab)) + "\n";
-        info += "Context size: " + std::to_string(llama_n_ctx(ctx->context)) + "\n";
-        info += "Embedding size: " + std::to_string(llama_model_n_embd(ctx->model)) + "\n";
-        info += "Model type: " + std::string(model_desc) + "\n";
-        info += "Status: Loaded and ready";
-        
-        return string_to_jstring(env, info);
+        std::string id = jstring_to_string(env, sessionId);
+        std::unique_lock<std::shared_mutex> lock(ctx->exec_mutex);
+        auto it = ctx->sessions.index.find(id);
+        if (it != ctx->sessions.index.end()) {
+            ctx->sessions.used_bytes -= it->second->second.size_bytes();
+            ctx->sessions.entries.erase(it->second);
+            ctx->sessions.index.erase(it);
+        }
+        if (!ctx->sessions.spill_dir.empty()) {
+            std::remove(session_spill_path(ctx->sessions, id).c_str());
+        }
     } catch (const std::exception& e) {
-        std::cerr << "Exception in nativeGetModelInfo: " << e.what() << std::endl;
-        return string_to_jstring(env, "Error: Exception getting model info");
+        std::cerr << "Exception in nativeDeleteState: " << e.what() << std::endl;
     } catch (...) {
-        std::cerr << "Unknown exception in nativeGetModelInfo" << std::endl;
-        return string_to_jstring(env, "Error: Unknown exception getting model info");
+        std::cerr << "Unknown exception in nativeDeleteState" << std::endl;
     }
 }
 
@@ -360,12 +4886,16 @@ Java_com_traycer_llama_LlamaWrapper_nativeCleanup(JNIEnv* env, jobject thiz, jlo
     }
     
     try {
-        std::lock_guard<std::mutex> lock(g_contexts_mutex);
-        auto it = g_contexts.find(handle);
-        if (it != g_contexts.end()) {
-            // The unique_ptr destructor will automatically call LlamaContext destructor
-            // which will properly clean up the model and context
-            g_contexts.erase(it);
+        // Calls still running on the context keep it alive; the last one to return
+        // runs the LlamaContext destructor, which frees the context and its model reference
+        std::shared_ptr<LlamaContext> released;
+        {
+            std::lock_guard<std::shared_mutex> lock(g_contexts_mutex);
+            auto it = g_contexts.find(handle);
+            if (it != g_contexts.end()) {
+                released = std::move(it->second);
+                g_contexts.erase(it);
+            }
         }
     } catch (const std::exception& e) {
         std::cerr << "Exception in nativeCleanup: " << e.what() << std::endl;
@@ -7,27 +7,201 @@
 extern "C" {
 #endif
 
-// JNI function declarations for LlamaWrapper class
-// Package: com.traycer.llama, Class: LlamaWrapper
+// JNI function declarations for the LlamaModel and LlamaWrapper classes
+// Package: com.traycer.llama, Classes: LlamaModel (weights), LlamaWrapper (contexts)
 // These signatures exactly match the Kotlin native method declarations
 
 /**
- * Native method to load a GGUF model.
- * Matches Kotlin: nativeLoadModel(modelPath: String, contextSize: Int, threads: Int): Long
+ * Native method to load GGUF model weights.
+ * Matches Kotlin: LlamaModel.nativeLoadModel(modelPath: String, draftModelPath: String?, options: ModelLoadOptions?): Long
+ * 
+ * The weights are reference-counted: every context created from the handle
+ * keeps them mapped, so they are freed only after the model handle and the
+ * last context are released.
+ * 
+ * With a draft model, contexts created from the handle use speculative decoding
+ * for single-sequence generation. The draft must share the target's vocabulary.
  * 
  * @param env JNI environment pointer
- * @param thiz Java object reference (LlamaWrapper instance)
+ * @param thiz Java object reference (LlamaModel instance)
  * @param modelPath Path to the GGUF model file
+ * @param draftModelPath Path to a smaller GGUF draft model, or null
+ * @param options ModelLoadOptions with mmap/mlock, GPU offload and a progress listener, or null for defaults
+ * @return Native model handle, or 0 on failure
+ */
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_LlamaModel_nativeLoadModel(JNIEnv *env, jobject thiz, jstring modelPath, jstring draftModelPath, jobject options);
+
+/**
+ * Native method to release a model handle.
+ * Matches Kotlin: LlamaModel.nativeFreeModel(modelHandle: Long)
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaModel instance)
+ * @param modelHandle Native model handle
+ */
+JNIEXPORT void JNICALL
+Java_com_traycer_llama_LlamaModel_nativeFreeModel(JNIEnv *env, jobject thiz, jlong modelHandle);
+
+/**
+ * Native method to load a LoRA adapter onto loaded model weights.
+ * Matches Kotlin: LlamaModel.nativeLoadAdapter(modelHandle: Long, path: String): Long
+ * 
+ * The adapter is a small GGUF file (optionally quantized) trained on the same base
+ * model. It stays loaded until the weights are freed and can be applied to any
+ * context created from them.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaModel instance)
+ * @param modelHandle Native model handle
+ * @param path Path to the GGUF LoRA adapter
+ * @return Native adapter handle, or 0 on failure
+ */
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_LlamaModel_nativeLoadAdapter(JNIEnv *env, jobject thiz, jlong modelHandle, jstring path);
+
+/**
+ * Native method to pre-create a pool of contexts on loaded model weights.
+ * Matches Kotlin: ContextPool.nativeCreatePool(modelHandle: Long, size: Int, contextSize: Int, threads: Int, options: ContextOptions?, seed: Long): Long
+ * 
+ * Each context is created as by nativeCreateContext, with its KV cache, batch and
+ * token buffers allocated up front and admitted against the memory budget.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (ContextPool instance)
+ * @param modelHandle Native model handle
+ * @param size Number of contexts in the pool
+ * @param contextSize Context size of each context
+ * @param threads Number of threads per context (-1 for auto-detect)
+ * @param options ContextOptions applied to every context, or null for defaults
+ * @param seed Sampler seed restored on every acquire, or negative to keep each context's generator
+ * @return Native pool handle, or 0 if any context cannot be created
+ */
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_ContextPool_nativeCreatePool(JNIEnv *env, jobject thiz, jlong modelHandle, jint size, jint contextSize, jint threads, jobject options, jlong seed);
+
+/**
+ * Native method to lease an idle context from a pool.
+ * Matches Kotlin: ContextPool.nativeAcquire(poolHandle: Long, timeoutMs: Long): Long
+ * 
+ * The context is reset here rather than on release: scheduler stopped, adapters and
+ * session snapshots cleared, seed restored, and the cached prompt dropped unless it
+ * was released with keepPrefix.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (ContextPool instance)
+ * @param poolHandle Native pool handle
+ * @param timeoutMs Maximum wait for an idle context; negative waits indefinitely
+ * @return Native context handle, or 0 on timeout or if the pool has been freed
+ */
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_ContextPool_nativeAcquire(JNIEnv *env, jobject thiz, jlong poolHandle, jlong timeoutMs);
+
+/**
+ * Native method to return a leased context to its pool.
+ * Matches Kotlin: ContextPool.nativeRelease(poolHandle: Long, handle: Long, keepPrefix: Boolean): Boolean
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (ContextPool instance)
+ * @param poolHandle Native pool handle
+ * @param handle Context handle returned by nativeAcquire; invalid afterwards
+ * @param keepPrefix Keep the cached tokens so the next holder can reuse a shared prompt prefix
+ * @return true if returned; false if the handle is not leased from this pool or the
+ *         pool has been freed, in which case the caller frees it with nativeCleanup
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_ContextPool_nativeRelease(JNIEnv *env, jobject thiz, jlong poolHandle, jlong handle, jboolean keepPrefix);
+
+/**
+ * Native method to count the idle contexts of a pool.
+ * Matches Kotlin: ContextPool.nativeIdleCount(poolHandle: Long): Int
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (ContextPool instance)
+ * @param poolHandle Native pool handle
+ * @return Number of contexts that can be acquired without waiting
+ */
+JNIEXPORT jint JNICALL
+Java_com_traycer_llama_ContextPool_nativeIdleCount(JNIEnv *env, jobject thiz, jlong poolHandle);
+
+/**
+ * Native method to free a context pool and its idle contexts.
+ * Matches Kotlin: ContextPool.nativeFreePool(poolHandle: Long)
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (ContextPool instance)
+ * @param poolHandle Native pool handle
+ */
+JNIEXPORT void JNICALL
+Java_com_traycer_llama_ContextPool_nativeFreePool(JNIEnv *env, jobject thiz, jlong poolHandle);
+
+/**
+ * Native method to create an inference context on loaded model weights.
+ * Matches Kotlin: nativeCreateContext(modelHandle: Long, contextSize: Int, threads: Int, options: ContextOptions?): Long
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param modelHandle Native model handle returned by nativeLoadModel
  * @param contextSize Context size for the model (default: 2048)
  * @param threads Number of threads to use (-1 for auto-detect)
- * @return Native handle (pointer) to the loaded model context, or 0 on failure
+ * @param options ContextOptions with batch sizing, thread placement and draft settings, or null for defaults
+ * @return Native handle to the new context, or 0 on failure
  */
 JNIEXPORT jlong JNICALL
-Java_com_traycer_llama_LlamaWrapper_nativeLoadModel(JNIEnv *env, jobject thiz, jstring modelPath, jint contextSize, jint threads);
+Java_com_traycer_llama_LlamaWrapper_nativeCreateContext(JNIEnv *env, jobject thiz, jlong modelHandle, jint contextSize, jint threads,
+                                                        jobject options);
 
 /**
  * Native method to generate text.
- * Matches Kotlin: nativeGenerateText(handle: Long, prompt: String, maxTokens: Int, temperature: Float, topP: Float, topK: Int): String?
+ * Matches Kotlin: nativeGenerateText(handle: Long, prompt: String, maxTokens: Int, temperature: Float, topP: Float, topK: Int,
+ *                                    constraints: GenerationConstraints?): String?
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param prompt Input text prompt
+ * @param maxTokens Maximum number of tokens to generate
+ * @param temperature Sampling temperature (0.0 to 2.0, higher = more random; 0 = greedy)
+ * @param topP Top-p sampling parameter (0.0 to 1.0, nucleus sampling)
+ * @param topK Top-k sampling parameter (limits vocabulary to top K tokens; 0 = whole vocabulary)
+ * @param constraints GenerationConstraints with stop strings, a grammar and scheduling class, or null for none
+ * @return Generated text as String, or error message if generation fails
+ */
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateText(JNIEnv *env, jobject thiz, jlong handle, 
+                                                       jstring prompt, jint maxTokens, jfloat temperature, jfloat topP, jint topK,
+                                                       jobject constraints);
+
+/**
+ * Native method to generate text and report per-request performance metrics.
+ * Matches Kotlin: nativeGenerateWithStats(handle: Long, prompt: String, maxTokens: Int, temperature: Float, topP: Float, topK: Int,
+ *                                         constraints: GenerationConstraints?, stats: DoubleArray): String?
+ * 
+ * On success the stats array is filled in LLAMA_JNI_STAT_* order. Times are in
+ * milliseconds, measured natively with a monotonic clock. On failure a
+ * RuntimeException carrying the error message is thrown and the array is untouched.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param prompt Input text prompt
+ * @param maxTokens Maximum number of tokens to generate
+ * @param temperature Sampling temperature (0 = greedy)
+ * @param topP Top-p sampling parameter
+ * @param topK Top-k sampling parameter (0 = whole vocabulary)
+ * @param constraints GenerationConstraints with stop strings, a grammar and scheduling class, or null for none
+ * @param stats Array of at least LLAMA_JNI_STAT_COUNT elements receiving the metrics
+ * @return Generated text as String, or null with a pending RuntimeException if generation fails
+ */
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateWithStats(JNIEnv *env, jobject thiz, jlong handle, jstring prompt, jint maxTokens,
+                                                            jfloat temperature, jfloat topP, jint topK, jobject constraints,
+                                                            jdoubleArray stats);
+
+/**
+ * Native method to stream generated text to a listener as it is decoded.
+ * Matches Kotlin: nativeGenerateStream(handle: Long, prompt: String, maxTokens: Int, temperature: Float, topP: Float, topK: Int,
+ *                                      constraints: GenerationConstraints?, listener: TokenListener): String?
  * 
  * @param env JNI environment pointer
  * @param thiz Java object reference (LlamaWrapper instance)
@@ -37,28 +211,473 @@ Java_com_traycer_llama_LlamaWrapper_nativeLoadModel(JNIEnv *env, jobject thiz, j
  * @param temperature Sampling temperature (0.0 to 2.0, higher = more random)
  * @param topP Top-p sampling parameter (0.0 to 1.0, nucleus sampling)
  * @param topK Top-k sampling parameter (limits vocabulary to top K tokens)
+ * @param constraints GenerationConstraints with stop strings, a grammar and scheduling class, or null for none
+ * @param listener TokenListener receiving each chunk; returning false cancels generation
+ * @return null on success or cancellation, or error message if generation fails
+ */
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateStream(JNIEnv *env, jobject thiz, jlong handle, 
+                                                         jstring prompt, jint maxTokens, jfloat temperature, jfloat topP, jint topK,
+                                                         jobject constraints, jobject listener);
+
+/**
+ * Native method to generate text from and into caller-provided direct ByteBuffers.
+ * Matches Kotlin: nativeGenerateDirect(handle: Long, prompt: ByteBuffer, promptOffset: Int, promptLength: Int,
+ *                                      output: ByteBuffer, outputOffset: Int, outputCapacity: Int,
+ *                                      maxTokens: Int, temperature: Float, topP: Float, topK: Int,
+ *                                      constraints: GenerationConstraints?, status: IntArray): Int
+ * 
+ * The prompt is read as UTF-8 straight from the buffer and generated UTF-8 is
+ * written in place, avoiding jstring conversions and intermediate copies.
+ * Generation stops early when the next chunk would not fit the output region;
+ * status[0] then reads LLAMA_JNI_DIRECT_TRUNCATED instead of LLAMA_JNI_DIRECT_COMPLETE.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param prompt Direct ByteBuffer holding the UTF-8 prompt
+ * @param promptOffset Byte offset of the prompt within the buffer
+ * @param promptLength Length of the prompt in bytes
+ * @param output Direct ByteBuffer receiving generated UTF-8 text
+ * @param outputOffset Byte offset at which to start writing
+ * @param outputCapacity Maximum number of bytes to write
+ * @param maxTokens Maximum number of tokens to generate
+ * @param temperature Sampling temperature (0 = greedy)
+ * @param topP Top-p sampling parameter
+ * @param topK Top-k sampling parameter
+ * @param constraints GenerationConstraints with stop strings, a grammar and scheduling class, or null for none
+ * @param status Array of at least one element receiving LLAMA_JNI_DIRECT_* on success
+ * @return Number of bytes written, or a negated llama_jni_error_t code on failure
+ */
+JNIEXPORT jint JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateDirect(JNIEnv *env, jobject thiz, jlong handle, jobject prompt, jint promptOffset, jint promptLength,
+                                                         jobject output, jint outputOffset, jint outputCapacity,
+                                                         jint maxTokens, jfloat temperature, jfloat topP, jint topK,
+                                                         jobject constraints, jintArray status);
+
+/**
+ * Native method to generate several prompts in one call.
+ * Matches Kotlin: nativeGenerateBatch(handle: Long, prompts: Array<String>, maxTokens: Int, temperature: Float, topP: Float, topK: Int,
+ *                                     constraints: GenerationConstraints?, results: Array<String?>): String?
+ * 
+ * Every prompt is tokenized natively and generated as its own sequence; prefill and
+ * decode of all sequences share batches and run in lockstep until each finishes.
+ * A running scheduler is used when there is one; otherwise a temporary one with up to
+ * LLAMA_JNI_MAX_BATCH_SEQUENCES sequences holds the context for the call.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param prompts Input text prompts
+ * @param maxTokens Maximum number of tokens to generate per prompt
+ * @param temperature Sampling temperature (0 = greedy)
+ * @param topP Top-p sampling parameter
+ * @param topK Top-k sampling parameter (0 = whole vocabulary)
+ * @param constraints GenerationConstraints with stop strings, a grammar and scheduling class, or null for none
+ * @param results Array with at least one element per prompt, receiving the generated texts
+ * @return null on success, or error message if any generation fails
+ */
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateBatch(JNIEnv *env, jobject thiz, jlong handle, jobjectArray prompts, jint maxTokens,
+                                                        jfloat temperature, jfloat topP, jint topK, jobject constraints,
+                                                        jobjectArray results);
+
+/**
+ * Native method to tokenize text with the context's vocabulary.
+ * Matches Kotlin: nativeTokenize(handle: Long, text: String, addBos: Boolean): IntArray?
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param text UTF-8 text to tokenize
+ * @param addBos Whether to prepend the model's BOS token when it uses one
+ * @return Token IDs, or null if tokenization fails
+ */
+JNIEXPORT jintArray JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeTokenize(JNIEnv *env, jobject thiz, jlong handle, jstring text, jboolean addBos);
+
+/**
+ * Native method to convert token IDs back to text.
+ * Matches Kotlin: nativeDetokenize(handle: Long, tokens: IntArray): String?
+ * 
+ * The IDs are read in place with GetPrimitiveArrayCritical.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param tokens Token IDs
+ * @return Decoded text, or null if an ID is outside the vocabulary
+ */
+JNIEXPORT jstring JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeDetokenize(JNIEnv *env, jobject thiz, jlong handle, jintArray tokens);
+
+/**
+ * Native method to generate text from a prompt given as token IDs.
+ * Matches Kotlin: nativeGenerateTokens(handle: Long, tokens: IntArray, maxTokens: Int, temperature: Float, topP: Float, topK: Int,
+ *                                      constraints: GenerationConstraints?): String?
+ * 
+ * Behaves like nativeGenerateText without tokenizing: the IDs are used as the prompt,
+ * including KV cache prefix reuse. They should start with BOS when the model uses one.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param tokens Prompt token IDs, e.g. from nativeTokenize
+ * @param maxTokens Maximum number of tokens to generate
+ * @param temperature Sampling temperature (0 = greedy)
+ * @param topP Top-p sampling parameter
+ * @param topK Top-k sampling parameter (0 = whole vocabulary)
+ * @param constraints GenerationConstraints with stop strings, a grammar and scheduling class, or null for none
  * @return Generated text as String, or error message if generation fails
  */
 JNIEXPORT jstring JNICALL
-Java_com_traycer_llama_LlamaWrapper_nativeGenerateText(JNIEnv *env, jobject thiz, jlong handle, 
-                                                       jstring prompt, jint maxTokens, jfloat temperature, jfloat topP, jint topK);
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateTokens(JNIEnv *env, jobject thiz, jlong handle, jintArray tokens, jint maxTokens,
+                                                         jfloat temperature, jfloat topP, jint topK, jobject constraints);
 
 /**
- * Native method to get model information.
- * Matches Kotlin: nativeGetModelInfo(handle: Long): String?
+ * Native method to load a LoRA adapter onto the weights of a context.
+ * Matches Kotlin: nativeLoadAdapter(handle: Long, path: String): Long
  * 
  * @param env JNI environment pointer
  * @param thiz Java object reference (LlamaWrapper instance)
  * @param handle Native handle to the model context
- * @return Model information string, or error message if handle is invalid
+ * @param path Path to the GGUF LoRA adapter
+ * @return Native adapter handle, or 0 on failure
+ */
+JNIEXPORT jlong JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeLoadAdapter(JNIEnv *env, jobject thiz, jlong handle, jstring path);
+
+/**
+ * Native method to select the LoRA adapters applied to a context.
+ * Matches Kotlin: nativeSetAdapters(handle: Long, adapters: LongArray, scales: FloatArray): Boolean
+ * 
+ * Replaces the previous selection; empty arrays restore the base model. Selecting the
+ * adapters already applied is free, otherwise the context's KV cache is cleared.
+ * Refused while the scheduler is running, since adapters apply to every sequence.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param adapters Adapter handles loaded on this context's weights
+ * @param scales Scale of each adapter, typically 1.0
+ * @return JNI_TRUE if applied, JNI_FALSE if an adapter is unknown or the scheduler is running
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSetAdapters(JNIEnv *env, jobject thiz, jlong handle, jlongArray adapters, jfloatArray scales);
+
+/**
+ * Native method to select ggml's NUMA strategy for the process.
+ * Matches Kotlin: LlamaWrapper.nativeInitNuma(strategy: Int): Boolean (@JvmStatic)
+ * 
+ * Must be called once, before the first model is loaded.
+ * 
+ * @param env JNI environment pointer
+ * @param clazz Java class reference (LlamaWrapper)
+ * @param strategy ggml_numa_strategy value (0 = disabled, 1 = distribute, 2 = isolate, 3 = numactl, 4 = mirror)
+ * @return JNI_TRUE if applied, JNI_FALSE if invalid or too late
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeInitNuma(JNIEnv *env, jclass clazz, jint strategy);
+
+/**
+ * Native method to snapshot the process-wide metrics.
+ * Matches Kotlin: LlamaWrapper.nativeGetMetrics(): DoubleArray? (@JvmStatic)
+ * 
+ * Counters and gauges come first in LLAMA_JNI_METRIC_* order, followed by the
+ * histograms in LLAMA_JNI_HISTOGRAM_* order. Each histogram is written as its bound
+ * count n, n upper bounds, n + 1 bucket counts (the last one for +Inf), the sum and
+ * the count. Times are in seconds and the batch fill ratio is a fraction.
+ * 
+ * @param env JNI environment pointer
+ * @param clazz Java class reference (LlamaWrapper)
+ * @return Metrics snapshot, or null on failure
+ */
+JNIEXPORT jdoubleArray JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGetMetrics(JNIEnv *env, jclass clazz);
+
+/**
+ * Native method to enable or disable trace event recording.
+ * Matches Kotlin: LlamaWrapper.nativeSetTracing(enabled: Boolean): Boolean (@JvmStatic)
+ * 
+ * The first call that enables tracing allocates a ring buffer of LLAMA_JNI_TRACE_EVENTS
+ * events, kept for the life of the process; the newest events overwrite the oldest.
+ * 
+ * @param env JNI environment pointer
+ * @param clazz Java class reference (LlamaWrapper)
+ * @param enabled Whether decode steps, generations and preemptions are recorded
+ * @return JNI_TRUE if applied
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSetTracing(JNIEnv *env, jclass clazz, jboolean enabled);
+
+/**
+ * Native method to dump the trace ring buffer.
+ * Matches Kotlin: LlamaWrapper.nativeDumpTrace(clear: Boolean): String? (@JvmStatic)
+ * 
+ * @param env JNI environment pointer
+ * @param clazz Java class reference (LlamaWrapper)
+ * @param clear Whether to drop the dumped events from the buffer
+ * @return Chrome trace event JSON, loadable in Perfetto or chrome://tracing, or null on failure
  */
 JNIEXPORT jstring JNICALL
-Java_com_traycer_llama_LlamaWrapper_nativeGetModelInfo(JNIEnv *env, jobject thiz, jlong handle);
+Java_com_traycer_llama_LlamaWrapper_nativeDumpTrace(JNIEnv *env, jclass clazz, jboolean clear);
+
+/**
+ * Native method to set the process-wide memory budget.
+ * Matches Kotlin: LlamaWrapper.nativeSetMemoryBudget(limitBytes: Long, waitMs: Long): Boolean (@JvmStatic)
+ * 
+ * Model weights (file sizes), KV caches and compute buffers are reserved against the
+ * budget before they are allocated; a load or context creation that does not fit
+ * returns 0. Resources already loaded are unaffected by a lower limit.
+ * 
+ * @param env JNI environment pointer
+ * @param clazz Java class reference (LlamaWrapper)
+ * @param limitBytes Budget in bytes, 0 for unlimited
+ * @param waitMs How long a reservation may wait for memory to be released, 0 to fail at once
+ * @return JNI_TRUE if applied, JNI_FALSE if a value is negative
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSetMemoryBudget(JNIEnv *env, jclass clazz, jlong limitBytes, jlong waitMs);
+
+/**
+ * Native method to read the process-wide memory budget.
+ * Matches Kotlin: LlamaWrapper.nativeGetMemoryBudget(): LongArray? (@JvmStatic)
+ * 
+ * @param env JNI environment pointer
+ * @param clazz Java class reference (LlamaWrapper)
+ * @return Array of [limit, reserved] in bytes, or null on failure
+ */
+JNIEXPORT jlongArray JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGetMemoryBudget(JNIEnv *env, jclass clazz);
+
+/**
+ * Native method to report the memory a context holds.
+ * Matches Kotlin: nativeGetResourceUsage(handle: Long, usage: LongArray): Boolean
+ * 
+ * On success the usage array is filled in LLAMA_JNI_RES_* order, all in bytes. Reads
+ * counters published after each decode step, so it never waits for a generation.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param usage Array of at least LLAMA_JNI_RES_COUNT elements receiving the sizes
+ * @return JNI_TRUE if filled, JNI_FALSE if the handle or array is invalid
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGetResourceUsage(JNIEnv *env, jobject thiz, jlong handle, jlongArray usage);
+
+/**
+ * Native method to queue a generation on the native async worker pool.
+ * Matches Kotlin: nativeGenerateAsync(handle: Long, prompt: String, maxTokens: Int, temperature: Float, topP: Float, topK: Int,
+ *                                     constraints: GenerationConstraints?, future: CompletableFuture<String>): Boolean
+ * 
+ * Returns immediately. A worker thread, attached to the JVM once when the pool
+ * starts, runs the generation and completes the future with the text or with a
+ * RuntimeException. Jobs on one context run in submission order unless its
+ * scheduler is running. Cancelling the future stops generation at the next token.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param prompt Input text prompt
+ * @param maxTokens Maximum number of tokens to generate
+ * @param temperature Sampling temperature (0 = greedy)
+ * @param topP Top-p sampling parameter
+ * @param topK Top-k sampling parameter (0 = whole vocabulary)
+ * @param constraints GenerationConstraints with stop strings, a grammar and scheduling class, or null for none
+ * @param future CompletableFuture completed by the worker
+ * @return JNI_TRUE if the job was queued, JNI_FALSE if the arguments or handle are invalid
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGenerateAsync(JNIEnv *env, jobject thiz, jlong handle, jstring prompt, jint maxTokens,
+                                                        jfloat temperature, jfloat topP, jint topK, jobject constraints, jobject future);
+
+/**
+ * Native method to size the async worker pool before it starts.
+ * Matches Kotlin: LlamaWrapper.nativeSetAsyncWorkers(count: Int): Boolean (@JvmStatic)
+ * 
+ * @param env JNI environment pointer
+ * @param clazz Java class reference (LlamaWrapper)
+ * @param count Number of worker threads (default: LLAMA_JNI_DEFAULT_ASYNC_WORKERS)
+ * @return JNI_TRUE if applied, JNI_FALSE if count is invalid or the pool already started
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSetAsyncWorkers(JNIEnv *env, jclass clazz, jint count);
+
+/**
+ * Native method to compute pooled embeddings for many texts in as few decodes as possible.
+ * Matches Kotlin: nativeEmbed(handle: Long, texts: Array<String>, pooling: Int, normalize: Boolean,
+ *                             truncate: Boolean, output: FloatBuffer, outputOffset: Int): Int
+ * 
+ * Texts are packed as separate sequences of one multi-sequence batch and the
+ * vectors are written back to back, n_embd floats each, into the direct buffer.
+ * A text longer than the micro-batch size fails the call with LLAMA_JNI_ERR_INVALID_PARAMS
+ * unless truncate is set, before any decode. The prompt prefix cache is dropped, and the
+ * call fails while the scheduler is running.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param texts Texts to embed
+ * @param pooling llama_pooling_type value: -1 (context default), 1 (mean), 2 (CLS) or 3 (last token)
+ * @param normalize Whether to L2-normalize each vector
+ * @param truncate Cut texts longer than the micro-batch size instead of failing
+ * @param output Direct FloatBuffer in native byte order receiving the vectors
+ * @param outputOffset Float offset at which to start writing
+ * @return Number of vectors written, or a negated llama_jni_error_t code on failure
+ */
+JNIEXPORT jint JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeEmbed(JNIEnv *env, jobject thiz, jlong handle, jobjectArray texts, jint pooling,
+                                                jboolean normalize, jboolean truncate, jobject output, jint outputOffset);
+
+/**
+ * Native method to get the size of the vectors returned by nativeEmbed.
+ * Matches Kotlin: nativeGetEmbeddingSize(handle: Long): Int
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @return Embedding dimension, or 0 if the handle is invalid
+ */
+JNIEXPORT jint JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGetEmbeddingSize(JNIEnv *env, jobject thiz, jlong handle);
+
+/**
+ * Native method to get structured model information in one call.
+ * Matches Kotlin: nativeGetModelInfo(handle: Long, values: LongArray): Array<String>?
+ * 
+ * On success the values array is filled in LLAMA_JNI_INFO_* order. The returned array
+ * holds the model description, quantization (file type), K and V cache types and
+ * llama.cpp system info, followed by every GGUF metadata key and value as pairs.
+ * Metadata values longer than LLAMA_JNI_MAX_META_VALUE_BYTES are cut off with "...".
+ * Everything is captured when the context is created, so this never waits for a
+ * running generation.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param values Array of at least LLAMA_JNI_INFO_COUNT elements receiving the numeric fields
+ * @return String fields and metadata, or null if the handle or array is invalid
+ */
+JNIEXPORT jobjectArray JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeGetModelInfo(JNIEnv *env, jobject thiz, jlong handle, jlongArray values);
 
 /**
- * Native method to clean up and free model resources.
+ * Native method to start the continuous batching scheduler for a context.
+ * Matches Kotlin: nativeStartScheduler(handle: Long, maxSequences: Int): Boolean
+ * 
+ * While running, the scheduler thread owns the context and every generation
+ * on this handle is decoded together with other in-flight requests.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param maxSequences Maximum number of sequences decoded in parallel, capped at the
+ *                     context's batch size and llama.cpp's sequence limit
+ * @return true if the scheduler is running, false on failure
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeStartScheduler(JNIEnv *env, jobject thiz, jlong handle, jint maxSequences);
+
+/**
+ * Native method to stop the continuous batching scheduler.
+ * Matches Kotlin: nativeStopScheduler(handle: Long)
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ */
+JNIEXPORT void JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeStopScheduler(JNIEnv *env, jobject thiz, jlong handle);
+
+/**
+ * Native method to warm up a freshly created context.
+ * Matches Kotlin: nativeWarmup(handle: Long, prefault: Boolean): Boolean
+ * 
+ * Decodes a throwaway BOS/EOS batch on the context (and its draft context)
+ * and clears the KV cache afterwards. Must run before the scheduler starts.
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param prefault Read the mmap'd model files through the page cache first
+ * @return true if the warmup decode succeeded
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeWarmup(JNIEnv *env, jobject thiz, jlong handle, jboolean prefault);
+
+/**
+ * Native method to reseed the generator that seeds each request's sampler.
+ * Matches Kotlin: nativeSetSeed(handle: Long, seed: Long)
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param seed Seed making subsequent sampled generations reproducible
+ */
+JNIEXPORT void JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSetSeed(JNIEnv *env, jobject thiz, jlong handle, jlong seed);
+
+/**
+ * Native method to configure the per-context snapshot cache.
+ * Matches Kotlin: nativeConfigureStateCache(handle: Long, maxBytes: Long, spillDir: String?): Boolean
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param maxBytes Memory budget for snapshots kept in the LRU (default: 256 MiB)
+ * @param spillDir Directory receiving evicted snapshots, or null to drop them
+ * @return true on success, false if the handle or budget is invalid
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeConfigureStateCache(JNIEnv *env, jobject thiz, jlong handle, jlong maxBytes, jstring spillDir);
+
+/**
+ * Native method to snapshot the current KV state under a session name.
+ * Matches Kotlin: nativeSaveState(handle: Long, sessionId: String): Boolean
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param sessionId Name of the snapshot; an existing snapshot is replaced
+ * @return true on success, false if there is nothing to save or the scheduler is running
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeSaveState(JNIEnv *env, jobject thiz, jlong handle, jstring sessionId);
+
+/**
+ * Native method to restore a named KV state snapshot from memory or the spill directory.
+ * Matches Kotlin: nativeRestoreState(handle: Long, sessionId: String): Boolean
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param sessionId Name of the snapshot
+ * @return true if the snapshot was restored, false if it is unknown or could not be applied
+ */
+JNIEXPORT jboolean JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeRestoreState(JNIEnv *env, jobject thiz, jlong handle, jstring sessionId);
+
+/**
+ * Native method to delete a named snapshot from memory and the spill directory.
+ * Matches Kotlin: nativeDeleteState(handle: Long, sessionId: String)
+ * 
+ * @param env JNI environment pointer
+ * @param thiz Java object reference (LlamaWrapper instance)
+ * @param handle Native handle to the model context
+ * @param sessionId Name of the snapshot
+ */
+JNIEXPORT void JNICALL
+Java_com_traycer_llama_LlamaWrapper_nativeDeleteState(JNIEnv *env, jobject thiz, jlong handle, jstring sessionId);
+
+/**
+ * Native method to clean up and free context resources.
+ * Releases the context's reference to its model weights.
  * Matches Kotlin: nativeCleanup(handle: Long)
  * 
+ * The handle becomes invalid immediately. Calls already running on it keep
+ * the context alive and it is freed when the last of them returns.
+ * 
  * @param env JNI environment pointer
  * @param thiz Java object reference (LlamaWrapper instance)
  * @param handle Native handle to the model context
@@ -84,8 +703,9 @@ typedef enum {
     LLAMA_JNI_ERR_CONTEXT_INIT_FAILED = 8
 } llama_jni_error_t;
 
-// Forward declaration for opaque handle structure
-// The actual LlamaContext implementation is in the .cpp file
+// Forward declarations for opaque handle structures
+// The actual LlamaModel and LlamaContext implementations are in the .cpp file
+struct LlamaModel;
 struct LlamaContext;
 
 // Default parameter values (matching Kotlin defaults)
@@ -95,6 +715,95 @@ struct LlamaContext;
 #define LLAMA_JNI_DEFAULT_TOP_P 0.9f
 #define LLAMA_JNI_DEFAULT_TOP_K 40
 #define LLAMA_JNI_AUTO_DETECT_THREADS -1
+#define LLAMA_JNI_DEFAULT_MAX_SEQUENCES 4
+#define LLAMA_JNI_DEFAULT_STATE_CACHE_BYTES (256L * 1024L * 1024L)
+#define LLAMA_JNI_DEFAULT_ASYNC_WORKERS 4
+#define LLAMA_JNI_MAX_EMBED_SEQUENCES 64
+#define LLAMA_JNI_MAX_BATCH_SEQUENCES 16
+#define LLAMA_JNI_DEFAULT_DRAFT_TOKENS 8
+#define LLAMA_JNI_MAX_META_VALUE_BYTES 4096
+#define LLAMA_JNI_TRACE_EVENTS 65536
+
+// Scheduler priority classes (mirrored by RequestPriority.kt); lower runs first
+#define LLAMA_JNI_PRIORITY_INTERACTIVE 0
+#define LLAMA_JNI_PRIORITY_NORMAL 1
+#define LLAMA_JNI_PRIORITY_BATCH 2
+
+// Completion status reported by nativeGenerateDirect (mirrored by DirectGenerationResult.kt)
+#define LLAMA_JNI_DIRECT_COMPLETE 0
+#define LLAMA_JNI_DIRECT_TRUNCATED 1
+
+// Layout of the stats array filled by nativeGenerateWithStats (mirrored by GenerationStats.kt)
+#define LLAMA_JNI_STAT_PROMPT_TOKENS 0
+#define LLAMA_JNI_STAT_CACHED_TOKENS 1
+#define LLAMA_JNI_STAT_GENERATED_TOKENS 2
+#define LLAMA_JNI_STAT_QUEUE_MS 3
+#define LLAMA_JNI_STAT_TOKENIZE_MS 4
+#define LLAMA_JNI_STAT_PREFILL_MS 5
+#define LLAMA_JNI_STAT_TTFT_MS 6
+#define LLAMA_JNI_STAT_DECODE_MS 7
+#define LLAMA_JNI_STAT_TOTAL_MS 8
+#define LLAMA_JNI_STAT_KV_USED 9
+#define LLAMA_JNI_STAT_KV_SIZE 10
+#define LLAMA_JNI_STAT_DRAFT_ROUNDS 11
+#define LLAMA_JNI_STAT_DRAFT_TOKENS 12
+#define LLAMA_JNI_STAT_DRAFT_ACCEPTED 13
+#define LLAMA_JNI_STAT_DISCARDED_TOKENS 14
+#define LLAMA_JNI_STAT_PREEMPTIONS 15
+#define LLAMA_JNI_STAT_COUNT 16
+
+// Layout of the usage array filled by nativeGetResourceUsage (mirrored by ResourceUsage.kt)
+#define LLAMA_JNI_RES_WEIGHTS 0
+#define LLAMA_JNI_RES_KV 1
+#define LLAMA_JNI_RES_KV_USED 2
+#define LLAMA_JNI_RES_COMPUTE 3
+#define LLAMA_JNI_RES_STATE_CACHE 4
+#define LLAMA_JNI_RES_RESERVED 5
+#define LLAMA_JNI_RES_COUNT 6
+
+// Layout of the values array filled by nativeGetModelInfo (mirrored by ModelInfo.kt)
+#define LLAMA_JNI_INFO_VOCAB_SIZE 0
+#define LLAMA_JNI_INFO_TRAIN_CONTEXT 1
+#define LLAMA_JNI_INFO_CONTEXT 2
+#define LLAMA_JNI_INFO_EMBEDDING 3
+#define LLAMA_JNI_INFO_LAYERS 4
+#define LLAMA_JNI_INFO_HEADS 5
+#define LLAMA_JNI_INFO_HEADS_KV 6
+#define LLAMA_JNI_INFO_PARAMETERS 7
+#define LLAMA_JNI_INFO_SIZE_BYTES 8
+#define LLAMA_JNI_INFO_SEQUENCES 9
+#define LLAMA_JNI_INFO_ADAPTERS 10
+#define LLAMA_JNI_INFO_COUNT 11
+
+// Leading entries of the string array returned by nativeGetModelInfo, before the metadata pairs
+#define LLAMA_JNI_INFO_STRING_COUNT 5
+
+// Layout of the snapshot returned by nativeGetMetrics (mirrored by NativeMetrics.kt)
+#define LLAMA_JNI_METRIC_DECODE_CALLS 0
+#define LLAMA_JNI_METRIC_DECODE_TOKENS 1
+#define LLAMA_JNI_METRIC_DECODE_FAILURES 2
+#define LLAMA_JNI_METRIC_PROMPT_TOKENS 3
+#define LLAMA_JNI_METRIC_CACHED_TOKENS 4
+#define LLAMA_JNI_METRIC_GENERATED_TOKENS 5
+#define LLAMA_JNI_METRIC_REQUESTS 6
+#define LLAMA_JNI_METRIC_REQUEST_ERRORS 7
+#define LLAMA_JNI_METRIC_PREEMPTIONS 8
+#define LLAMA_JNI_METRIC_QUEUE_DEPTH 9
+#define LLAMA_JNI_METRIC_ACTIVE_SEQUENCES 10
+#define LLAMA_JNI_METRIC_KV_CELLS_USED 11
+#define LLAMA_JNI_METRIC_KV_CELLS_TOTAL 12
+#define LLAMA_JNI_METRIC_CONTEXTS 13
+#define LLAMA_JNI_METRIC_MODELS 14
+#define LLAMA_JNI_METRIC_TRACE_EVENTS 15
+#define LLAMA_JNI_METRIC_COUNT 16
+
+// Histograms following the scalars in the nativeGetMetrics snapshot
+#define LLAMA_JNI_HISTOGRAM_DECODE_SECONDS 0
+#define LLAMA_JNI_HISTOGRAM_BATCH_FILL 1
+#define LLAMA_JNI_HISTOGRAM_QUEUE_WAIT_SECONDS 2
+#define LLAMA_JNI_HISTOGRAM_JNI_MARSHAL_SECONDS 3
+#define LLAMA_JNI_HISTOGRAM_DRAFT_DECODE_SECONDS 4
+#define LLAMA_JNI_HISTOGRAM_COUNT 5
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,520 @@
+// Standalone benchmark of the llama.cpp configuration used by llama_jni.
+//
+// Measures model load time, prefill throughput across prompt lengths, decode throughput
+// across thread counts and aggregate decode throughput with several contexts sharing one
+// model. Inputs are synthetic token sequences from a fixed seed and sampling is greedy,
+// so every run does the same work. Results are written as JSON for comparing builds,
+// e.g. before and after a llama.cpp submodule upgrade.
+//
+// Usage:
+//   llama_jni_bench --model PATH [--prompt-lengths 32,128,512] [--gen-tokens 128]
+//                   [--threads 8] [--thread-counts 1,2,4,8] [--contexts 1,2,4]
+//                   [--repetitions 5] [--seed 42] [--output report.json]
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <dlfcn.h>
+#include "llama.h"
+#include "ggml-backend.h"
+
+#ifndef LLAMA_JNI_BENCH_LLAMA_COMMIT
+#define LLAMA_JNI_BENCH_LLAMA_COMMIT "unknown"
+#endif
+
+// Directory of the libllama the bench was linked against, searched for backends
+#ifndef LLAMA_JNI_BENCH_LIBRARY_DIR
+#define LLAMA_JNI_BENCH_LIBRARY_DIR ""
+#endif
+
+// Bumped whenever fields are renamed or change meaning
+static const int REPORT_SCHEMA_VERSION = 1;
+
+// Compute buffer sizes llama.cpp logged while creating contexts. llama_jni admits contexts
+// against its memory budget by parsing these lines (see log_callback in llama_jni.cpp), so
+// the bench fails when a llama.cpp upgrade stops logging them in this form.
+static uint64_t g_compute_buffer_bytes = 0;
+static int g_compute_buffer_lines = 0;
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed_ms(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+struct BenchOptions {
+    std::string model_path;
+    std::vector<int> prompt_lengths = {32, 128, 512};
+    int gen_tokens = 128;
+    int threads = 0;                 // 0: hardware concurrency
+    std::vector<int> thread_counts;  // empty: only `threads`
+    std::vector<int> contexts = {1, 2, 4};
+    int repetitions = 5;
+    int batch_size = 512;
+    uint32_t seed = 42;
+    std::string output;              // empty: stdout
+};
+
+// Mean, spread and extremes of one measurement over all repetitions
+struct Summary {
+    double mean = 0;
+    double stddev = 0;
+    double min = 0;
+    double max = 0;
+};
+
+Summary summarize(const std::vector<double>& samples) {
+    Summary s;
+    if (samples.empty()) {
+        return s;
+    }
+    s.min = *std::min_element(samples.begin(), samples.end());
+    s.max = *std::max_element(samples.begin(), samples.end());
+    for (double v : samples) {
+        s.mean += v;
+    }
+    s.mean /= samples.size();
+    for (double v : samples) {
+        s.stddev += (v - s.mean) * (v - s.mean);
+    }
+    s.stddev = samples.size() > 1 ? std::sqrt(s.stddev / (samples.size() - 1)) : 0.0;
+    return s;
+}
+
+std::string json_escape(const std::string& str) {
+    std::string out;
+    for (char c : str) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+std::string json_summary(const Summary& s) {
+    std::ostringstream out;
+    out << "{\"mean\": " << s.mean << ", \"stddev\": " << s.stddev
+        << ", \"min\": " << s.min << ", \"max\": " << s.max << "}";
+    return out.str();
+}
+
+bool parse_int_list(const std::string& value, std::vector<int>& out) {
+    out.clear();
+    std::stringstream in(value);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        try {
+            int n = std::stoi(item);
+            if (n <= 0) {
+                return false;
+            }
+            out.push_back(n);
+        } catch (...) {
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
+bool parse_args(int argc, char** argv, BenchOptions& opts) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const std::string value = argv[++i];
+        try {
+            if (arg == "--model") {
+                opts.model_path = value;
+            } else if (arg == "--prompt-lengths") {
+                if (!parse_int_list(value, opts.prompt_lengths)) {
+                    return false;
+                }
+            } else if (arg == "--gen-tokens") {
+                opts.gen_tokens = std::stoi(value);
+            } else if (arg == "--threads") {
+                opts.threads = std::stoi(value);
+            } else if (arg == "--thread-counts") {
+                if (!parse_int_list(value, opts.thread_counts)) {
+                    return false;
+                }
+            } else if (arg == "--contexts") {
+                if (!parse_int_list(value, opts.contexts)) {
+                    return false;
+                }
+            } else if (arg == "--repetitions") {
+                opts.repetitions = std::stoi(value);
+            } else if (arg == "--batch-size") {
+                opts.batch_size = std::stoi(value);
+            } else if (arg == "--seed") {
+                opts.seed = static_cast<uint32_t>(std::stoul(value));
+            } else if (arg == "--output") {
+                opts.output = value;
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            }
+        } catch (...) {
+            std::cerr << "Invalid value for " << arg << ": " << value << std::endl;
+            return false;
+        }
+    }
+    return !opts.model_path.empty() && opts.gen_tokens > 0 && opts.repetitions > 0 && opts.batch_size > 0;
+}
+
+// Directory of the libllama loaded into this process, or empty if it cannot be resolved
+std::string llama_library_directory() {
+    Dl_info info;
+    if (dladdr(reinterpret_cast<void*>(&llama_backend_init), &info) == 0 || info.dli_fname == nullptr) {
+        return "";
+    }
+    const std::string path = info.dli_fname;
+    const size_t slash = path.find_last_of('/');
+    return (slash == std::string::npos) ? "" : path.substr(0, slash);
+}
+
+// A GGML_BACKEND_DL build links no backend into libllama. Load them as llama_jni does:
+// from the loaded libllama's directory, then the one it was linked from at build time,
+// then ggml's default search (the executable's directory and the working directory).
+bool load_backends() {
+    if (ggml_backend_reg_count() > 0) {
+        return true;
+    }
+    for (const std::string& dir : {llama_library_directory(), std::string(LLAMA_JNI_BENCH_LIBRARY_DIR)}) {
+        if (!dir.empty() && ggml_backend_reg_count() == 0) {
+            ggml_backend_load_all_from_path(dir.c_str());
+        }
+    }
+    if (ggml_backend_reg_count() == 0) {
+        ggml_backend_load_all();
+    }
+    return ggml_backend_reg_count() > 0;
+}
+
+// BOS followed by seeded random non-control tokens: the same sequence on every run
+std::vector<llama_token> synthetic_prompt(const llama_vocab* vocab, int n_tokens, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<llama_token> dist(0, llama_vocab_n_tokens(vocab) - 1);
+    std::vector<llama_token> tokens;
+    if (llama_vocab_bos(vocab) != LLAMA_TOKEN_NULL) {
+        tokens.push_back(llama_vocab_bos(vocab));
+    }
+    while (static_cast<int>(tokens.size()) < n_tokens) {
+        llama_token token = dist(rng);
+        if (!llama_vocab_is_control(vocab, token) && !llama_vocab_is_eog(vocab, token)) {
+            tokens.push_back(token);
+        }
+    }
+    return tokens;
+}
+
+// Append a single token to a batch
+void batch_add(llama_batch& batch, llama_token token, llama_pos pos, bool logits) {
+    const int32_t i = batch.n_tokens;
+    batch.token[i] = token;
+    batch.pos[i] = pos;
+    batch.n_seq_id[i] = 1;
+    batch.seq_id[i][0] = 0;
+    batch.logits[i] = logits;
+    batch.n_tokens++;
+}
+
+// One context with its reusable batch, as llama_jni creates them
+struct BenchContext {
+    llama_context* context = nullptr;
+    llama_batch batch = llama_batch();
+    
+    BenchContext() = default;
+    BenchContext(const BenchContext&) = delete;
+    BenchContext& operator=(const BenchContext&) = delete;
+    
+    ~BenchContext() {
+        if (batch.token != nullptr) {
+            llama_batch_free(batch);
+        }
+        if (context != nullptr) {
+            llama_free(context);
+        }
+    }
+};
+
+bool init_context(BenchContext& bc, llama_model* model, int n_ctx, int n_batch, int n_threads) {
+    llama_context_params params = llama_context_default_params();
+    params.n_ctx = n_ctx;
+    params.n_batch = n_batch;
+    params.n_ubatch = n_batch;
+    params.n_threads = n_threads;
+    params.n_threads_batch = n_threads;
+    params.no_perf = true;
+    bc.context = llama_init_from_model(model, params);
+    if (bc.context == nullptr) {
+        return false;
+    }
+    bc.batch = llama_batch_init(n_batch, 0, 1);
+    return true;
+}
+
+// Decode tokens from an empty cache in n_batch chunks; returns elapsed ms or -1 on failure
+double prefill(BenchContext& bc, const std::vector<llama_token>& tokens, int n_batch) {
+    llama_memory_clear(llama_get_memory(bc.context), true);
+    const Clock::time_point start = Clock::now();
+    for (size_t begin = 0; begin < tokens.size(); begin += n_batch) {
+        const size_t end = std::min(begin + n_batch, tokens.size());
+        bc.batch.n_tokens = 0;
+        for (size_t i = begin; i < end; i++) {
+            batch_add(bc.batch, tokens[i], static_cast<llama_pos>(i), i + 1 == tokens.size());
+        }
+        if (llama_decode(bc.context, bc.batch) != 0) {
+            return -1;
+        }
+    }
+    llama_synchronize(bc.context);
+    return elapsed_ms(start, Clock::now());
+}
+
+// Greedily decode n_gen tokens after a prefill, ignoring end-of-generation so every run
+// does the same amount of work. Returns decode tokens/s or -1 on failure.
+double decode(BenchContext& bc, const std::vector<llama_token>& prompt, int n_gen, int n_batch) {
+    if (prefill(bc, prompt, n_batch) < 0) {
+        return -1;
+    }
+    const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(llama_get_model(bc.context)));
+    llama_pos pos = static_cast<llama_pos>(prompt.size());
+    
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < n_gen; i++) {
+        const float* logits = llama_get_logits_ith(bc.context, bc.batch.n_tokens - 1);
+        llama_token best = static_cast<llama_token>(std::max_element(logits, logits + n_vocab) - logits);
+        bc.batch.n_tokens = 0;
+        batch_add(bc.batch, best, pos++, true);
+        if (llama_decode(bc.context, bc.batch) != 0) {
+            return -1;
+        }
+    }
+    llama_synchronize(bc.context);
+    return n_gen * 1000.0 / elapsed_ms(start, Clock::now());
+}
+
+int main(int argc, char** argv) {
+    BenchOptions opts;
+    if (!parse_args(argc, argv, opts)) {
+        std::cerr << "Usage: " << argv[0] << " --model PATH [--prompt-lengths 32,128,512] [--gen-tokens 128]"
+                  << " [--threads N] [--thread-counts 1,2,4] [--contexts 1,2,4] [--repetitions 5]"
+                  << " [--batch-size 512] [--seed 42] [--output report.json]" << std::endl;
+        return 1;
+    }
+    if (opts.threads <= 0) {
+        opts.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (opts.thread_counts.empty()) {
+        opts.thread_counts.push_back(opts.threads);
+    }
+    
+    // Keep llama.cpp's log output out of the report, counting the compute buffer lines
+    // llama_jni parses, e.g. "llama_context:        CPU compute buffer size =   298.50 MiB"
+    llama_log_set([](enum ggml_log_level level, const char* text, void* user_data) {
+        const char* size = std::strstr(text, "compute buffer size =");
+        double mib = 0.0;
+        if (size != nullptr && std::sscanf(std::strchr(size, '=') + 1, "%lf MiB", &mib) == 1) {
+            g_compute_buffer_bytes += static_cast<uint64_t>(mib * 1024.0 * 1024.0);
+            g_compute_buffer_lines++;
+        }
+        if (level == GGML_LOG_LEVEL_ERROR) {
+            std::cerr << text;
+        }
+    }, nullptr);
+    if (!load_backends()) {
+        std::cerr << "No ggml backends found next to libllama (" << llama_library_directory() << ")" << std::endl;
+        return 1;
+    }
+    llama_backend_init();
+    
+    // Load time, first (cold page cache) and repeated
+    llama_model_params model_params = llama_model_default_params();
+    llama_model* model = nullptr;
+    std::vector<double> load_ms;
+    for (int rep = 0; rep < opts.repetitions; rep++) {
+        if (model != nullptr) {
+            llama_model_free(model);
+        }
+        const Clock::time_point start = Clock::now();
+        model = llama_model_load_from_file(opts.model_path.c_str(), model_params);
+        if (model == nullptr) {
+            std::cerr << "Failed to load model: " << opts.model_path << std::endl;
+            return 1;
+        }
+        load_ms.push_back(elapsed_ms(start, Clock::now()));
+    }
+    
+    const llama_vocab* vocab = llama_model_get_vocab(model);
+    const int max_prompt = *std::max_element(opts.prompt_lengths.begin(), opts.prompt_lengths.end());
+    const int decode_prompt_len = std::min(32, max_prompt);
+    const int n_ctx = std::max(max_prompt, decode_prompt_len + opts.gen_tokens) + 1;
+    const int n_batch = std::min(opts.batch_size, n_ctx);
+    
+    std::ostringstream prefill_json;
+    std::ostringstream decode_json;
+    std::ostringstream concurrency_json;
+    bool failed = false;
+    
+    uint64_t compute_buffer_bytes = 0;
+    {
+        BenchContext bc;
+        if (!init_context(bc, model, n_ctx, n_batch, opts.threads)) {
+            std::cerr << "Failed to create context" << std::endl;
+            return 1;
+        }
+        if (g_compute_buffer_lines == 0) {
+            std::cerr << "llama.cpp no longer logs \"compute buffer size = ... MiB\" when creating a context; "
+                      << "update log_callback in llama_jni.cpp, or every context is rejected under a memory budget" << std::endl;
+            llama_model_free(model);
+            return 1;
+        }
+        compute_buffer_bytes = g_compute_buffer_bytes;
+        
+        // Prefill throughput per prompt length; the first run warms buffers and is discarded
+        for (size_t p = 0; p < opts.prompt_lengths.size() && !failed; p++) {
+            const int length = opts.prompt_lengths[p];
+            const std::vector<llama_token> prompt = synthetic_prompt(vocab, length, opts.seed);
+            std::vector<double> tps;
+            for (int rep = -1; rep < opts.repetitions; rep++) {
+                double ms = prefill(bc, prompt, n_batch);
+                if (ms < 0) {
+                    failed = true;
+                    break;
+                }
+                if (rep >= 0) {
+                    tps.push_back(length * 1000.0 / ms);
+                }
+            }
+            prefill_json << (p > 0 ? ",\n" : "") << "    {\"prompt_tokens\": " << length
+                         << ", \"tokens_per_second\": " << json_summary(summarize(tps)) << "}";
+        }
+    }
+    
+    // Decode throughput per thread count
+    const std::vector<llama_token> decode_prompt = synthetic_prompt(vocab, decode_prompt_len, opts.seed);
+    for (size_t t = 0; t < opts.thread_counts.size() && !failed; t++) {
+        BenchContext bc;
+        if (!init_context(bc, model, n_ctx, n_batch, opts.thread_counts[t])) {
+            failed = true;
+            break;
+        }
+        std::vector<double> tps;
+        for (int rep = -1; rep < opts.repetitions; rep++) {
+            double value = decode(bc, decode_prompt, opts.gen_tokens, n_batch);
+            if (value < 0) {
+                failed = true;
+                break;
+            }
+            if (rep >= 0) {
+                tps.push_back(value);
+            }
+        }
+        decode_json << (t > 0 ? ",\n" : "") << "    {\"threads\": " << opts.thread_counts[t]
+                    << ", \"tokens_per_second\": " << json_summary(summarize(tps)) << "}";
+    }
+    
+    // Aggregate decode throughput with n contexts on one model, splitting the thread budget
+    for (size_t c = 0; c < opts.contexts.size() && !failed; c++) {
+        const int n_contexts = opts.contexts[c];
+        const int threads_per_context = std::max(1, opts.threads / n_contexts);
+        std::vector<BenchContext> contexts(n_contexts);
+        for (auto& bc : contexts) {
+            if (!init_context(bc, model, n_ctx, n_batch, threads_per_context)) {
+                failed = true;
+                break;
+            }
+        }
+        
+        std::vector<double> aggregate;
+        for (int rep = -1; rep < opts.repetitions && !failed; rep++) {
+            std::vector<double> results(n_contexts, -1);
+            std::vector<std::thread> workers;
+            const Clock::time_point start = Clock::now();
+            for (int i = 0; i < n_contexts; i++) {
+                workers.emplace_back([&, i] {
+                    results[i] = decode(contexts[i], decode_prompt, opts.gen_tokens, n_batch);
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            const double wall_ms = elapsed_ms(start, Clock::now());
+            if (std::any_of(results.begin(), results.end(), [](double v) { return v < 0; })) {
+                failed = true;
+                break;
+            }
+            if (rep >= 0) {
+                // Wall time includes each context's prefill, so this is end-to-end tokens/s
+                aggregate.push_back(n_contexts * opts.gen_tokens * 1000.0 / wall_ms);
+            }
+        }
+        concurrency_json << (c > 0 ? ",\n" : "") << "    {\"contexts\": " << n_contexts
+                         << ", \"threads_per_context\": " << threads_per_context
+                         << ", \"aggregate_tokens_per_second\": " << json_summary(summarize(aggregate)) << "}";
+    }
+    
+    if (failed) {
+        std::cerr << "Decode failed during benchmark" << std::endl;
+        llama_model_free(model);
+        return 1;
+    }
+    
+    char desc[256];
+    llama_model_desc(model, desc, sizeof(desc));
+    
+    std::ostringstream report;
+    report << "{\n"
+           << "  \"schema_version\": " << REPORT_SCHEMA_VERSION << ",\n"
+           << "  \"llama_cpp_commit\": \"" << json_escape(LLAMA_JNI_BENCH_LLAMA_COMMIT) << "\",\n"
+           << "  \"system_info\": \"" << json_escape(llama_print_system_info()) << "\",\n"
+           << "  \"model\": {\"path\": \"" << json_escape(opts.model_path) << "\", \"description\": \"" << json_escape(desc)
+           << "\", \"size_bytes\": " << llama_model_size(model) << ", \"parameters\": " << llama_model_n_params(model) << "},\n"
+           << "  \"config\": {\"seed\": " << opts.seed << ", \"repetitions\": " << opts.repetitions
+           << ", \"threads\": " << opts.threads << ", \"batch_size\": " << n_batch << ", \"context_size\": " << n_ctx
+           << ", \"gen_tokens\": " << opts.gen_tokens << ", \"decode_prompt_tokens\": " << decode_prompt_len << "},\n"
+           << "  \"compute_buffer_bytes\": " << compute_buffer_bytes << ",\n"
+           << "  \"load_ms\": {\"first\": " << load_ms.front() << ", \"summary\": " << json_summary(summarize(load_ms)) << "},\n"
+           << "  \"prefill\": [\n" << prefill_json.str() << "\n  ],\n"
+           << "  \"decode\": [\n" << decode_json.str() << "\n  ],\n"
+           << "  \"concurrency\": [\n" << concurrency_json.str() << "\n  ]\n"
+           << "}\n";
+    
+    llama_model_free(model);
+    llama_backend_free();
+    
+    if (opts.output.empty()) {
+        std::cout << report.str();
+    } else {
+        std::ofstream out(opts.output);
+        if (!out) {
+            std::cerr << "Cannot write report: " << opts.output << std::endl;
+            return 1;
+        }
+        out << report.str();
+    }
+    return 0;
+}